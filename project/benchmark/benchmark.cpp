@@ -0,0 +1,357 @@
+﻿// Microbenchmarks for the simulator's hot paths, using Google Benchmark.
+// Results can be written as JSON for tracking across releases:
+//   benchmark --benchmark_out=results.json --benchmark_out_format=json
+
+#include "acs/acs.h"
+
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Sizes from the menu circuits up to very large ones
+void component_counts(benchmark::internal::Benchmark* b) {
+	b->Arg(3)->Arg(10)->Arg(100)->Arg(1000)->Arg(10000)->Arg(100000);
+}
+
+// Mixed resistors, capacitors and inductors with slightly different values
+std::vector<std::unique_ptr<components>> make_parts(std::size_t n) {
+	std::vector<std::unique_ptr<components>> parts;
+	parts.reserve(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		const double k = 1.0 + 0.001 * static_cast<double>(i % 1000);
+		switch (i % 3) {
+		case 0:
+			parts.push_back(std::make_unique<resistor>(100.0 * k));
+			break;
+		case 1:
+			parts.push_back(std::make_unique<capacitor>(1e-6 * k));
+			break;
+		default:
+			parts.push_back(std::make_unique<inductor>(1e-3 * k));
+			break;
+		}
+	}
+	return parts;
+}
+
+void fill_circuit(circuit& c, const std::vector<std::unique_ptr<components>>& parts) {
+	for (const std::unique_ptr<components>& part : parts) {
+		if (c.get_topology() == connection::series) {
+			c.add_component_in_series(part.get());
+		}
+		else {
+			c.add_component_in_parallel(part.get());
+		}
+	}
+}
+
+std::vector<double> log_frequencies(std::size_t n) {
+	std::vector<double> freqs(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		freqs[i] = 10.0 * std::pow(1e5, static_cast<double>(i) / static_cast<double>(n - 1));
+	}
+	return freqs;
+}
+
+void BM_capacitor_set_frequency(benchmark::State& state) {
+	capacitor c(1e-6);
+	double f = 1000.0;
+	for (auto _ : state) {
+		c.set_frequency(f);
+		benchmark::DoNotOptimize(c.get_impedance());
+		f += 1.0;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_capacitor_set_frequency);
+
+void BM_inductor_set_frequency(benchmark::State& state) {
+	inductor l(1e-3);
+	double f = 1000.0;
+	for (auto _ : state) {
+		l.set_frequency(f);
+		benchmark::DoNotOptimize(l.get_impedance());
+		f += 1.0;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_inductor_set_frequency);
+
+// Building a circuit: every add updates the running sums of its topology
+void build_circuit(benchmark::State& state, connection topology) {
+	const std::vector<std::unique_ptr<components>> parts = make_parts(static_cast<std::size_t>(state.range(0)));
+	for (auto _ : state) {
+		circuit c(topology);
+		fill_circuit(c, parts);
+		c.set_frequency(1000.0);
+		benchmark::DoNotOptimize(c.get_circuit_impedance());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+void BM_circuit_build_series(benchmark::State& state) {
+	build_circuit(state, connection::series);
+}
+void BM_circuit_build_parallel(benchmark::State& state) {
+	build_circuit(state, connection::parallel);
+}
+BENCHMARK(BM_circuit_build_series)->Apply(component_counts);
+BENCHMARK(BM_circuit_build_parallel)->Apply(component_counts);
+
+// Re-evaluating the impedance after a frequency change, and after one part is replaced
+void update_circuit(benchmark::State& state, connection topology) {
+	const std::vector<std::unique_ptr<components>> parts = make_parts(static_cast<std::size_t>(state.range(0)));
+	circuit c(topology);
+	fill_circuit(c, parts);
+	resistor replacement(150.0);
+	double f = 1000.0;
+	for (auto _ : state) {
+		c.set_frequency(f);
+		benchmark::DoNotOptimize(c.get_circuit_impedance());
+		c.replace_component(0, f == 1000.0 ? &replacement : parts[0].get());
+		benchmark::DoNotOptimize(c.get_circuit_impedance());
+		f = f == 1000.0 ? 2000.0 : 1000.0;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+void BM_circuit_update_series(benchmark::State& state) {
+	update_circuit(state, connection::series);
+}
+void BM_circuit_update_parallel(benchmark::State& state) {
+	update_circuit(state, connection::parallel);
+}
+BENCHMARK(BM_circuit_update_series)->Apply(component_counts);
+BENCHMARK(BM_circuit_update_parallel)->Apply(component_counts);
+
+// A 1024 point sweep of a circuit of the given size, in double or float
+template <typename T>
+void BM_circuit_sweep(benchmark::State& state) {
+	const std::vector<std::unique_ptr<components>> parts = make_parts(static_cast<std::size_t>(state.range(0)));
+	circuit c(connection::parallel);
+	fill_circuit(c, parts);
+	const std::vector<double> f = log_frequencies(1024);
+	const std::vector<T> freqs(f.begin(), f.end());
+	std::vector<T> magnitude(freqs.size());
+	std::vector<T> phase(freqs.size());
+	for (auto _ : state) {
+		c.sweep(freqs.data(), freqs.size(), magnitude.data(), phase.data());
+		benchmark::DoNotOptimize(magnitude.data());
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(freqs.size()));
+}
+BENCHMARK_TEMPLATE(BM_circuit_sweep, double)->Apply(component_counts);
+BENCHMARK_TEMPLATE(BM_circuit_sweep, float)->Apply(component_counts);
+
+// A 1024 point sweep of a parallel circuit of the given number of series RLC
+// sub-circuits, each a node of its own
+void BM_circuit_sweep_nested(benchmark::State& state) {
+	const std::size_t n = static_cast<std::size_t>(state.range(0));
+	const std::vector<std::unique_ptr<components>> parts = make_parts(3 * n);
+	std::vector<std::unique_ptr<circuit>> branches;
+	circuit c(connection::parallel);
+	for (std::size_t k = 0; k < n; ++k) {
+		branches.push_back(std::make_unique<circuit>(connection::series));
+		for (std::size_t j = 0; j < 3; ++j) {
+			branches.back()->add_component_in_series(parts[3 * k + j].get());
+		}
+		c.add_circuit_in_parallel(branches.back().get());
+	}
+	const std::vector<double> freqs = log_frequencies(1024);
+	std::vector<double> magnitude(freqs.size());
+	std::vector<double> phase(freqs.size());
+	for (auto _ : state) {
+		c.sweep(freqs.data(), freqs.size(), magnitude.data(), phase.data());
+		benchmark::DoNotOptimize(magnitude.data());
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(freqs.size()));
+}
+BENCHMARK(BM_circuit_sweep_nested)->Arg(3)->Arg(30)->Arg(300);
+
+// Sweep of a menu circuit through its fixed-topology form
+void BM_fixed_sweep(benchmark::State& state) {
+	const parallel_rlc rlc(100.0, 1e-6, 1e-3);
+	const std::vector<double> freqs = log_frequencies(1024);
+	std::vector<double> magnitude(freqs.size());
+	std::vector<double> phase(freqs.size());
+	for (auto _ : state) {
+		rlc.sweep(freqs.data(), freqs.size(), magnitude.data(), phase.data());
+		benchmark::DoNotOptimize(magnitude.data());
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(freqs.size()));
+}
+BENCHMARK(BM_fixed_sweep);
+
+// The given number of series RLC circuits with different values swept one at a
+// time, and in lockstep one per SIMD lane
+void BM_fixed_sweep_each(benchmark::State& state) {
+	const std::size_t n = static_cast<std::size_t>(state.range(0));
+	std::vector<series_rlc> circuits;
+	for (std::size_t k = 0; k < n; ++k) {
+		const double s = 1.0 + 0.001 * static_cast<double>(k % 1000);
+		circuits.emplace_back(100.0 * s, 1e-6 * s, 1e-3 * s);
+	}
+	const std::vector<double> freqs = log_frequencies(64);
+	std::vector<double> magnitude(freqs.size() * n);
+	std::vector<double> phase(freqs.size() * n);
+	for (auto _ : state) {
+		for (std::size_t k = 0; k < n; ++k) {
+			circuits[k].sweep(freqs.data(), freqs.size(), magnitude.data() + k * freqs.size(), phase.data() + k * freqs.size());
+		}
+		benchmark::DoNotOptimize(magnitude.data());
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(n * freqs.size()));
+}
+BENCHMARK(BM_fixed_sweep_each)->Arg(16)->Arg(1024)->Arg(65536);
+
+template <typename T>
+void BM_lane_sweep(benchmark::State& state) {
+	const std::size_t n = static_cast<std::size_t>(state.range(0));
+	circuit_lanes<series_rlc, T> lanes(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		const double s = 1.0 + 0.001 * static_cast<double>(k % 1000);
+		lanes.set_circuit(k, series_rlc(100.0 * s, 1e-6 * s, 1e-3 * s));
+	}
+	const std::vector<double> f = log_frequencies(64);
+	const std::vector<T> freqs(f.begin(), f.end());
+	std::vector<T> magnitude(freqs.size() * n);
+	std::vector<T> phase(freqs.size() * n);
+	for (auto _ : state) {
+		lanes.sweep(freqs.data(), freqs.size(), magnitude.data(), phase.data());
+		benchmark::DoNotOptimize(magnitude.data());
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(n * freqs.size()));
+}
+BENCHMARK_TEMPLATE(BM_lane_sweep, double)->Arg(16)->Arg(1024)->Arg(65536);
+BENCHMARK_TEMPLATE(BM_lane_sweep, float)->Arg(16)->Arg(1024)->Arg(65536);
+
+// Sweep of an RC ladder with the given number of sections through the sparse nodal
+// solver, factoring in double or in float with refinement in double
+template <nodal_precision Precision>
+void BM_netlist_port_sweep(benchmark::State& state) {
+	const std::size_t sections = static_cast<std::size_t>(state.range(0));
+	netlist net;
+	std::vector<std::unique_ptr<components>> parts;
+	std::size_t previous = net.add_node();
+	const std::size_t input = previous;
+	for (std::size_t i = 0; i < sections; ++i) {
+		const std::size_t node = net.add_node();
+		parts.push_back(std::make_unique<resistor>(10.0));
+		net.add_component(parts.back().get(), previous, node);
+		parts.push_back(std::make_unique<capacitor>(1e-7));
+		net.add_component(parts.back().get(), node, netlist::ground);
+		previous = node;
+	}
+	prepared_netlist prepared(net, Precision);
+	const std::vector<double> freqs = log_frequencies(64);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(prepared.sweep_port(input, netlist::ground, freqs));
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(freqs.size()));
+}
+BENCHMARK_TEMPLATE(BM_netlist_port_sweep, nodal_precision::full)->Arg(3)->Arg(10)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_netlist_port_sweep, nodal_precision::mixed)->Arg(3)->Arg(10)->Arg(100)->Arg(1000)->Arg(10000);
+
+// The same ladder reduced once over the band of the sweep, then each sweep is
+// through the reduced model
+void BM_reduced_port_sweep(benchmark::State& state) {
+	const std::size_t sections = static_cast<std::size_t>(state.range(0));
+	netlist net;
+	std::vector<std::unique_ptr<components>> parts;
+	std::size_t previous = net.add_node();
+	const std::size_t input = previous;
+	for (std::size_t i = 0; i < sections; ++i) {
+		const std::size_t node = net.add_node();
+		parts.push_back(std::make_unique<resistor>(10.0));
+		net.add_component(parts.back().get(), previous, node);
+		parts.push_back(std::make_unique<capacitor>(1e-7));
+		net.add_component(parts.back().get(), node, netlist::ground);
+		previous = node;
+	}
+	const std::vector<double> freqs = log_frequencies(64);
+	reduction_options options;
+	options.f_min = freqs.front();
+	options.f_max = freqs.back();
+	const reduced_model model = reduce_netlist(net, { { input, netlist::ground } }, options);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(model.sweep_port(freqs));
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(freqs.size()));
+}
+BENCHMARK(BM_reduced_port_sweep)->Arg(100)->Arg(1000)->Arg(10000);
+
+// Opening an RC ladder written as a netlist file: mapping it, checking the columns
+// and analysing the matrix pattern, ready for the first solve
+void BM_netlist_file_open(benchmark::State& state) {
+	const std::size_t sections = static_cast<std::size_t>(state.range(0));
+	netlist net;
+	std::vector<std::unique_ptr<components>> parts;
+	std::size_t previous = net.add_node();
+	for (std::size_t i = 0; i < sections; ++i) {
+		const std::size_t node = net.add_node();
+		parts.push_back(std::make_unique<resistor>(10.0));
+		net.add_component(parts.back().get(), previous, node);
+		parts.push_back(std::make_unique<capacitor>(1e-7));
+		net.add_component(parts.back().get(), node, netlist::ground);
+		previous = node;
+	}
+	const std::string path = "benchmark_ladder.acsn";
+	write_netlist_file(net, path);
+	for (auto _ : state) {
+		mapped_netlist mapped(path);
+		benchmark::DoNotOptimize(mapped.get_factor_nonzeros());
+	}
+	std::remove(path.c_str());
+	state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(2 * sections));
+}
+BENCHMARK(BM_netlist_file_open)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// End-to-end batch mode: parsing, evaluation and CSV formatting of 10^4 records
+void BM_batch_throughput(benchmark::State& state) {
+	std::string input;
+	for (int i = 0; i < 10000; ++i) {
+		const int type = 1 + i % 8;
+		input += std::to_string(type) + ' ' + std::to_string(100 + i) + (type <= 2 ? " 10 0.001 0.01\n" : " 10 0.001\n");
+	}
+	for (auto _ : state) {
+		std::istringstream in(input);
+		std::ostringstream out;
+		csv_sink sink(out);
+		benchmark::DoNotOptimize(run_batch(in, sink));
+	}
+	state.SetItemsProcessed(state.iterations() * 10000);
+	state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(input.size()));
+}
+BENCHMARK(BM_batch_throughput);
+
+// The same records as server requests: parsing, lockstep evaluation per type and
+// JSON responses, through one server that stays up across iterations. The reader
+// thread does the parsing, so the time is wall time.
+void BM_server_throughput(benchmark::State& state) {
+	std::string input;
+	for (int i = 0; i < 10000; ++i) {
+		const int type = 1 + i % 8;
+		input += "{\"id\":" + std::to_string(i) + ",\"op\":\"evaluate\",\"type\":" + std::to_string(type) +
+			",\"frequency\":" + std::to_string(100 + i) + (type <= 2 ? ",\"values\":[10,0.001,0.01]}\n" : ",\"values\":[10,0.001]}\n");
+	}
+	server_options options;
+	options.threads = 1;
+	simulation_server server(options);
+	for (auto _ : state) {
+		std::istringstream in(input);
+		std::ostringstream out;
+		server.run(in, out);
+		benchmark::DoNotOptimize(out.str().size());
+	}
+	state.SetItemsProcessed(state.iterations() * 10000);
+	state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(input.size()));
+}
+BENCHMARK(BM_server_throughput)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,4 @@
+# Package file for find_package(acs); provides the acs::acs target
+include(CMakeFindDependencyMacro)
+find_dependency(Threads)
+include("${CMAKE_CURRENT_LIST_DIR}/acsTargets.cmake")
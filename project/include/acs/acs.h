@@ -0,0 +1,24 @@
+﻿// Analogue circuit simulator engine. Include this header for everything, or the
+// individual headers for just the parts needed; link against the acs library.
+
+#pragma once
+
+#include "acs/instrument.h"
+#include "acs/components.h"
+#include "acs/fixed.h"
+#include "acs/kernels.h"
+#include "acs/circuit.h"
+#include "acs/nodal.h"
+#include "acs/transient.h"
+#include "acs/dc.h"
+#include "acs/parallel.h"
+#include "acs/lanes.h"
+#include "acs/adaptive.h"
+#include "acs/stream.h"
+#include "acs/arena.h"
+#include "acs/monte_carlo.h"
+#include "acs/cache.h"
+#include "acs/columnar.h"
+#include "acs/reduction.h"
+#include "acs/batch.h"
+#include "acs/server.h"
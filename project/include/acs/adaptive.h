@@ -0,0 +1,175 @@
+﻿#pragma once
+
+#include "acs/circuit.h"
+#include "acs/nodal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Adaptive sweep. A uniform grid either misses sharp resonances or wastes points
+// on the flat parts of the curve, so the sweep starts from a coarse log grid and
+// keeps halving (in log frequency) only those intervals whose midpoint does not
+// lie on the straight line between its ends, in dB and in phase. Where Im(Z)
+// changes sign between two samples the resonance is pinned down by bisection.
+
+struct adaptive_options
+{
+	// Allowed interpolation error of the curve between samples
+	double magnitude_tolerance_db = 0.1;
+	double phase_tolerance = pi / 180;
+	// Starting grid, and the limits that stop refinement
+	std::size_t initial_points_per_decade = 8;
+	std::size_t max_points = 20000;
+	double min_relative_spacing = 1e-9;
+};
+
+// Frequency where the impedance is real, with its magnitude there. 'peak' is true
+// for a maximum of |Z| (parallel resonance) and false for a minimum (series).
+// The quality factor is taken from the phase slope, Q = |d arg Z / d ln f| / 2,
+// which is f0 / bandwidth for a second-order resonance; it is infinite without loss.
+struct resonance
+{
+	double frequency;
+	double magnitude;
+	double quality_factor;
+	bool peak;
+};
+
+struct adaptive_result
+{
+	sweep_result curve;
+	std::vector<resonance> resonances;
+	std::size_t evaluations = 0;
+};
+
+// Adaptive sweep of any impedance model from f_start to f_stop. evaluate(freqs, n, z)
+// fills z with the impedance at n frequencies; each pass of the refinement is one call.
+template <typename Evaluate>
+adaptive_result adaptive_sweep(double f_start, double f_stop, const adaptive_options& options, Evaluate evaluate) {
+	if (!(f_start > 0) || !(f_stop > f_start)) {
+		throw std::invalid_argument("Error: Sweep needs 0 < start < stop.");
+	}
+	struct sample
+	{
+		double frequency;
+		std::complex<double> impedance;
+		bool settled;
+	};
+	adaptive_result result;
+	const double decades = std::log10(f_stop / f_start);
+	const std::size_t initial = std::max<std::size_t>(2,
+		static_cast<std::size_t>(std::ceil(decades * options.initial_points_per_decade)) + 1);
+	std::vector<sample> samples(initial);
+	std::vector<double> freqs(initial);
+	std::vector<std::complex<double>> z(initial);
+	for (std::size_t i = 0; i < initial; ++i) {
+		freqs[i] = f_start * std::pow(f_stop / f_start, static_cast<double>(i) / (initial - 1));
+	}
+	freqs.back() = f_stop;
+	evaluate(freqs.data(), initial, z.data());
+	result.evaluations += initial;
+	for (std::size_t i = 0; i < initial; ++i) {
+		samples[i] = { freqs[i], z[i], false };
+	}
+	auto db = [](std::complex<double> v) { return 20 * std::log10(std::abs(v)); };
+	// Each pass evaluates the midpoints of all unsettled intervals (an interval
+	// is named by its left sample) and splits those that fail the test
+	std::vector<sample> refined;
+	while (samples.size() < options.max_points) {
+		freqs.clear();
+		for (std::size_t i = 0; i + 1 < samples.size(); ++i) {
+			if (!samples[i].settled) {
+				if (samples[i + 1].frequency / samples[i].frequency - 1 < options.min_relative_spacing ||
+					samples.size() + freqs.size() >= options.max_points) {
+					samples[i].settled = true;
+				}
+				else {
+					freqs.push_back(std::sqrt(samples[i].frequency * samples[i + 1].frequency));
+				}
+			}
+		}
+		if (freqs.empty()) {
+			break;
+		}
+		z.resize(freqs.size());
+		evaluate(freqs.data(), freqs.size(), z.data());
+		result.evaluations += freqs.size();
+		refined.clear();
+		std::size_t k = 0;
+		for (std::size_t i = 0; i < samples.size(); ++i) {
+			refined.push_back(samples[i]);
+			if (i + 1 == samples.size() || samples[i].settled) {
+				continue;
+			}
+			const sample& a = samples[i];
+			const sample& b = samples[i + 1];
+			const std::complex<double> m = z[k++];
+			const double magnitude_error = std::abs(db(m) - 0.5 * (db(a.impedance) + db(b.impedance)));
+			// Halfway between the phases, taking the shorter way round
+			const double half = std::arg(a.impedance) + 0.5 * std::remainder(std::arg(b.impedance) - std::arg(a.impedance), 2 * pi);
+			const double phase_error = std::abs(std::remainder(std::arg(m) - half, 2 * pi));
+			// Written so that a NaN error (an open or short) also refines
+			const bool accurate = magnitude_error <= options.magnitude_tolerance_db && phase_error <= options.phase_tolerance;
+			refined.back().settled = accurate;
+			refined.push_back({ freqs[k - 1], m, accurate });
+		}
+		samples.swap(refined);
+	}
+	sweep_result& curve = result.curve;
+	for (const sample& p : samples) {
+		curve.frequency.push_back(p.frequency);
+		curve.magnitude.push_back(std::abs(p.impedance));
+		curve.phase.push_back(std::arg(p.impedance));
+	}
+	auto at = [&](double f) {
+		std::complex<double> v;
+		evaluate(&f, 1, &v);
+		++result.evaluations;
+		return v;
+	};
+	for (std::size_t i = 0; i + 1 < samples.size(); ++i) {
+		const double ya = samples[i].impedance.imag();
+		const double yb = samples[i + 1].impedance.imag();
+		if (!(ya < 0 && yb > 0) && !(ya > 0 && yb < 0)) {
+			continue;
+		}
+		// Bisect in log frequency on the sign of the reactance
+		double lo = samples[i].frequency;
+		double hi = samples[i + 1].frequency;
+		for (int iteration = 0; iteration < 100 && hi / lo - 1 > 1e-13; ++iteration) {
+			const double mid = std::sqrt(lo * hi);
+			if ((at(mid).imag() < 0) == (ya < 0)) {
+				lo = mid;
+			}
+			else {
+				hi = mid;
+			}
+		}
+		resonance r;
+		r.frequency = std::sqrt(lo * hi);
+		const std::complex<double> z0 = at(r.frequency);
+		r.magnitude = std::abs(z0);
+		r.peak = r.magnitude * r.magnitude >= std::abs(samples[i].impedance) * std::abs(samples[i + 1].impedance);
+		if (z0.real() == 0 || !std::isfinite(z0.real())) {
+			r.quality_factor = std::numeric_limits<double>::infinity();
+		}
+		else {
+			const double h = 1e-6;
+			const double slope = std::remainder(std::arg(at(r.frequency * std::exp(h))) - std::arg(at(r.frequency * std::exp(-h))), 2 * pi) / (2 * h);
+			r.quality_factor = 0.5 * std::abs(slope);
+		}
+		result.resonances.push_back(r);
+	}
+	return result;
+}
+
+// Adaptive sweep of a circuit
+adaptive_result adaptive_sweep(const circuit& c, double f_start, double f_stop, const adaptive_options& options = adaptive_options());
+
+// Adaptive sweep of the impedance between two nodes of a prepared netlist
+adaptive_result adaptive_sweep_port(prepared_netlist& prepared, std::size_t plus, std::size_t minus,
+	double f_start, double f_stop, const adaptive_options& options = adaptive_options());
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include "acs/instrument.h"
+
+#include <memory>
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator for short-lived objects. Objects made with create() live until
+// release(), which runs their destructors in reverse order and rewinds the
+// buffer in one step. Circuits built with get_resource() draw their storage
+// from the same buffer, so a whole batch of circuits costs no heap traffic once
+// the initial block is large enough.
+class arena
+{
+private:
+	struct cleanup
+	{
+		void (*destroy)(void*);
+		void* object;
+		cleanup* next;
+	};
+
+	std::unique_ptr<char[]> initial;
+	std::pmr::monotonic_buffer_resource resource;
+	cleanup* cleanups;
+
+public:
+	explicit arena(std::size_t initial_size = 1 << 16) :
+		initial(new char[initial_size]), resource(initial.get(), initial_size), cleanups(nullptr) {}
+	arena(const arena&) = delete;
+	arena& operator=(const arena&) = delete;
+	~arena() { release(); }
+
+	// Construct a T in the arena. The arena owns it; do not delete it
+	template<typename T, typename... Args>
+	T* create(Args&&... args) {
+		ACS_COUNT(allocations, 1);
+		void* node = std::is_trivially_destructible<T>::value ? nullptr : resource.allocate(sizeof(cleanup), alignof(cleanup));
+		void* memory = resource.allocate(sizeof(T), alignof(T));
+		T* object = ::new (memory) T(std::forward<Args>(args)...);
+		if (node != nullptr) {
+			cleanups = ::new (node) cleanup{ [](void* p) { static_cast<T*>(p)->~T(); }, object, cleanups };
+		}
+		return object;
+	}
+
+	// Destroy everything created so far and reuse the memory
+	void release() {
+		while (cleanups != nullptr) {
+			cleanup* current = cleanups;
+			cleanups = current->next;
+			current->destroy(current->object);
+		}
+		resource.release();
+	}
+
+	std::pmr::memory_resource* get_resource() { return &resource; }
+};
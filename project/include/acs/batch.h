@@ -0,0 +1,400 @@
+﻿#pragma once
+
+#include "acs/circuit.h"
+#include "acs/fixed.h"
+#include "acs/arena.h"
+#include "acs/adaptive.h"
+#include "acs/monte_carlo.h"
+#include "acs/parallel.h"
+#include "acs/stream.h"
+
+#include <algorithm>
+#include <charconv>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// Batch mode. Each input line describes one of the menu circuits as
+//   <type 1-8> <frequency> <values...>
+// with the values in the same order the interactive prompts ask for them
+// (R C L for types 1-2, R L for 3-4, R C for 5-6, C L for 7-8). Blank lines
+// and lines starting with '#' are ignored.
+
+// Number of component values expected for each menu circuit type
+const int menu_value_counts[9] = { 0, 3, 3, 2, 2, 2, 2, 2, 2 };
+
+// One parsed batch line
+struct circuit_record
+{
+	int type;
+	double frequency;
+	double values[3];
+};
+
+// Build menu circuit 'type' from its values. The circuit, its storage and its
+// components all live in 'pool' and are freed by pool.release()
+circuit* build_menu_circuit(int type, const double* values, arena& pool);
+
+// Impedance of menu circuit 'type' through its fixed-topology form, for evaluating
+// many variations of the same circuit
+std::complex<double> menu_circuit_impedance(int type, const double* values, double f);
+
+// Reads lines from a stream in large blocks. Lines are returned as pointers into
+// the block, so reading does not allocate once the buffer has reached its size.
+class line_reader
+{
+private:
+	std::istream& in;
+	std::vector<char> buffer;
+	std::size_t begin;
+	std::size_t end;
+	bool at_eof;
+	std::size_t line_number;
+
+	// Move the unread tail to the front and top the buffer up from the stream
+	void refill() {
+		ACS_TIMED(read);
+		std::copy(buffer.begin() + begin, buffer.begin() + end, buffer.begin());
+		end -= begin;
+		begin = 0;
+		if (end == buffer.size()) {
+			buffer.resize(buffer.size() * 2);
+		}
+		in.read(buffer.data() + end, static_cast<std::streamsize>(buffer.size() - end));
+		end += static_cast<std::size_t>(in.gcount());
+		at_eof = !in;
+	}
+public:
+	explicit line_reader(std::istream& stream, std::size_t block = 1 << 20) :
+		in(stream), buffer(block), begin(0), end(0), at_eof(false), line_number(0) {}
+	~line_reader() {}
+	// Next line without its newline; returns false at the end of the input
+	bool next(const char*& first, const char*& last) {
+		for (;;) {
+			const char* data = buffer.data();
+			const void* newline = std::memchr(data + begin, '\n', end - begin);
+			if (newline != nullptr) {
+				first = data + begin;
+				last = static_cast<const char*>(newline);
+				begin = static_cast<std::size_t>(last - data) + 1;
+				++line_number;
+				return true;
+			}
+			if (at_eof) {
+				if (begin == end) {
+					return false;
+				}
+				first = data + begin;
+				last = data + end;
+				begin = end;
+				++line_number;
+				return true;
+			}
+			refill();
+		}
+	}
+	std::size_t get_line_number() const {
+		return line_number;
+	}
+};
+
+const char* skip_blanks(const char* p, const char* last);
+
+// Parse one batch line. Returns false for blank and comment lines and throws
+// std::invalid_argument for malformed ones.
+bool parse_record(const char* p, const char* last, circuit_record& record);
+
+// ASCII diagram of each menu circuit type
+const char* menu_circuit_diagram(int type);
+
+// One evaluated batch record as passed to the output sinks
+struct result_record
+{
+	circuit_record input;
+	double magnitude;
+	double phase;
+};
+
+// Destination for batch results. Records are formatted into a large buffer that
+// is only written to the stream when full or when the sink is flushed, so there is
+// no flush per record.
+class output_sink
+{
+private:
+	std::ostream& out;
+	std::vector<char> buffer;
+	std::size_t used;
+protected:
+	void write_bytes(const void* data, std::size_t n) {
+		if (used + n > buffer.size()) {
+			flush_buffer();
+			if (n > buffer.size()) {
+				out.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+				return;
+			}
+		}
+		std::memcpy(buffer.data() + used, data, n);
+		used += n;
+	}
+	void write_text(const char* s) {
+		write_bytes(s, std::strlen(s));
+	}
+	void write_char(char c) {
+		write_bytes(&c, 1);
+	}
+	// Shortest decimal form that reads back to the same double
+	void write_number(double x) {
+		char digits[32];
+		const std::to_chars_result r = std::to_chars(digits, digits + sizeof(digits), x);
+		write_bytes(digits, static_cast<std::size_t>(r.ptr - digits));
+	}
+	void write_number(int x) {
+		char digits[16];
+		const std::to_chars_result r = std::to_chars(digits, digits + sizeof(digits), x);
+		write_bytes(digits, static_cast<std::size_t>(r.ptr - digits));
+	}
+	void flush_buffer() {
+		ACS_TIMED(write);
+		out.write(buffer.data(), static_cast<std::streamsize>(used));
+		used = 0;
+	}
+public:
+	explicit output_sink(std::ostream& stream, std::size_t capacity = 1 << 20) :
+		out(stream), buffer(capacity), used(0) {}
+	virtual ~output_sink() {}
+	output_sink(const output_sink&) = delete;
+	output_sink& operator=(const output_sink&) = delete;
+	// Called once before the first record
+	virtual void begin() {}
+	virtual void write(const result_record& record) = 0;
+	// Monte Carlo summaries: whether the format supports them, a header, and one summary per record
+	virtual bool has_statistics() const {
+		return false;
+	}
+	virtual void begin_statistics() {}
+	virtual void write_statistics(const circuit_record& /*input*/, const monte_carlo_result& /*result*/) {
+		throw std::logic_error("Error: This output format does not support Monte Carlo results.");
+	}
+	// Write out everything buffered so far
+	void flush() {
+		flush_buffer();
+		out.flush();
+	}
+};
+
+// Comma separated values with a header line
+class csv_sink : public output_sink
+{
+public:
+	explicit csv_sink(std::ostream& stream) : output_sink(stream) {}
+	~csv_sink() {}
+	void begin() override {
+		write_text("type,frequency,magnitude,phase\n");
+	}
+	void write(const result_record& record) override {
+		write_number(record.input.type);
+		write_char(',');
+		write_number(record.input.frequency);
+		write_char(',');
+		write_number(record.magnitude);
+		write_char(',');
+		write_number(record.phase);
+		write_char('\n');
+	}
+	bool has_statistics() const override {
+		return true;
+	}
+	void begin_statistics() override {
+		write_text("type,frequency,samples,yield,non_finite,mean,stddev,min,max,p05,p50,p95,phase_mean,phase_stddev\n");
+	}
+	void write_statistics(const circuit_record& input, const monte_carlo_result& result) override {
+		const monte_carlo_point& p = result.points[0];
+		write_number(input.type);
+		write_char(',');
+		write_number(input.frequency);
+		write_char(',');
+		write_number(static_cast<double>(result.samples));
+		write_char(',');
+		write_number(result.get_yield());
+		write_char(',');
+		write_number(static_cast<double>(p.magnitude.get_non_finite_count()));
+		for (double x : { p.magnitude.get_mean(), p.magnitude.get_standard_deviation(), p.magnitude.get_minimum(),
+			p.magnitude.get_maximum(), p.magnitude_quantiles.quantile(0.05), p.magnitude_quantiles.quantile(0.5),
+			p.magnitude_quantiles.quantile(0.95), p.phase.get_mean(), p.phase.get_standard_deviation() }) {
+			write_char(',');
+			write_number(x);
+		}
+		write_char('\n');
+	}
+};
+
+// One JSON object per line
+class jsonl_sink : public output_sink
+{
+public:
+	explicit jsonl_sink(std::ostream& stream) : output_sink(stream) {}
+	~jsonl_sink() {}
+	void write(const result_record& record) override {
+		write_text("{\"type\":");
+		write_number(record.input.type);
+		write_text(",\"frequency\":");
+		write_number(record.input.frequency);
+		write_text(",\"magnitude\":");
+		write_number(record.magnitude);
+		write_text(",\"phase\":");
+		write_number(record.phase);
+		write_text("}\n");
+	}
+	bool has_statistics() const override {
+		return true;
+	}
+	void write_statistics(const circuit_record& input, const monte_carlo_result& result) override {
+		const monte_carlo_point& p = result.points[0];
+		write_text("{\"type\":");
+		write_number(input.type);
+		write_text(",\"frequency\":");
+		write_number(input.frequency);
+		write_text(",\"samples\":");
+		write_number(static_cast<double>(result.samples));
+		write_text(",\"yield\":");
+		write_number(result.get_yield());
+		write_text(",\"non_finite\":");
+		write_number(static_cast<double>(p.magnitude.get_non_finite_count()));
+		write_text(",\"mean\":");
+		write_number(p.magnitude.get_mean());
+		write_text(",\"stddev\":");
+		write_number(p.magnitude.get_standard_deviation());
+		write_text(",\"min\":");
+		write_number(p.magnitude.get_minimum());
+		write_text(",\"max\":");
+		write_number(p.magnitude.get_maximum());
+		write_text(",\"p05\":");
+		write_number(p.magnitude_quantiles.quantile(0.05));
+		write_text(",\"p50\":");
+		write_number(p.magnitude_quantiles.quantile(0.5));
+		write_text(",\"p95\":");
+		write_number(p.magnitude_quantiles.quantile(0.95));
+		write_text(",\"phase_mean\":");
+		write_number(p.phase.get_mean());
+		write_text(",\"phase_stddev\":");
+		write_number(p.phase.get_standard_deviation());
+		write_text("}\n");
+	}
+};
+
+// Compact binary: a 16 byte header ("ACSR", version, record size, byte order mark)
+// followed by fixed 32 byte records of int32 type, 4 bytes padding, and the
+// frequency, magnitude and phase as doubles in native byte order
+class binary_sink : public output_sink
+{
+public:
+	explicit binary_sink(std::ostream& stream) : output_sink(stream) {}
+	~binary_sink() {}
+	void begin() override {
+		const std::uint32_t header[4] = { 0x52534341u, 1u, 32u, 0x01020304u };
+		write_bytes(header, sizeof(header));
+	}
+	void write(const result_record& record) override {
+		unsigned char bytes[32] = {};
+		const std::int32_t type = record.input.type;
+		std::memcpy(bytes, &type, 4);
+		std::memcpy(bytes + 8, &record.input.frequency, 8);
+		std::memcpy(bytes + 16, &record.magnitude, 8);
+		std::memcpy(bytes + 24, &record.phase, 8);
+		write_bytes(bytes, sizeof(bytes));
+	}
+};
+
+// Human-readable report in the same wording as the interactive mode, with the
+// per-component breakdown and circuit diagram as options
+class text_sink : public output_sink
+{
+private:
+	bool show_components;
+	bool show_diagram;
+
+	void write_line(const char* label, double value, const char* unit) {
+		write_text(label);
+		write_number(value);
+		write_text(unit);
+	}
+	void write_component(const components& part) {
+		write_text("Type: ");
+		write_text(part.get_type().c_str());
+		write_line("\nImpedance Magnitude: ", part.get_impedance_magnitude(), " Ohms\n");
+		write_line("Phase Shift: ", part.get_phase_difference(), " rad\n\n");
+	}
+public:
+	text_sink(std::ostream& stream, bool components_shown, bool diagram_shown) :
+		output_sink(stream), show_components(components_shown), show_diagram(diagram_shown) {}
+	~text_sink() {}
+	void write(const result_record& record) override {
+		const circuit_record& in = record.input;
+		write_line("Total Impedance Magnitude at ", in.frequency, "Hz: ");
+		write_line("", record.magnitude, " Ohms\n");
+		write_line("Total Phase Difference: ", record.phase, " rad\n\n");
+		if (show_components) {
+			write_text("Component Impedances and Phase Shifts:\n");
+			const bool has_resistor = in.type <= 6;
+			const bool has_capacitor = in.type != 3 && in.type != 4;
+			const bool has_inductor = in.type != 5 && in.type != 6;
+			// Types 7 and 8 take C then L, and list the inductor first like the menu does
+			const double r = in.values[0];
+			const double c = in.type >= 7 ? in.values[0] : in.values[1];
+			const double l = in.type >= 7 ? in.values[1] : in.values[in.type <= 2 ? 2 : 1];
+			resistor rp(r);
+			capacitor cp(c);
+			inductor lp(l);
+			rp.set_frequency(in.frequency);
+			cp.set_frequency(in.frequency);
+			lp.set_frequency(in.frequency);
+			if (has_resistor) {
+				write_component(rp);
+			}
+			if (in.type >= 7) {
+				write_component(lp);
+				write_component(cp);
+			}
+			else {
+				if (has_capacitor) {
+					write_component(cp);
+				}
+				if (has_inductor) {
+					write_component(lp);
+				}
+			}
+		}
+		if (show_diagram) {
+			write_text("Circuit Diagram: \n");
+			write_text(menu_circuit_diagram(in.type));
+			write_char('\n');
+		}
+	}
+};
+
+// Evaluate every record in 'in' and write the results to 'sink'. Records are
+// handled in batches whose circuits share one arena, released after each batch.
+// Bad lines are reported on stderr and skipped; returns the number of bad lines.
+std::size_t run_batch(std::istream& in, output_sink& sink);
+
+// Monte Carlo over every record in 'in': each record is the nominal circuit, its
+// values vary by 'relative' (uniformly), and one summary per record goes to 'sink'.
+// Limits in 'options' hold a single entry for the record's frequency.
+std::size_t run_monte_carlo_batch(std::istream& in, output_sink& sink, const monte_carlo_options& options,
+	double relative, thread_pool& pool);
+
+// Adaptive sweep of every record in 'in' from f_start to f_stop, ignoring the
+// record's own frequency. Each point of the curve goes to 'sink' as a record of
+// its own; the resonances found are reported on the log stream.
+std::size_t run_adaptive_batch(std::istream& in, output_sink& sink, double f_start, double f_stop,
+	const adaptive_options& options);
+
+// Sweep of every record in 'in' over the grid, ignoring the record's own
+// frequency. Each point goes to 'sink' as a record of its own. The curve is
+// streamed a chunk at a time, with the next chunk computed while the current one
+// is written, so memory use does not grow with the number of points.
+std::size_t run_sweep_batch(std::istream& in, output_sink& sink, const frequency_grid& grid, std::size_t chunk = 4096);
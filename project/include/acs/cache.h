@@ -0,0 +1,226 @@
+﻿#pragma once
+
+#include "acs/circuit.h"
+#include "acs/monte_carlo.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Memoised sweeps. Requests for the same circuit over the same grid are common,
+// so results are kept in a least-recently-used cache keyed by the circuit's
+// canonical form and the frequencies. An optional directory keeps a copy of
+// every result on disk, so the cache survives restarts.
+
+// 64-bit hash of a byte string, a word at a time through mix64
+std::uint64_t hash_bytes(const std::string& bytes);
+
+struct cache_statistics
+{
+	std::size_t hits = 0;
+	std::size_t disk_hits = 0;
+	std::size_t misses = 0;
+	std::size_t evictions = 0;
+	std::size_t entries = 0;
+	std::size_t bytes = 0;
+};
+
+// Bounded LRU cache of sweeps, safe to share between threads. Entries are checked
+// against their full key, so a hash collision is a miss rather than a wrong result.
+// A miss is computed outside the lock, so other lookups are not held up.
+class sweep_cache
+{
+private:
+	struct entry
+	{
+		std::string key;
+		std::uint64_t hash;
+		std::shared_ptr<const sweep_result> result;
+		std::size_t bytes;
+	};
+	std::size_t capacity;
+	std::filesystem::path directory;
+	std::list<entry> entries;
+	std::unordered_map<std::uint64_t, std::list<entry>::iterator> index;
+	cache_statistics statistics;
+	mutable std::mutex lock;
+
+	static std::string make_key(const circuit& c, const std::vector<double>& freqs) {
+		std::string key;
+		c.append_canonical_form(key);
+		const std::uint64_t n = freqs.size();
+		key.append(reinterpret_cast<const char*>(&n), sizeof(n));
+		key.append(reinterpret_cast<const char*>(freqs.data()), freqs.size() * sizeof(double));
+		return key;
+	}
+	std::filesystem::path file_for(std::uint64_t hash) const {
+		char name[24];
+		std::snprintf(name, sizeof(name), "%016llx.acsc", static_cast<unsigned long long>(hash));
+		return directory / name;
+	}
+	// Disk entries hold "ACSC", a version, the key and the three arrays of 'points'
+	// values each. Anything that does not match exactly is ignored.
+	std::shared_ptr<const sweep_result> load(const std::string& key, std::uint64_t hash, std::size_t points) const {
+		std::ifstream file(file_for(hash), std::ios::binary);
+		char magic[4];
+		std::uint32_t version = 0;
+		std::uint64_t key_size = 0;
+		if (!file.read(magic, 4) || std::memcmp(magic, "ACSC", 4) != 0 ||
+			!file.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != 1 ||
+			!file.read(reinterpret_cast<char*>(&key_size), sizeof(key_size)) || key_size != key.size()) {
+			return nullptr;
+		}
+		std::string stored(key.size(), '\0');
+		if (!file.read(&stored[0], key_size) || stored != key) {
+			return nullptr;
+		}
+		std::uint64_t n = 0;
+		if (!file.read(reinterpret_cast<char*>(&n), sizeof(n)) || n != points) {
+			return nullptr;
+		}
+		auto result = std::make_shared<sweep_result>();
+		result->frequency.resize(n);
+		result->magnitude.resize(n);
+		result->phase.resize(n);
+		file.read(reinterpret_cast<char*>(result->frequency.data()), n * sizeof(double));
+		file.read(reinterpret_cast<char*>(result->magnitude.data()), n * sizeof(double));
+		file.read(reinterpret_cast<char*>(result->phase.data()), n * sizeof(double));
+		return file ? result : nullptr;
+	}
+	// Written to a temporary name and renamed, so a reader never sees half a file
+	void store(const std::string& key, std::uint64_t hash, const sweep_result& result) const {
+		const std::filesystem::path target = file_for(hash);
+		std::filesystem::path temporary = target;
+		temporary += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			const std::uint32_t version = 1;
+			const std::uint64_t key_size = key.size();
+			const std::uint64_t n = result.frequency.size();
+			file.write("ACSC", 4);
+			file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+			file.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+			file.write(key.data(), key.size());
+			file.write(reinterpret_cast<const char*>(&n), sizeof(n));
+			file.write(reinterpret_cast<const char*>(result.frequency.data()), n * sizeof(double));
+			file.write(reinterpret_cast<const char*>(result.magnitude.data()), n * sizeof(double));
+			file.write(reinterpret_cast<const char*>(result.phase.data()), n * sizeof(double));
+			if (!file) {
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, target, error);
+		if (error) {
+			std::filesystem::remove(temporary, error);
+		}
+	}
+	// Add an entry at the front and evict from the back until within capacity
+	void insert(std::string key, std::uint64_t hash, std::shared_ptr<const sweep_result> result) {
+		const std::size_t bytes = key.size() + 3 * result->frequency.size() * sizeof(double);
+		const auto found = index.find(hash);
+		if (found != index.end()) {
+			statistics.bytes -= found->second->bytes;
+			entries.erase(found->second);
+			index.erase(found);
+		}
+		entries.push_front({ std::move(key), hash, std::move(result), bytes });
+		index[hash] = entries.begin();
+		statistics.bytes += bytes;
+		while (statistics.bytes > capacity && entries.size() > 1) {
+			statistics.bytes -= entries.back().bytes;
+			index.erase(entries.back().hash);
+			entries.pop_back();
+			++statistics.evictions;
+		}
+		statistics.entries = entries.size();
+	}
+	// Entry for a key from memory or, failing that, from disk; null if there is none
+	std::shared_ptr<const sweep_result> lookup(const std::string& key, std::uint64_t hash, std::size_t points) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			const auto found = index.find(hash);
+			if (found != index.end() && found->second->key == key) {
+				entries.splice(entries.begin(), entries, found->second);
+				++statistics.hits;
+				ACS_COUNT(cache_hits, 1);
+				return found->second->result;
+			}
+		}
+		std::shared_ptr<const sweep_result> result = directory.empty() ? nullptr : load(key, hash, points);
+		if (result != nullptr) {
+			std::lock_guard<std::mutex> guard(lock);
+			++statistics.disk_hits;
+			ACS_COUNT(cache_hits, 1);
+			insert(key, hash, result);
+		}
+		return result;
+	}
+	// Keep a newly computed result, which counts as a miss
+	void keep(std::string key, std::uint64_t hash, std::shared_ptr<const sweep_result> result) {
+		if (!directory.empty()) {
+			store(key, hash, *result);
+		}
+		std::lock_guard<std::mutex> guard(lock);
+		++statistics.misses;
+		ACS_COUNT(cache_misses, 1);
+		insert(std::move(key), hash, std::move(result));
+	}
+public:
+	// capacity is the memory budget in bytes; an empty directory means memory only
+	explicit sweep_cache(std::size_t capacity_bytes, const std::string& disk_directory = "") :
+		capacity(capacity_bytes), directory(disk_directory) {
+		if (!directory.empty()) {
+			std::filesystem::create_directories(directory);
+		}
+	}
+	~sweep_cache() {}
+	sweep_cache(const sweep_cache&) = delete;
+	sweep_cache& operator=(const sweep_cache&) = delete;
+	// Sweep of c over freqs, from the cache when the same circuit and grid were seen before
+	std::shared_ptr<const sweep_result> sweep(const circuit& c, const std::vector<double>& freqs) {
+		std::string key = make_key(c, freqs);
+		const std::uint64_t hash = hash_bytes(key);
+		std::shared_ptr<const sweep_result> result = lookup(key, hash, freqs.size());
+		if (result == nullptr) {
+			result = std::make_shared<const sweep_result>(c.sweep(freqs));
+			keep(std::move(key), hash, result);
+		}
+		return result;
+	}
+	// The cached sweep of c over freqs, or null when it still has to be computed, for
+	// callers that compute their misses another way (such as many at once in lanes)
+	std::shared_ptr<const sweep_result> find(const circuit& c, const std::vector<double>& freqs) {
+		const std::string key = make_key(c, freqs);
+		return lookup(key, hash_bytes(key), freqs.size());
+	}
+	// Keep the result of such a miss
+	void add(const circuit& c, const std::vector<double>& freqs, std::shared_ptr<const sweep_result> result) {
+		std::string key = make_key(c, freqs);
+		const std::uint64_t hash = hash_bytes(key);
+		keep(std::move(key), hash, std::move(result));
+	}
+	cache_statistics get_statistics() const {
+		std::lock_guard<std::mutex> guard(lock);
+		return statistics;
+	}
+	// Drop everything held in memory; files on disk are kept
+	void clear() {
+		std::lock_guard<std::mutex> guard(lock);
+		entries.clear();
+		index.clear();
+		statistics.entries = 0;
+		statistics.bytes = 0;
+	}
+};
@@ -0,0 +1,908 @@
+﻿// Series and parallel circuit trees, and their rational-function form
+#pragma once
+
+#include "acs/components.h"
+#include "acs/fixed.h"
+#include "acs/kernels.h"
+#include "acs/instrument.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class circuit;
+
+// Derivative of a circuit's impedance with respect to one component's value
+struct component_sensitivity
+{
+	// Circuit holding the component: the one asked, or one of its sub-circuits
+	const circuit* owner;
+	component_id id;
+	component_kind kind;
+	// dZ, d|Z| and d arg(Z) per unit of the component's value
+	std::complex<double> impedance;
+	double magnitude;
+	double phase;
+};
+
+// Way in which the components of a circuit are connected
+enum class connection { series, parallel };
+
+// Bode curve of a circuit: magnitude and phase at each swept frequency
+struct sweep_result
+{
+	std::vector<double> frequency;
+	std::vector<double> magnitude;
+	std::vector<double> phase;
+};
+
+// Rational form of an impedance. For series and parallel trees Z(s) is a ratio of
+// polynomials in s; once built, a sweep point is one Horner evaluation of each
+// instead of a walk over the components, and the poles and zeros come for free.
+
+// Polynomial with real coefficients, lowest power first
+class polynomial
+{
+private:
+	std::vector<double> coefficients;
+public:
+	polynomial() {}
+	polynomial(std::initializer_list<double> c) : coefficients(c) { trim(); }
+	explicit polynomial(std::vector<double> c) : coefficients(std::move(c)) { trim(); }
+	~polynomial() {}
+	// Drop zero coefficients of the highest powers
+	void trim() {
+		while (!coefficients.empty() && coefficients.back() == 0) {
+			coefficients.pop_back();
+		}
+	}
+	bool is_zero() const {
+		return coefficients.empty();
+	}
+	std::size_t get_degree() const {
+		return coefficients.empty() ? 0 : coefficients.size() - 1;
+	}
+	const std::vector<double>& get_coefficients() const {
+		return coefficients;
+	}
+	// Power of the lowest non-zero term, so that x^k divides the polynomial
+	std::size_t get_lowest_power() const {
+		std::size_t k = 0;
+		while (k < coefficients.size() && coefficients[k] == 0) {
+			++k;
+		}
+		return k;
+	}
+	// Divide by x^k, which must divide the polynomial
+	void divide_by_power(std::size_t k) {
+		coefficients.erase(coefficients.begin(), coefficients.begin() + std::min(k, coefficients.size()));
+	}
+	double get_max_coefficient() const {
+		double m = 0;
+		for (double c : coefficients) {
+			m = std::max(m, std::abs(c));
+		}
+		return m;
+	}
+	polynomial& operator*=(double k) {
+		for (double& c : coefficients) {
+			c *= k;
+		}
+		trim();
+		return *this;
+	}
+	// Value at x by Horner's method
+	std::complex<double> evaluate(std::complex<double> x) const {
+		std::complex<double> sum = 0.0;
+		for (std::size_t i = coefficients.size(); i-- > 0;) {
+			sum = sum * x + coefficients[i];
+		}
+		return sum;
+	}
+	// Value at x = j y. Each Horner step multiplies by an imaginary number, which
+	// is a swap and two real products rather than a full complex multiply.
+	std::complex<double> evaluate_imaginary(double y) const {
+		double re = 0;
+		double im = 0;
+		for (std::size_t i = coefficients.size(); i-- > 0;) {
+			const double t = re;
+			re = coefficients[i] - im * y;
+			im = t * y;
+		}
+		return { re, im };
+	}
+	// All roots by the Aberth-Ehrlich iteration, which refines the whole set at once
+	// and converges cubically for simple roots. Tiny imaginary parts are cleared so
+	// real roots come out real.
+	std::vector<std::complex<double>> roots() const {
+		std::vector<std::complex<double>> result(get_lowest_power(), 0.0);
+		polynomial p = *this;
+		p.divide_by_power(result.size());
+		const std::size_t n = p.get_degree();
+		if (p.is_zero() || n == 0) {
+			return result;
+		}
+		const std::vector<double>& c = p.coefficients;
+		polynomial derivative;
+		for (std::size_t i = 1; i <= n; ++i) {
+			derivative.coefficients.push_back(c[i] * static_cast<double>(i));
+		}
+		// Start on a circle of the roots' geometric mean radius, off the real axis
+		const double radius = std::pow(std::abs(c[0] / c[n]), 1.0 / static_cast<double>(n));
+		std::vector<std::complex<double>> z(n);
+		for (std::size_t k = 0; k < n; ++k) {
+			z[k] = std::polar(radius, 2 * pi * static_cast<double>(k) / static_cast<double>(n) + 0.4);
+		}
+		for (int iteration = 0; iteration < 500; ++iteration) {
+			double largest = 0;
+			for (std::size_t k = 0; k < n; ++k) {
+				const std::complex<double> value = p.evaluate(z[k]);
+				if (value == 0.0) {
+					continue;
+				}
+				const std::complex<double> ratio = value / derivative.evaluate(z[k]);
+				std::complex<double> repulsion = 0.0;
+				for (std::size_t j = 0; j < n; ++j) {
+					if (j != k) {
+						repulsion += 1.0 / (z[k] - z[j]);
+					}
+				}
+				const std::complex<double> step = ratio / (1.0 - ratio * repulsion);
+				z[k] -= step;
+				largest = std::max(largest, std::abs(step) / std::max(std::abs(z[k]), std::numeric_limits<double>::min()));
+			}
+			if (largest < 1e-15) {
+				break;
+			}
+		}
+		for (std::complex<double>& root : z) {
+			if (std::abs(root.imag()) < 1e-12 * std::abs(root)) {
+				root.imag(0.0);
+			}
+			result.push_back(root);
+		}
+		return result;
+	}
+	friend polynomial operator+(const polynomial& a, const polynomial& b) {
+		std::vector<double> c(std::max(a.coefficients.size(), b.coefficients.size()), 0.0);
+		for (std::size_t i = 0; i < a.coefficients.size(); ++i) {
+			c[i] += a.coefficients[i];
+		}
+		for (std::size_t i = 0; i < b.coefficients.size(); ++i) {
+			c[i] += b.coefficients[i];
+		}
+		return polynomial(std::move(c));
+	}
+	friend polynomial operator*(const polynomial& a, const polynomial& b) {
+		if (a.is_zero() || b.is_zero()) {
+			return polynomial();
+		}
+		std::vector<double> c(a.coefficients.size() + b.coefficients.size() - 1, 0.0);
+		for (std::size_t i = 0; i < a.coefficients.size(); ++i) {
+			for (std::size_t j = 0; j < b.coefficients.size(); ++j) {
+				c[i + j] += a.coefficients[i] * b.coefficients[j];
+			}
+		}
+		return polynomial(std::move(c));
+	}
+	friend bool operator==(const polynomial& a, const polynomial& b) {
+		return a.coefficients == b.coefficients;
+	}
+};
+
+// Z = numerator / denominator as polynomials in x = s / omega_ref, where omega_ref is
+// 2 pi times a reference frequency. Working in x rather than s keeps the coefficients
+// near 1 for frequencies near the reference, which Horner's method needs at high order.
+// Common powers of x are cancelled, but common factors between sub-circuits are not,
+// so the order may be above the minimal one.
+class rational_impedance
+{
+private:
+	polynomial numerator;
+	polynomial denominator;
+	double reference_omega;
+public:
+	rational_impedance(polynomial n, polynomial d, double reference_frequency) :
+		numerator(std::move(n)), denominator(std::move(d)), reference_omega(2 * pi * reference_frequency) {}
+	~rational_impedance() {}
+	// a/b + c/d, left in a/b
+	static void add(polynomial& a, polynomial& b, const polynomial& c, const polynomial& d) {
+		if (b == d) {
+			a = a + c;
+		}
+		else {
+			a = a * d + c * b;
+			b = b * d;
+		}
+		reduce(a, b);
+	}
+	// Cancel common powers of x and scale so the coefficients stay near 1
+	static void reduce(polynomial& a, polynomial& b) {
+		if (a.is_zero() || b.is_zero()) {
+			return;
+		}
+		const std::size_t k = std::min(a.get_lowest_power(), b.get_lowest_power());
+		a.divide_by_power(k);
+		b.divide_by_power(k);
+		const double scale = 1.0 / b.get_max_coefficient();
+		a *= scale;
+		b *= scale;
+	}
+	std::complex<double> impedance_at(double f) const {
+		const double y = 2 * pi * f / reference_omega;
+		return numerator.evaluate_imaginary(y) / denominator.evaluate_imaginary(y);
+	}
+	// Magnitude and phase at n frequencies
+	void sweep(const double* freqs, std::size_t n, double* magnitude, double* phase) const {
+		ACS_TIMED(sweep);
+		ACS_COUNT(evaluations, n);
+		std::vector<double> re(n);
+		std::vector<double> im(n);
+		const double scale = 2 * pi / reference_omega;
+		for (std::size_t i = 0; i < n; ++i) {
+			const std::complex<double> z = numerator.evaluate_imaginary(freqs[i] * scale) /
+				denominator.evaluate_imaginary(freqs[i] * scale);
+			re[i] = z.real();
+			im[i] = z.imag();
+		}
+		get_sweep_kernels().magnitude(re.data(), im.data(), n, magnitude);
+		for (std::size_t i = 0; i < n; ++i) {
+			phase[i] = std::atan2(im[i], re[i]);
+		}
+	}
+	sweep_result sweep(const std::vector<double>& freqs) const {
+		sweep_result result;
+		result.frequency = freqs;
+		result.magnitude.resize(freqs.size());
+		result.phase.resize(freqs.size());
+		sweep(freqs.data(), freqs.size(), result.magnitude.data(), result.phase.data());
+		return result;
+	}
+	// Poles and zeros in the s-plane, in rad/s
+	std::vector<std::complex<double>> get_poles() const {
+		std::vector<std::complex<double>> r = denominator.roots();
+		for (std::complex<double>& p : r) {
+			p *= reference_omega;
+		}
+		return r;
+	}
+	std::vector<std::complex<double>> get_zeros() const {
+		std::vector<std::complex<double>> r = numerator.roots();
+		for (std::complex<double>& z : r) {
+			z *= reference_omega;
+		}
+		return r;
+	}
+	std::size_t get_order() const {
+		return std::max(numerator.get_degree(), denominator.get_degree());
+	}
+	const polynomial& get_numerator() const {
+		return numerator;
+	}
+	const polynomial& get_denominator() const {
+		return denominator;
+	}
+	double get_reference_frequency() const {
+		return reference_omega / (2 * pi);
+	}
+};
+
+// Generic circuit class which stores total impedance and phase difference of the whole circuit.
+// Component values are copied into per-type arrays when added, so the component
+// objects only act as a way of describing the parts. Running sums of the series
+// impedance and parallel admittance terms are kept up to date as parts are added,
+// removed or replaced, so each of those operations costs O(1). The one exception is
+// removing a part whose term is not finite (a 0 Ohm resistor in parallel) or larger
+// than what is left of its sum: subtracting it would leave mostly rounding error, so
+// the sums are rebuilt from the arrays instead.
+//
+// A circuit can also hold other circuits, which are combined with its own parts in
+// series or in parallel, giving a tree of nested sub-circuits. Every node caches its
+// impedance and is marked dirty when something below it changes; only the dirty path
+// to the root is re-evaluated the next time an impedance is read. Sub-circuits are
+// owned by the caller and must outlive the circuit they are added to.
+class circuit 
+{
+private:
+	// Position of a component id in the arrays
+	struct slot
+	{
+		component_kind kind;
+		std::size_t index;
+		bool in_use;
+	};
+	// Sub-circuit together with the impedance it currently contributes to the sums
+	struct child_entry
+	{
+		circuit* node;
+		std::complex<double> contribution;
+		bool counted;
+		bool queued;
+	};
+	component_arrays arrays;
+	std::pmr::vector<slot> slots;
+	std::pmr::vector<std::pmr::vector<component_id>> owners;
+	// Frequency-independent sums: R, L and 1/C for series, 1/R, C and 1/L for parallel
+	double series_resistance;
+	double series_inductance;
+	double series_elastance;
+	double parallel_conductance;
+	double parallel_capacitance;
+	double parallel_inverse_inductance;
+	// Diode terms, and the series impedance of transistors, evaluated at the current frequency
+	std::complex<double> junction_impedance_sum;
+	std::complex<double> diode_admittance_sum;
+	// Sub-circuits and the sums of their impedances and admittances
+	mutable std::pmr::vector<child_entry> children;
+	mutable std::pmr::vector<std::size_t> dirty_children;
+	mutable std::complex<double> child_impedance_sum;
+	mutable std::complex<double> child_admittance_sum;
+	circuit* parent;
+	std::size_t index_in_parent;
+	mutable std::complex<double> total_impedance; 
+	mutable bool dirty;
+	double frequency;
+	connection topology;
+
+	std::complex<double> diode_impedance(std::size_t i) const {
+		return diode::impedance_of(frequency, arrays.diode_capacitances[i],
+			arrays.diode_resistances[i], arrays.diode_conductances[i]);
+	}
+	std::complex<double> transistor_impedance(std::size_t i) const {
+		return 1.0 / std::complex<double>(arrays.transistor_conductances[i], 2 * pi * frequency * arrays.transistor_capacitances[i]);
+	}
+	// Add entry i of a kind to the running sums
+	void accumulate(component_kind kind, std::size_t i) {
+		switch (kind) {
+		case component_kind::resistor:
+			series_resistance += arrays.resistances[i];
+			parallel_conductance += 1.0 / arrays.resistances[i];
+			break;
+		case component_kind::transistor:
+			// In parallel r_o and C_mu join the frequency-independent sums
+			junction_impedance_sum += transistor_impedance(i);
+			parallel_conductance += arrays.transistor_conductances[i];
+			parallel_capacitance += arrays.transistor_capacitances[i];
+			break;
+		case component_kind::capacitor:
+			series_elastance += 1.0 / arrays.capacitances[i];
+			parallel_capacitance += arrays.capacitances[i];
+			break;
+		case component_kind::inductor:
+			series_inductance += arrays.inductances[i];
+			parallel_inverse_inductance += 1.0 / arrays.inductances[i];
+			break;
+		case component_kind::diode: {
+			const std::complex<double> z = diode_impedance(i);
+			junction_impedance_sum += z;
+			diode_admittance_sum += 1.0 / z;
+			break;
+		}
+		}
+	}
+	// Take term out of sum, or set it to zero when the term was its last contributor.
+	// Returns false, leaving sum alone, if the term cannot be subtracted back out.
+	template <typename T>
+	static bool take(T& sum, T term, bool last) {
+		if (last) {
+			sum = 0;
+			return true;
+		}
+		if (!(std::abs(term) <= std::abs(sum - term))) {
+			return false;
+		}
+		sum -= term;
+		return true;
+	}
+	std::size_t count(component_kind kind) const {
+		return owners[static_cast<std::size_t>(kind)].size();
+	}
+	// Take entry i of a kind out of the running sums. Returns false if some term could
+	// not be taken out, in which case the sums must be rebuilt.
+	bool subtract(component_kind kind, std::size_t i) {
+		const bool last = count(kind) == 1;
+		switch (kind) {
+		case component_kind::resistor:
+			return take(series_resistance, arrays.resistances[i], last)
+				&& take(parallel_conductance, 1.0 / arrays.resistances[i], last && count(component_kind::transistor) == 0);
+		case component_kind::transistor:
+			return take(junction_impedance_sum, transistor_impedance(i), last && count(component_kind::diode) == 0)
+				&& take(parallel_conductance, arrays.transistor_conductances[i], last && count(component_kind::resistor) == 0)
+				&& take(parallel_capacitance, arrays.transistor_capacitances[i], last && count(component_kind::capacitor) == 0);
+		case component_kind::capacitor:
+			return take(series_elastance, 1.0 / arrays.capacitances[i], last)
+				&& take(parallel_capacitance, arrays.capacitances[i], last && count(component_kind::transistor) == 0);
+		case component_kind::inductor:
+			return take(series_inductance, arrays.inductances[i], last)
+				&& take(parallel_inverse_inductance, 1.0 / arrays.inductances[i], last);
+		case component_kind::diode: {
+			const std::complex<double> z = diode_impedance(i);
+			return take(junction_impedance_sum, z, last && count(component_kind::transistor) == 0)
+				&& take(diode_admittance_sum, 1.0 / z, last);
+		}
+		}
+		return false;
+	}
+	void update_junction_sums() {
+		junction_impedance_sum = 0;
+		diode_admittance_sum = 0;
+		for (std::size_t i = 0; i < arrays.diode_resistances.size(); ++i) {
+			const std::complex<double> z = diode_impedance(i);
+			junction_impedance_sum += z;
+			diode_admittance_sum += 1.0 / z;
+		}
+		for (std::size_t i = 0; i < arrays.transistor_conductances.size(); ++i) {
+			junction_impedance_sum += transistor_impedance(i);
+		}
+	}
+	void reset_sums() {
+		series_resistance = series_inductance = series_elastance = 0;
+		parallel_conductance = parallel_capacitance = parallel_inverse_inductance = 0;
+		junction_impedance_sum = diode_admittance_sum = 0;
+	}
+	void rebuild_sums() {
+		reset_sums();
+		for (std::size_t k = 0; k < component_kind_count; ++k) {
+			for (std::size_t i = 0; i < owners[k].size(); ++i) {
+				accumulate(static_cast<component_kind>(k), i);
+			}
+		}
+	}
+	// Store the component's values and record them under the given id
+	void insert(component_id id, components* component) {
+		const component_kind kind = component->store(arrays);
+		std::pmr::vector<component_id>& owner = owners[static_cast<std::size_t>(kind)];
+		slots[id] = { kind, owner.size(), true };
+		owner.push_back(id);
+		accumulate(kind, slots[id].index);
+	}
+	// Take the component's values out of the arrays and the running sums
+	void erase(component_id id) {
+		if (id >= slots.size() || !slots[id].in_use) {
+			throw std::invalid_argument("Error: Component is not part of this circuit.");
+		}
+		slot& s = slots[id];
+		const bool subtracted = subtract(s.kind, s.index);
+		std::pmr::vector<component_id>& owner = owners[static_cast<std::size_t>(s.kind)];
+		arrays.swap_remove(s.kind, s.index);
+		owner[s.index] = owner.back();
+		slots[owner[s.index]].index = s.index;
+		owner.pop_back();
+		s.in_use = false;
+		if (!subtracted) {
+			rebuild_sums();
+		}
+	}
+	void add_circuit(circuit* sub, connection c) {
+		if (sub == this || sub->parent != nullptr) {
+			throw std::invalid_argument("Error: Sub-circuit already belongs to a circuit.");
+		}
+		sub->parent = this;
+		sub->index_in_parent = children.size();
+		children.push_back({ sub, 0.0, false, false });
+		topology = c;
+		sub->set_frequency(frequency);
+		child_changed(sub->index_in_parent);
+	}
+	// Flag this node and its ancestors for re-evaluation
+	void mark_dirty() {
+		if (dirty) {
+			return;
+		}
+		dirty = true;
+		if (parent != nullptr) {
+			parent->child_changed(index_in_parent);
+		}
+	}
+	void child_changed(std::size_t i) {
+		if (!children[i].queued) {
+			children[i].queued = true;
+			dirty_children.push_back(i);
+		}
+		mark_dirty();
+	}
+	static bool is_finite(std::complex<double> z) {
+		return std::isfinite(z.real()) && std::isfinite(z.imag());
+	}
+	// Bring the cached impedance up to date, visiting only dirty sub-circuits
+	void evaluate() const {
+		if (!dirty) {
+			return;
+		}
+		bool exact = true;
+		for (std::size_t i : dirty_children) {
+			child_entry& child = children[i];
+			child.queued = false;
+			child.node->evaluate();
+			const std::complex<double> z = child.node->total_impedance;
+			if (child.counted) {
+				child_impedance_sum -= child.contribution;
+				child_admittance_sum -= 1.0 / child.contribution;
+			}
+			child_impedance_sum += z;
+			child_admittance_sum += 1.0 / z;
+			child.contribution = z;
+			child.counted = true;
+			exact = exact && is_finite(z) && is_finite(1.0 / z);
+		}
+		dirty_children.clear();
+		if (!exact || !is_finite(child_impedance_sum) || !is_finite(child_admittance_sum)) {
+			// Open or shorted branches cannot be subtracted back out, so re-sum the children
+			child_impedance_sum = 0;
+			child_admittance_sum = 0;
+			for (const child_entry& child : children) {
+				child_impedance_sum += child.contribution;
+				child_admittance_sum += 1.0 / child.contribution;
+			}
+		}
+		const double omega = 2 * pi * frequency;
+		if (topology == connection::series) {
+			total_impedance = std::complex<double>(series_resistance, omega * series_inductance - series_elastance / omega)
+				+ junction_impedance_sum + child_impedance_sum;
+		}
+		else {
+			const std::complex<double> admittance(parallel_conductance,
+				omega * parallel_capacitance - parallel_inverse_inductance / omega);
+			total_impedance = 1.0 / (admittance + diode_admittance_sum + child_admittance_sum);
+		}
+		dirty = false;
+	}
+	// Impedance at every point of the table as split real/imaginary arrays, in double
+	// or float. The table's omega terms are worked out once for the sweep and read by
+	// every node below.
+	template <typename T>
+	void sweep_impedance(const basic_frequency_table<T>& table, T* re, T* im) const {
+		const std::size_t n = table.size();
+		const T* omega = table.omega.data();
+		const basic_sweep_kernels<T>& kernels = get_sweep_kernels<T>();
+		const bool series = topology == connection::series;
+		// The resistive terms are the same at every frequency, and the capacitor and inductor
+		// terms all have the form a * omega + b / omega with coefficients taken from the running sums
+		const T real_part = static_cast<T>(series ? series_resistance : parallel_conductance);
+		const T a = static_cast<T>(series ? series_inductance : parallel_capacitance);
+		const T b = static_cast<T>(-(series ? series_elastance : parallel_inverse_inductance));
+		// Real and imaginary parts of the summed impedance (series) or admittance (parallel)
+		std::fill(re, re + n, real_part);
+		std::fill(im, im + n, T(0));
+		kernels.add_linear(omega, table.inverse_omega.data(), n, a, b, im);
+		if (series && !arrays.transistor_conductances.empty()) {
+			// Each transistor is g + j omega C in admittance, inverted to an impedance
+			std::vector<T> yr(n);
+			std::vector<T> yi(n);
+			for (std::size_t t = 0; t < arrays.transistor_conductances.size(); ++t) {
+				std::fill(yr.begin(), yr.end(), static_cast<T>(arrays.transistor_conductances[t]));
+				std::fill(yi.begin(), yi.end(), T(0));
+				kernels.add_scaled(omega, n, static_cast<T>(arrays.transistor_capacitances[t]), yi.data());
+				kernels.invert(yr.data(), yi.data(), n);
+				for (std::size_t i = 0; i < n; ++i) {
+					re[i] += yr[i];
+					im[i] += yi[i];
+				}
+			}
+		}
+		if (!arrays.diode_resistances.empty() || !children.empty()) {
+			std::vector<T> zr(n);
+			std::vector<T> zi(n);
+			std::vector<T> yr(arrays.diode_resistances.empty() ? 0 : n);
+			std::vector<T> yi(yr.size());
+			const std::size_t terms = arrays.diode_resistances.size() + children.size();
+			for (std::size_t t = 0; t < terms; ++t) {
+				if (t < arrays.diode_resistances.size()) {
+					// r + 1 / (g + j omega c)
+					std::fill(yr.begin(), yr.end(), static_cast<T>(arrays.diode_conductances[t]));
+					std::fill(yi.begin(), yi.end(), T(0));
+					kernels.add_scaled(omega, n, static_cast<T>(arrays.diode_capacitances[t]), yi.data());
+					std::fill(zr.begin(), zr.end(), static_cast<T>(arrays.diode_resistances[t]));
+					std::fill(zi.begin(), zi.end(), T(0));
+					kernels.add_reciprocal(yr.data(), yi.data(), n, zr.data(), zi.data());
+				}
+				else {
+					children[t - arrays.diode_resistances.size()].node->sweep_impedance(table, zr.data(), zi.data());
+				}
+				if (series) {
+					for (std::size_t i = 0; i < n; ++i) {
+						re[i] += zr[i];
+						im[i] += zi[i];
+					}
+				}
+				else {
+					kernels.add_reciprocal(zr.data(), zi.data(), n, re, im);
+				}
+			}
+		}
+		if (!series) {
+			kernels.invert(re, im, n);
+		}
+	}
+	// Numerator and denominator of this node's impedance in x = s / w, where w is the
+	// reference angular frequency
+	void rational_terms(double w, polynomial& numerator, polynomial& denominator) const {
+		const bool series = topology == connection::series;
+		// The summed parts: R + sL + S/s in series and G + sC + 1/(sL) in parallel,
+		// as (x^2 a + x b + c) / x, or (x a + b) / 1 when c is zero
+		const double a = series ? series_inductance * w : parallel_capacitance * w;
+		const double b = series ? series_resistance : parallel_conductance;
+		const double c = series ? series_elastance / w : parallel_inverse_inductance / w;
+		polynomial n = c != 0 ? polynomial{ c, b, a } : polynomial{ b, a };
+		polynomial d = c != 0 ? polynomial{ 0.0, 1.0 } : polynomial{ 1.0 };
+		// Diodes are r + 1 / (g + s c) and transistors 1 / (g + s C)
+		for (std::size_t i = 0; i < arrays.diode_resistances.size(); ++i) {
+			const polynomial junction{ arrays.diode_conductances[i], arrays.diode_capacitances[i] * w };
+			const polynomial z = junction * polynomial{ arrays.diode_resistances[i] } + polynomial{ 1.0 };
+			if (series) {
+				rational_impedance::add(n, d, z, junction);
+			}
+			else {
+				rational_impedance::add(n, d, junction, z);
+			}
+		}
+		// In parallel, transistors are already part of G and C
+		for (std::size_t i = 0; series && i < arrays.transistor_conductances.size(); ++i) {
+			const polynomial y{ arrays.transistor_conductances[i], arrays.transistor_capacitances[i] * w };
+			rational_impedance::add(n, d, polynomial{ 1.0 }, y);
+		}
+		for (const child_entry& child : children) {
+			polynomial child_numerator;
+			polynomial child_denominator;
+			child.node->rational_terms(w, child_numerator, child_denominator);
+			if (series) {
+				rational_impedance::add(n, d, child_numerator, child_denominator);
+			}
+			else {
+				rational_impedance::add(n, d, child_denominator, child_numerator);
+			}
+		}
+		// A parallel node has summed admittances, so its impedance is the inverse
+		numerator = series ? n : d;
+		denominator = series ? d : n;
+		rational_impedance::reduce(numerator, denominator);
+	}
+	// Reverse pass of get_sensitivities. 'weight' is the derivative of the impedance
+	// 'root' of the circuit asked with respect to the impedance of this node.
+	void collect_sensitivities(std::complex<double> weight, std::complex<double> root, std::vector<component_sensitivity>& out) const {
+		const double omega = 2 * pi * frequency;
+		const bool series = topology == connection::series;
+		// A parallel node's parts enter through its admittance, and dZ = -Z^2 dY
+		const std::complex<double> scale = series ? weight : -weight * total_impedance * total_impedance;
+		auto add = [&](component_kind kind, std::size_t i, std::complex<double> local) {
+			const std::complex<double> dz = scale * local;
+			out.push_back({ this, owners[static_cast<std::size_t>(kind)][i], kind, dz,
+				magnitude_derivative(root, dz), phase_derivative(root, dz) });
+		};
+		for (std::size_t i = 0; i < arrays.resistances.size(); ++i) {
+			const double r = arrays.resistances[i];
+			add(component_kind::resistor, i, series ? 1.0 : -1.0 / (r * r));
+		}
+		for (std::size_t i = 0; i < arrays.capacitances.size(); ++i) {
+			const double c = arrays.capacitances[i];
+			add(component_kind::capacitor, i, series ? std::complex<double>(0, 1.0 / (omega * c * c)) : std::complex<double>(0, omega));
+		}
+		for (std::size_t i = 0; i < arrays.inductances.size(); ++i) {
+			const double l = arrays.inductances[i];
+			add(component_kind::inductor, i, series ? std::complex<double>(0, omega) : std::complex<double>(0, 1.0 / (omega * l * l)));
+		}
+		for (const child_entry& child : children) {
+			const std::complex<double> z = child.node->total_impedance;
+			child.node->collect_sensitivities(series ? weight : weight * (total_impedance * total_impedance) / (z * z), root, out);
+		}
+	}
+public:
+	// All of the circuit's storage comes from resource, so a circuit created in an
+	// arena allocates nothing from the heap
+	explicit circuit(connection c = connection::series, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+		arrays(resource), slots(resource), owners(component_kind_count, resource), children(resource), dirty_children(resource),
+		child_impedance_sum(0.0), child_admittance_sum(0.0), parent(nullptr), index_in_parent(0),
+		total_impedance(0.0), dirty(true), frequency(0.0), topology(c) { reset_sums(); }
+	~circuit() {}
+	// Sub-circuits refer to their parent, so a circuit cannot be copied
+	circuit(const circuit&) = delete;
+	circuit& operator=(const circuit&) = delete;
+	component_id add_component_in_series(components* component) {
+		const component_id id = slots.size();
+		slots.push_back({});
+		insert(id, component);
+		topology = connection::series;
+		mark_dirty();
+		return id;
+	}
+	component_id add_component_in_parallel(components* component) {
+		const component_id id = slots.size();
+		slots.push_back({});
+		insert(id, component);
+		topology = connection::parallel;
+		mark_dirty();
+		return id;
+	}
+	// Add a whole sub-circuit as one branch of this circuit
+	void add_circuit_in_series(circuit* sub) {
+		add_circuit(sub, connection::series);
+	}
+	void add_circuit_in_parallel(circuit* sub) {
+		add_circuit(sub, connection::parallel);
+	}
+	// Remove a component previously added, adjusting the running sums
+	void remove_component(component_id id) {
+		erase(id);
+		mark_dirty();
+	}
+	// Swap the values behind an id for those of another component
+	void replace_component(component_id id, components* component) {
+		erase(id);
+		insert(id, component);
+		mark_dirty();
+	}
+	// Remove all parts and sub-circuits, keeping the allocated storage for reuse
+	void clear() {
+		for (child_entry& child : children) {
+			child.node->parent = nullptr;
+		}
+		children.clear();
+		dirty_children.clear();
+		child_impedance_sum = child_admittance_sum = 0;
+		arrays.resistances.clear();
+		arrays.capacitances.clear();
+		arrays.inductances.clear();
+		arrays.diode_capacitances.clear();
+		arrays.diode_resistances.clear();
+		arrays.diode_conductances.clear();
+		arrays.transistor_conductances.clear();
+		arrays.transistor_capacitances.clear();
+		slots.clear();
+		for (auto& owner : owners) {
+			owner.clear();
+		}
+		reset_sums();
+		dirty = false;
+		mark_dirty();
+	}
+	std::size_t get_component_count() const {
+		std::size_t count = 0;
+		for (const auto& owner : owners) {
+			count += owner.size();
+		}
+		return count;
+	}
+	connection get_topology() const {
+		return topology;
+	}
+	// Set the frequency of this circuit and all of its sub-circuits
+	void set_frequency(double f) { 
+		frequency = f;
+		update_junction_sums();
+		for (child_entry& child : children) {
+			child.node->set_frequency(f);
+		}
+		mark_dirty();
+	}
+	double get_frequency() const {
+		return frequency;
+	}
+	std::complex<double> get_circuit_impedance() const {
+		evaluate();
+		return total_impedance;
+	}
+	double get_total_impedance_magntiude() const {
+		return std::abs(get_circuit_impedance());
+	}
+	double get_phase_difference() const {
+		return std::arg(get_circuit_impedance());
+	}
+	// Evaluate the circuit at n frequencies in one pass, writing |Z| and arg(Z) per point.
+	// The components are only read, so their stored frequency and impedance are left untouched.
+	// With float arrays the whole sweep is in single precision, twice the points per
+	// kernel instruction and half the memory traffic, good to about six digits away
+	// from resonances; |Z| must stay below about 1e19.
+	template <typename T>
+	void sweep(const T* freqs, std::size_t n, T* magnitude, T* phase) const {
+		static_assert(std::is_same<T, double>::value || std::is_same<T, float>::value, "Sweeps are in double or float");
+		ACS_TIMED(sweep);
+		ACS_COUNT(evaluations, n);
+		std::vector<T> re(n);
+		std::vector<T> im(n);
+		sweep_impedance(basic_frequency_table<T>(freqs, n), re.data(), im.data());
+		get_sweep_kernels<T>().magnitude(re.data(), im.data(), n, magnitude);
+		if constexpr (std::is_same<T, float>::value) {
+			// A float sweep makes no promise of matching std::arg, so the phase is vectorized too
+			get_sweep_kernels<T>().phase(re.data(), im.data(), n, phase);
+		}
+		else {
+			for (std::size_t i = 0; i < n; ++i) {
+				phase[i] = std::atan2(im[i], re[i]);
+			}
+		}
+	}
+	sweep_result sweep(const std::vector<double>& freqs) const {
+		sweep_result result;
+		result.frequency = freqs;
+		result.magnitude.resize(freqs.size());
+		result.phase.resize(freqs.size());
+		sweep(freqs.data(), freqs.size(), result.magnitude.data(), result.phase.data());
+		return result;
+	}
+	// Derivatives of the impedance at the current frequency with respect to the value
+	// (R, C or L) of every resistor, capacitor and inductor, here and in sub-circuits.
+	// One pass down the tree carries dZ/dZ_node to each node, so all of them together
+	// cost about one evaluation. Diodes and transistors are set by their bias and are
+	// left out.
+	std::vector<component_sensitivity> get_sensitivities() const {
+		evaluate();
+		std::vector<component_sensitivity> result;
+		result.reserve(get_component_count());
+		collect_sensitivities(1.0, total_impedance, result);
+		return result;
+	}
+	// The impedance as a ratio of polynomials, built once from the current values and
+	// diode bias for fast dense sweeps. The reference frequency should lie inside the
+	// band to be swept; the result does not follow later changes to the circuit.
+	rational_impedance get_rational_impedance(double reference_frequency = 1000.0) const {
+		polynomial numerator;
+		polynomial denominator;
+		rational_terms(2 * pi * reference_frequency, numerator, denominator);
+		return rational_impedance(numerator, denominator, reference_frequency);
+	}
+	// Append a description of what the circuit computes: its topology and the bit
+	// patterns of its values, with the parts of each kind and the sub-circuits
+	// sorted so that the order they were added in does not change it
+	void append_canonical_form(std::string& out) const {
+		auto put_count = [&out](std::uint64_t n) {
+			out.append(reinterpret_cast<const char*>(&n), sizeof(n));
+		};
+		auto put = [&out](double v) {
+			// -0 and +0 give the same impedance
+			v = v == 0 ? 0.0 : v;
+			out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+		};
+		auto put_sorted = [&](const std::pmr::vector<double>& values) {
+			std::vector<double> sorted(values.begin(), values.end());
+			std::sort(sorted.begin(), sorted.end());
+			put_count(sorted.size());
+			for (double v : sorted) {
+				put(v);
+			}
+		};
+		out.push_back(topology == connection::series ? 'S' : 'P');
+		put_sorted(arrays.resistances);
+		put_sorted(arrays.capacitances);
+		put_sorted(arrays.inductances);
+		std::vector<std::array<double, 3>> diodes;
+		for (std::size_t i = 0; i < arrays.diode_resistances.size(); ++i) {
+			diodes.push_back({ arrays.diode_capacitances[i], arrays.diode_resistances[i], arrays.diode_conductances[i] });
+		}
+		std::sort(diodes.begin(), diodes.end());
+		put_count(diodes.size());
+		for (const std::array<double, 3>& d : diodes) {
+			put(d[0]);
+			put(d[1]);
+			put(d[2]);
+		}
+		std::vector<std::array<double, 2>> transistors;
+		for (std::size_t i = 0; i < arrays.transistor_conductances.size(); ++i) {
+			transistors.push_back({ arrays.transistor_conductances[i], arrays.transistor_capacitances[i] });
+		}
+		std::sort(transistors.begin(), transistors.end());
+		put_count(transistors.size());
+		for (const std::array<double, 2>& t : transistors) {
+			put(t[0]);
+			put(t[1]);
+		}
+		std::vector<std::string> forms(children.size());
+		for (std::size_t i = 0; i < children.size(); ++i) {
+			children[i].node->append_canonical_form(forms[i]);
+		}
+		std::sort(forms.begin(), forms.end());
+		put_count(forms.size());
+		for (const std::string& form : forms) {
+			put_count(form.size());
+			out += form;
+		}
+	}
+};
@@ -0,0 +1,323 @@
+﻿#pragma once
+
+#include "acs/components.h"
+#include "acs/circuit.h"
+#include "acs/instrument.h"
+#include "acs/nodal.h"
+
+#include <algorithm>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Memory-mapped binary files for very large jobs. A netlist file holds the
+// branches as columns (kind, value, from node, to node) and a sweep file holds
+// the frequencies and a matrix of results with one curve per row. Both are used
+// in place through a mapping, so opening one reads nothing until its pages are
+// touched, and a reader after one curve only pages in that curve.
+//
+// Every file starts with a 64 byte header: four magic bytes, uint32 version,
+// uint32 byte order mark 0x01020304, uint32 header size, then uint64 counts.
+// Each column follows in order, starting at the next multiple of 64 bytes, and
+// every value is in native byte order.
+
+// Read-only mapping of a whole existing file, or a read-write mapping of a new
+// file created at a given size
+class mapped_file
+{
+private:
+	unsigned char* address;
+	std::size_t length;
+	bool writable;
+	void release();
+public:
+	mapped_file() : address(nullptr), length(0), writable(false) {}
+	// Map an existing file for reading
+	explicit mapped_file(const std::string& path);
+	// Create (or truncate) a file of the given size and map it for writing
+	mapped_file(const std::string& path, std::size_t size);
+	~mapped_file() {
+		release();
+	}
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file(mapped_file&& other) noexcept : address(other.address), length(other.length), writable(other.writable) {
+		other.address = nullptr;
+		other.length = 0;
+	}
+	mapped_file& operator=(mapped_file&& other) noexcept {
+		if (this != &other) {
+			release();
+			address = other.address;
+			length = other.length;
+			writable = other.writable;
+			other.address = nullptr;
+			other.length = 0;
+		}
+		return *this;
+	}
+	const unsigned char* data() const {
+		return address;
+	}
+	// The mapping for writing, or null if the file was opened for reading
+	unsigned char* writable_data() {
+		return writable ? address : nullptr;
+	}
+	std::size_t size() const {
+		return length;
+	}
+	bool is_writable() const {
+		return writable;
+	}
+	// Write modified pages back to the file now rather than when the system chooses
+	void flush();
+};
+
+// Header shared by the netlist and sweep files
+struct columnar_header
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t byte_order;
+	std::uint32_t header_size;
+	std::uint64_t counts[6];
+};
+static_assert(sizeof(columnar_header) == 64, "columnar_header must be 64 bytes");
+
+// Offset of the next column after one ending at the given offset
+inline std::size_t align_column(std::size_t offset) {
+	return (offset + 63) / 64 * 64;
+}
+
+// Write a netlist as an "ACSN" file. The counts are nodes (ground included),
+// branches and sources; the columns are uint8 component_kind, double value,
+// uint32 from and to nodes for every branch, then uint32 from and to nodes and
+// the complex current as two doubles for every source. Only resistors,
+// capacitors and inductors are described by a single value, so those are the
+// kinds a netlist file holds.
+void write_netlist_file(const netlist& net, const std::string& path);
+
+// Netlist used in place from an "ACSN" file. The matrix pattern is built from the
+// node columns and each frequency point stamps admittances straight from the kind
+// and value columns, with no component objects at all, so a netlist of 10^5+
+// branches is ready to solve without parsing or copying it.
+class mapped_netlist
+{
+private:
+	mapped_file file;
+	std::size_t node_count;
+	std::size_t branch_count;
+	std::size_t source_count;
+	const std::uint8_t* kinds;
+	const double* values;
+	const std::uint32_t* from;
+	const std::uint32_t* to;
+	const std::uint32_t* source_from;
+	const std::uint32_t* source_to;
+	const double* source_currents;
+	nodal_pattern np;
+	lu_symbolic symbolic;
+	nodal_workspace own_workspace;
+
+	void check_node(std::size_t node) const {
+		if (node >= node_count) {
+			throw std::out_of_range("Error: Node does not exist in the netlist.");
+		}
+	}
+public:
+	explicit mapped_netlist(const std::string& path);
+	~mapped_netlist() {}
+	// Admittance of a branch, computed the way the component classes' admittance_at gives it
+	static std::complex<double> admittance(component_kind kind, double value, const frequency_point& p) {
+		switch (kind) {
+		case component_kind::resistor:
+			return 1.0 / value;
+		case component_kind::capacitor:
+			return std::complex<double>(0, p.omega * value);
+		default:
+			return std::complex<double>(0, -p.inverse_omega * (1.0 / value));
+		}
+	}
+	nodal_workspace make_workspace() const {
+		nodal_workspace ws;
+		ws.values.reserve(np.pattern.row_index.size());
+		ws.rhs.reserve(np.pattern.n);
+		ws.factors.l_values.reserve(symbolic.l_index.size());
+		ws.factors.u_values.reserve(symbolic.u_index.size());
+		ws.factors.work.reserve(np.pattern.n);
+		return ws;
+	}
+	// Numeric factorization of the admittance matrix at frequency f
+	void factor(double f, nodal_workspace& ws) const {
+		{
+			ACS_TIMED(assemble);
+			ws.values.assign(np.pattern.row_index.size(), 0.0);
+			const frequency_point point = frequency_point::at(f);
+			for (std::size_t k = 0; k < branch_count; ++k) {
+				stamp_branch(np.stamps[k], admittance(static_cast<component_kind>(kinds[k]), values[k], point), ws.values);
+			}
+		}
+		factor_lu(np.pattern, ws.values, symbolic, ws.factors);
+	}
+	// Voltages of every node (ground included) driven by the file's sources
+	std::vector<std::complex<double>> node_voltages(double f, nodal_workspace& ws) const {
+		factor(f, ws);
+		ws.rhs.assign(np.pattern.n, 0.0);
+		for (std::size_t k = 0; k < source_count; ++k) {
+			const std::complex<double> current(source_currents[2 * k], source_currents[2 * k + 1]);
+			if (source_to[k] != netlist::ground) {
+				ws.rhs[source_to[k] - 1] += current;
+			}
+			if (source_from[k] != netlist::ground) {
+				ws.rhs[source_from[k] - 1] -= current;
+			}
+		}
+		solve_lu_refined(np.pattern, ws.values, symbolic, ws.factors, ws.rhs);
+		std::vector<std::complex<double>> voltages(node_count, 0.0);
+		std::copy(ws.rhs.begin(), ws.rhs.end(), voltages.begin() + 1);
+		return voltages;
+	}
+	std::vector<std::complex<double>> node_voltages(double f) {
+		return node_voltages(f, own_workspace);
+	}
+	// Impedance seen between two nodes with the file's sources switched off
+	std::complex<double> port_impedance(std::size_t plus, std::size_t minus, double f, nodal_workspace& ws) const {
+		check_node(plus);
+		check_node(minus);
+		factor(f, ws);
+		ws.rhs.assign(np.pattern.n, 0.0);
+		if (plus != netlist::ground) {
+			ws.rhs[plus - 1] += 1.0;
+		}
+		if (minus != netlist::ground) {
+			ws.rhs[minus - 1] -= 1.0;
+		}
+		solve_lu_refined(np.pattern, ws.values, symbolic, ws.factors, ws.rhs);
+		const std::complex<double> vp = plus != netlist::ground ? ws.rhs[plus - 1] : 0.0;
+		const std::complex<double> vm = minus != netlist::ground ? ws.rhs[minus - 1] : 0.0;
+		return vp - vm;
+	}
+	std::complex<double> port_impedance(std::size_t plus, std::size_t minus, double f) {
+		return port_impedance(plus, minus, f, own_workspace);
+	}
+	// Port impedance at n frequencies, written to the given magnitude and phase
+	// arrays, which may be a row of a mapped_sweep
+	void sweep_port(std::size_t plus, std::size_t minus, const double* freqs, std::size_t n,
+		double* magnitude, double* phase, nodal_workspace& ws) const {
+		for (std::size_t i = 0; i < n; ++i) {
+			const std::complex<double> z = port_impedance(plus, minus, freqs[i], ws);
+			magnitude[i] = std::abs(z);
+			phase[i] = std::arg(z);
+		}
+	}
+	void sweep_port(std::size_t plus, std::size_t minus, const double* freqs, std::size_t n, double* magnitude, double* phase) {
+		sweep_port(plus, minus, freqs, n, magnitude, phase, own_workspace);
+	}
+	// Component objects and a netlist built from the columns, for the analyses
+	// that need a netlist; the parts are kept in the given vector
+	netlist make_netlist(std::vector<std::unique_ptr<components>>& parts) const;
+	std::size_t get_node_count() const {
+		return node_count;
+	}
+	std::size_t get_branch_count() const {
+		return branch_count;
+	}
+	std::size_t get_source_count() const {
+		return source_count;
+	}
+	// The columns as they are in the file
+	const std::uint8_t* get_kinds() const {
+		return kinds;
+	}
+	const double* get_values() const {
+		return values;
+	}
+	const std::uint32_t* get_from() const {
+		return from;
+	}
+	const std::uint32_t* get_to() const {
+		return to;
+	}
+	std::size_t get_factor_nonzeros() const {
+		return symbolic.l_index.size() + symbolic.u_index.size();
+	}
+};
+
+// Sweep results as an "ACSS" file: the counts are rows and points, and the
+// columns are the frequencies, then the magnitudes and then the phases as
+// row-major rows x points matrices of doubles, so every curve is contiguous.
+// A new file is created at its final size and filled in place, so a sweep
+// writes its results straight into the mapping.
+class mapped_sweep
+{
+private:
+	mapped_file file;
+	std::size_t rows;
+	std::size_t points;
+	const double* frequency;
+	const double* magnitude;
+	const double* phase;
+
+	void check_row(std::size_t row) const {
+		if (row >= rows) {
+			throw std::out_of_range("Error: Sweep file has no such row.");
+		}
+	}
+	double* writable(const double* column, std::size_t row) {
+		check_row(row);
+		if (!file.is_writable()) {
+			throw std::logic_error("Error: Sweep file is open for reading only.");
+		}
+		return const_cast<double*>(column) + row * points;
+	}
+public:
+	// Open an existing sweep file for reading
+	explicit mapped_sweep(const std::string& path);
+	// Create a sweep file over the given frequencies with room for the given
+	// number of curves, all zero until written
+	mapped_sweep(const std::string& path, const std::vector<double>& freqs, std::size_t row_count);
+	~mapped_sweep() {}
+	std::size_t get_rows() const {
+		return rows;
+	}
+	std::size_t get_points() const {
+		return points;
+	}
+	const double* get_frequencies() const {
+		return frequency;
+	}
+	const double* get_magnitude(std::size_t row) const {
+		check_row(row);
+		return magnitude + row * points;
+	}
+	const double* get_phase(std::size_t row) const {
+		check_row(row);
+		return phase + row * points;
+	}
+	// Row storage to sweep into, for a file created by this object
+	double* magnitude_row(std::size_t row) {
+		return writable(magnitude, row);
+	}
+	double* phase_row(std::size_t row) {
+		return writable(phase, row);
+	}
+	// Copy of one curve
+	sweep_result read_row(std::size_t row) const {
+		sweep_result result;
+		result.frequency.assign(frequency, frequency + points);
+		result.magnitude.assign(get_magnitude(row), get_magnitude(row) + points);
+		result.phase.assign(get_phase(row), get_phase(row) + points);
+		return result;
+	}
+	// Sweep a circuit over the file's frequencies into a row
+	void sweep(const circuit& c, std::size_t row) {
+		c.sweep(frequency, points, magnitude_row(row), phase_row(row));
+	}
+	void flush() {
+		file.flush();
+	}
+};
@@ -0,0 +1,490 @@
+﻿// Component models: resistor, capacitor, inductor, diode and transistor
+
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+const double pi = 3.14159265358979323846;
+
+// The terms of one frequency that the component models need. A sweep works them
+// out once per point and every component reads them, rather than each one
+// computing 2 pi f and its reciprocal for itself.
+struct frequency_point
+{
+	double frequency;
+	double omega;
+	double inverse_omega;
+
+	static frequency_point at(double f) {
+		const double omega = 2 * pi * f;
+		return { f, omega, 1.0 / omega };
+	}
+};
+
+// The same terms at every point of a sweep, as arrays for the sweep kernels, in
+// double or float. The terms are worked out in double and rounded once.
+template <typename T>
+struct basic_frequency_table
+{
+	const T* frequency;
+	std::vector<T> omega;
+	std::vector<T> inverse_omega;
+
+	// The frequencies are not copied and must outlive the table
+	basic_frequency_table(const T* freqs, std::size_t n) : frequency(freqs), omega(n), inverse_omega(n) {
+		for (std::size_t i = 0; i < n; ++i) {
+			const double w = 2 * pi * freqs[i];
+			omega[i] = static_cast<T>(w);
+			inverse_omega[i] = static_cast<T>(1.0 / w);
+		}
+	}
+	std::size_t size() const {
+		return omega.size();
+	}
+	frequency_point operator[](std::size_t i) const {
+		return { frequency[i], omega[i], inverse_omega[i] };
+	}
+};
+
+using frequency_table = basic_frequency_table<double>;
+
+// Kind of values a component stores in component_arrays
+enum class component_kind { resistor, capacitor, inductor, diode, transistor };
+const std::size_t component_kind_count = 5;
+
+// Handle returned when a component is added to a circuit
+using component_id = std::size_t;
+
+// Component values of a circuit kept by type in contiguous arrays, so that
+// aggregation is a plain loop over doubles instead of a virtual call per part.
+// The arrays take their memory from the given resource, which may be an arena.
+struct component_arrays
+{
+	std::pmr::vector<double> resistances;
+	std::pmr::vector<double> capacitances;
+	std::pmr::vector<double> inductances;
+	std::pmr::vector<double> diode_capacitances;
+	std::pmr::vector<double> diode_resistances;
+	std::pmr::vector<double> diode_conductances;
+	std::pmr::vector<double> transistor_conductances;
+	std::pmr::vector<double> transistor_capacitances;
+	explicit component_arrays(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+		resistances(resource), capacitances(resource), inductances(resource), diode_capacitances(resource),
+		diode_resistances(resource), diode_conductances(resource), transistor_conductances(resource),
+		transistor_capacitances(resource) {}
+	// Remove entry i of the given kind by moving the last entry into its place
+	void swap_remove(component_kind kind, std::size_t i) {
+		switch (kind) {
+		case component_kind::resistor:
+			swap_remove(resistances, i);
+			break;
+		case component_kind::capacitor:
+			swap_remove(capacitances, i);
+			break;
+		case component_kind::inductor:
+			swap_remove(inductances, i);
+			break;
+		case component_kind::diode:
+			swap_remove(diode_capacitances, i);
+			swap_remove(diode_resistances, i);
+			swap_remove(diode_conductances, i);
+			break;
+		case component_kind::transistor:
+			swap_remove(transistor_conductances, i);
+			swap_remove(transistor_capacitances, i);
+			break;
+		}
+	}
+	static void swap_remove(std::pmr::vector<double>& values, std::size_t i) {
+		values[i] = values.back();
+		values.pop_back();
+	}
+};
+
+// Abstract base class for components in circuit
+class components
+{
+protected:
+	double frequency;
+	std::complex<double> impedance;
+public:
+	components() : frequency(0) {}
+	virtual ~components() {}
+	virtual std::string get_type() const = 0;
+	virtual void set_frequency(double f) = 0;
+	virtual double get_frequency() const = 0;
+	virtual std::complex<double> get_impedance() const = 0;
+	virtual double get_impedance_magnitude() const = 0;
+	virtual double get_phase_difference() const = 0;
+	// Impedance at frequency f without changing the stored state
+	virtual std::complex<double> impedance_at(double f) const = 0;
+	// 1/Z at a frequency point. The models with a closed form override this with
+	// multiplies by the shared omega terms and values worked out when they were made.
+	virtual std::complex<double> admittance_at(const frequency_point& p) const { return 1.0 / impedance_at(p.frequency); }
+	// Append the component's values to the arrays of its type and say which type that is
+	virtual component_kind store(component_arrays& arrays) const = 0;
+	// Type of the part, the one store() files it under
+	virtual component_kind get_kind() const = 0;
+	// Main value of the part: R, C or L, a diode's series resistance, a transistor's r_o
+	virtual double get_value() const = 0;
+	// Derivative of impedance_at(f) with respect to the component's value (R, C or L).
+	// Parts whose impedance is set by a bias point have no single value and give 0.
+	virtual std::complex<double> impedance_derivative_at(double /*f*/) const { return 0.0; }
+};
+
+// Derived class for resistor
+class resistor : public components
+{
+private: 
+	double resistance;
+	double conductance;
+public:
+	resistor(double r) : resistance(r), conductance(1.0 / r) {impedance = resistance;}
+	~resistor() {}
+	void set_frequency(double f) override {
+		frequency = f;
+	}
+	double get_frequency() const override {
+		return frequency;
+	}
+	std::complex<double> get_impedance() const override {
+		return { impedance };
+	}
+	double get_impedance_magnitude() const override {
+		return std::abs(impedance);
+	}
+	double get_phase_difference() const override {
+		return std::arg(impedance);
+	}
+	std::string get_type() const override {
+		return "Resistor";
+	}
+	std::complex<double> impedance_at(double /*f*/) const override {
+		return resistance;
+	}
+	std::complex<double> admittance_at(const frequency_point& /*p*/) const override {
+		return conductance;
+	}
+	std::complex<double> impedance_derivative_at(double /*f*/) const override {
+		return 1.0;
+	}
+	component_kind store(component_arrays& arrays) const override {
+		arrays.resistances.push_back(resistance);
+		return component_kind::resistor;
+	}
+	component_kind get_kind() const override {
+		return component_kind::resistor;
+	}
+	double get_value() const override {
+		return resistance;
+	}
+};
+
+// Derived class for capacitor
+class capacitor : public components
+{
+private:
+	double capacitance;
+public:
+	capacitor(double c) : capacitance(c) { impedance = std::complex<double>(0, -1.0 / (2.0 * pi * frequency * capacitance)); }
+	~capacitor() {}
+	void set_frequency(double f) override {
+		frequency = f;
+		impedance = impedance_at(f);
+	}
+	double get_frequency() const override {
+		return frequency;
+	}
+	std::complex<double> get_impedance() const override {
+		return impedance;
+	}
+	double get_impedance_magnitude() const override {
+		return std::abs(impedance);
+	}
+	double get_phase_difference() const override {
+		return -pi/2;
+	}
+	std::string get_type() const override {
+		return "Capacitor";
+	}
+	std::complex<double> impedance_at(double f) const override {
+		return std::complex<double>(0, -1.0 / (2 * pi * f * capacitance));
+	}
+	std::complex<double> admittance_at(const frequency_point& p) const override {
+		return std::complex<double>(0, p.omega * capacitance);
+	}
+	std::complex<double> impedance_derivative_at(double f) const override {
+		return std::complex<double>(0, 1.0 / (2 * pi * f * capacitance * capacitance));
+	}
+	component_kind store(component_arrays& arrays) const override {
+		arrays.capacitances.push_back(capacitance);
+		return component_kind::capacitor;
+	}
+	component_kind get_kind() const override {
+		return component_kind::capacitor;
+	}
+	double get_value() const override {
+		return capacitance;
+	}
+};
+
+// Derived class for inductor
+class inductor : public components
+{
+private:
+	double inductance;
+	double inverse_inductance;
+public:
+	inductor(double l) : inductance(l), inverse_inductance(1.0 / l) { impedance = std::complex<double>(0, 2 * pi * inductance); }
+	~inductor() {}
+	void set_frequency(double f) override {
+		frequency = f;
+		impedance = impedance_at(f);
+	}
+	double get_frequency() const override {
+		return frequency;
+	}
+	std::complex<double> get_impedance() const override {
+		return impedance;
+	}
+	double get_impedance_magnitude() const override {
+		return std::abs(impedance);
+	}
+	double get_phase_difference() const override {
+		return pi/2;
+	}
+	std::string get_type() const override {
+		return "Inductor";
+	}
+	std::complex<double> impedance_at(double f) const override {
+		return std::complex<double>(0, 2 * pi * f * inductance);
+	}
+	std::complex<double> admittance_at(const frequency_point& p) const override {
+		return std::complex<double>(0, -p.inverse_omega * inverse_inductance);
+	}
+	std::complex<double> impedance_derivative_at(double f) const override {
+		return std::complex<double>(0, 2 * pi * f);
+	}
+	component_kind store(component_arrays& arrays) const override {
+		arrays.inductances.push_back(inductance);
+		return component_kind::inductor;
+	}
+	component_kind get_kind() const override {
+		return component_kind::inductor;
+	}
+	double get_value() const override {
+		return inductance;
+	}
+};
+
+// Derived class for diode. A Shockley junction with series resistance, and
+// junction capacitance across the junction. Its AC impedance is the small-signal
+// model at the junction voltage set by set_operating_point, 0 V until then.
+class diode : public components
+{
+private:
+	double capacitance;
+	double resistance;
+	double saturation_current;
+	double emission_coefficient;
+	double junction_voltage;
+	double conductance;
+public:
+	// kT/q at 300 K
+	static constexpr double thermal_voltage = 0.025852;
+	diode(double c, double r, double is, double n = 1.0) :
+		capacitance(c), resistance(r), saturation_current(is), emission_coefficient(n), junction_voltage(0.0)
+	{
+		if (is <= 0 || n <= 0) {
+			throw std::invalid_argument("Error: Diode saturation current and emission coefficient must be positive.");
+		}
+		conductance = conductance_of(junction_voltage, saturation_current, emission_coefficient);
+		impedance = impedance_at(0.0);
+	}
+	~diode() {}
+	void set_frequency(double f) override {
+		frequency = f;
+		impedance = impedance_at(f);
+	}
+	double get_frequency() const override {
+		return frequency;
+	}
+	std::complex<double> get_impedance() const override {
+		return impedance;
+	}
+	double get_impedance_magnitude() const override {
+		return std::abs(impedance);
+	}
+	double get_phase_difference() const override {
+		return std::arg(impedance);
+	}
+	std::string get_type() const override {
+		return "Diode";
+	}
+	std::complex<double> impedance_at(double f) const override {
+		return impedance_of(f, capacitance, resistance, conductance);
+	}
+	// (g + j omega c) / (1 + r (g + j omega c)), with g fixed by the bias
+	std::complex<double> admittance_at(const frequency_point& p) const override {
+		const std::complex<double> junction(conductance, p.omega * capacitance);
+		return junction / (1.0 + resistance * junction);
+	}
+	component_kind store(component_arrays& arrays) const override {
+		arrays.diode_capacitances.push_back(capacitance);
+		arrays.diode_resistances.push_back(resistance);
+		arrays.diode_conductances.push_back(conductance);
+		return component_kind::diode;
+	}
+	component_kind get_kind() const override {
+		return component_kind::diode;
+	}
+	double get_value() const override {
+		return resistance;
+	}
+	// Bias the junction, e.g. from a DC operating point
+	void set_operating_point(double v) {
+		junction_voltage = v;
+		conductance = conductance_of(junction_voltage, saturation_current, emission_coefficient);
+		impedance = impedance_at(frequency);
+	}
+	double get_operating_point() const {
+		return junction_voltage;
+	}
+	double get_resistance() const {
+		return resistance;
+	}
+	double get_saturation_current() const {
+		return saturation_current;
+	}
+	double get_emission_coefficient() const {
+		return emission_coefficient;
+	}
+	// Junction current and small-signal conductance at the operating point
+	double get_current() const {
+		return current_of(junction_voltage, saturation_current, emission_coefficient);
+	}
+	double get_conductance() const {
+		return conductance;
+	}
+	// Shockley equation and its derivative
+	static double current_of(double v, double is, double n) {
+		return is * std::expm1(v / (n * thermal_voltage));
+	}
+	static double conductance_of(double v, double is, double n) {
+		return is / (n * thermal_voltage) * std::exp(v / (n * thermal_voltage));
+	}
+	// Series resistance r plus junction conductance g in parallel with capacitance c
+	static std::complex<double> impedance_of(double f, double c, double r, double g) {
+		return r + 1.0 / std::complex<double>(g, 2 * pi * f * c);
+	}
+};
+
+// Small-signal hybrid-pi parameters of a bipolar transistor at its bias point
+struct hybrid_pi
+{
+	double gm;
+	double r_pi;
+	double r_o;
+	double c_pi;
+	double c_mu;
+};
+
+// Derived class for transistor. A bipolar transistor at the stored bias, described
+// by its hybrid-pi model. As a two-terminal part it is the collector-emitter output
+// with the base held at AC ground, r_o in parallel with C_mu; netlist::add_transistor
+// connects all three terminals. The model depends only on the bias, so it is
+// worked out once here rather than at every frequency.
+class transistor : public components
+{
+private:
+	double collector_current;
+	double base_current;
+	double emitter_current;
+	double collector_emitter_voltage;
+	double base_emitter_voltage;
+	hybrid_pi model;
+	double output_conductance;
+public:
+	// early_voltage sets r_o, transit_time the diffusion part of C_pi, and c_mu is the
+	// base-collector capacitance
+	transistor(double cc, double bc, double ec, double cev, double bev,
+		double early_voltage = 100.0, double transit_time = 0.35e-9, double c_mu = 2e-12) :
+		collector_current(cc), base_current(bc), emitter_current(ec),
+		collector_emitter_voltage(cev), base_emitter_voltage(bev) {
+		if (cc <= 0 || bc <= 0) {
+			throw std::invalid_argument("Error: Transistor bias currents must be positive.");
+		}
+		model.gm = collector_current / diode::thermal_voltage;
+		model.r_pi = diode::thermal_voltage / base_current;
+		model.r_o = (early_voltage + collector_emitter_voltage) / collector_current;
+		model.c_pi = model.gm * transit_time;
+		model.c_mu = c_mu;
+		output_conductance = 1.0 / model.r_o;
+		impedance = impedance_at(0.0);
+	}
+	~transistor() {}
+	void set_frequency(double f) override {
+		frequency = f;
+		impedance = impedance_at(f);
+	}
+	double get_frequency() const override {
+		return frequency;
+	}
+	std::complex<double> get_impedance() const override {
+		return impedance;
+	}
+	double get_impedance_magnitude() const override {
+		return std::abs(impedance);
+	}
+	double get_phase_difference() const override {
+		return std::arg(impedance);
+	}
+	std::string get_type() const override {
+		return "Transistor";
+	}
+	std::complex<double> impedance_at(double f) const override {
+		return 1.0 / std::complex<double>(output_conductance, 2 * pi * f * model.c_mu);
+	}
+	std::complex<double> admittance_at(const frequency_point& p) const override {
+		return std::complex<double>(output_conductance, p.omega * model.c_mu);
+	}
+	component_kind store(component_arrays& arrays) const override {
+		arrays.transistor_conductances.push_back(output_conductance);
+		arrays.transistor_capacitances.push_back(model.c_mu);
+		return component_kind::transistor;
+	}
+	component_kind get_kind() const override {
+		return component_kind::transistor;
+	}
+	double get_value() const override {
+		return model.r_o;
+	}
+	const hybrid_pi& get_model() const {
+		return model;
+	}
+	// Terminal admittance matrix at frequency f, rows and columns ordered
+	// collector, base, emitter, including the gm v_be current into the collector
+	void admittance_matrix(double f, std::complex<double> y[3][3]) const {
+		admittance_matrix(frequency_point::at(f), y);
+	}
+	void admittance_matrix(const frequency_point& p, std::complex<double> y[3][3]) const {
+		const double omega = p.omega;
+		const std::complex<double> y_ce(output_conductance, 0.0);
+		const std::complex<double> y_bc(0.0, omega * model.c_mu);
+		const std::complex<double> y_be(1.0 / model.r_pi, omega * model.c_pi);
+		y[0][0] = y_ce + y_bc;
+		y[0][1] = -y_bc + model.gm;
+		y[0][2] = -y_ce - model.gm;
+		y[1][0] = -y_bc;
+		y[1][1] = y_bc + y_be;
+		y[1][2] = -y_be;
+		y[2][0] = -y_ce;
+		y[2][1] = -y_be - model.gm;
+		y[2][2] = y_ce + y_be + model.gm;
+	}
+};
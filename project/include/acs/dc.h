@@ -0,0 +1,486 @@
+﻿#pragma once
+
+#include "acs/nodal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// DC operating point. At DC capacitors are open and inductors are shorts, so the
+// nodes joined by inductors are merged and solved as one. A diode with series
+// resistance gets an internal node between the resistance and its junction. The
+// nonlinear nodal equations are solved by damped Newton-Raphson on the sparse LU,
+// refactoring only when the junction conductances have moved. If plain Newton
+// fails the solve is retried with gmin stepping and then with source stepping.
+
+struct dc_options
+{
+	std::size_t max_iterations = 100;
+	// Convergence test on the node voltage updates
+	double relative_tolerance = 1e-6;
+	double absolute_tolerance = 1e-9;
+	// Conductance from every node to ground, which keeps floating nodes solvable
+	double gmin = 1e-12;
+};
+
+struct dc_solution
+{
+	std::vector<double> node_voltages;
+	// Branch currents from 'from' to 'to'. Currents in inductor loops are not
+	// determined at DC and are NaN.
+	std::vector<double> branch_currents;
+	// Junction voltage of every diode branch, 0 for other branches
+	std::vector<double> junction_voltages;
+	std::size_t iterations = 0;
+	std::size_t factorizations = 0;
+};
+
+// DC analysis of a netlist with its own DC sources; as in transient analysis the
+// netlist's phasor sources do not take part. Component values are read when the
+// analysis is created, and the topology must stay fixed.
+class operating_point_analysis
+{
+private:
+	// Element of the reduced network
+	struct element
+	{
+		bool junction;
+		// Conductance of a linear element, or saturation current and emission coefficient of a junction
+		double conductance;
+		double saturation_current;
+		double emission_coefficient;
+	};
+	// Current source; a voltage source is held as its Norton current
+	struct dc_source
+	{
+		std::size_t from;
+		std::size_t to;
+		double current;
+		// Resistive branch a voltage source drives, or none for current sources
+		std::size_t branch;
+	};
+
+	netlist& net;
+	// Network with inductor-joined nodes merged and diode internal nodes added;
+	// its branch parts only label the branches
+	netlist reduced;
+	std::vector<element> elements;
+	std::vector<std::size_t> node_map;
+	// Reduced node between the series resistance and junction of each diode branch, or none
+	std::vector<std::size_t> internal_nodes;
+	// Kind and value of each branch, read once as the analysis is prepared
+	std::vector<component_kind> branch_kinds;
+	std::vector<double> branch_values;
+	nodal_pattern np;
+	lu_symbolic symbolic;
+	std::vector<std::size_t> diagonal;
+	std::vector<dc_source> sources;
+	// Newton state
+	std::vector<double> linear_values;
+	std::vector<double> values;
+	std::vector<double> residual;
+	std::vector<double> step;
+	// Voltage each junction is linearized at, which lags the node voltages while limited
+	std::vector<double> junction_voltages;
+	std::vector<double> factored_conductances;
+	lu_numeric<double> factors;
+	bool factored;
+
+	static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+	static std::size_t find_root(std::vector<std::size_t>& parent, std::size_t i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+
+	// Kind of a branch, with transistors taken as their output resistance
+	static component_kind read_kind(const components* part) {
+		const component_kind kind = part->get_kind();
+		return kind == component_kind::transistor ? component_kind::resistor : kind;
+	}
+
+	// Reduced node voltage, with ground at 0
+	static double voltage(const std::vector<double>& x, std::size_t node) {
+		return node == netlist::ground ? 0.0 : x[node - 1];
+	}
+
+	// Residual of the nodal equations at x with every junction linearized at its
+	// limited voltage, and the Jacobian values when 'jacobian' is set
+	void evaluate(const std::vector<double>& x, double gmin, double source_scale, bool jacobian) {
+		const std::size_t n = np.pattern.n;
+		const sparse_pattern& p = np.pattern;
+		residual.assign(n, 0.0);
+		for (std::size_t j = 0; j < n; ++j) {
+			for (std::size_t k = p.col_start[j]; k < p.col_start[j + 1]; ++k) {
+				residual[p.row_index[k]] += linear_values[k] * x[j];
+			}
+			residual[j] += gmin * x[j];
+		}
+		if (jacobian) {
+			values = linear_values;
+			for (std::size_t i = 0; i < n; ++i) {
+				values[diagonal[i]] += gmin;
+			}
+		}
+		const std::vector<netlist::branch>& branches = reduced.get_branches();
+		for (std::size_t k = 0; k < elements.size(); ++k) {
+			const element& e = elements[k];
+			if (!e.junction) {
+				continue;
+			}
+			const double vd = junction_voltages[k];
+			const double g = diode::conductance_of(vd, e.saturation_current, e.emission_coefficient);
+			const double v = voltage(x, branches[k].from) - voltage(x, branches[k].to);
+			const double i = diode::current_of(vd, e.saturation_current, e.emission_coefficient) + g * (v - vd);
+			if (branches[k].from != netlist::ground) {
+				residual[branches[k].from - 1] += i;
+			}
+			if (branches[k].to != netlist::ground) {
+				residual[branches[k].to - 1] -= i;
+			}
+			if (jacobian) {
+				stamp_branch(np.stamps[k], g, values);
+			}
+		}
+		for (const dc_source& s : sources) {
+			const double current = source_scale * s.current;
+			const std::size_t to = node_map[s.to];
+			const std::size_t from = node_map[s.from];
+			if (to != netlist::ground) {
+				residual[to - 1] -= current;
+			}
+			if (from != netlist::ground) {
+				residual[from - 1] += current;
+			}
+		}
+	}
+
+	// Junction voltage step limiting of SPICE's pnjlim: above the critical voltage a
+	// large rise is replaced by a logarithmic one, so exp() stays in range
+	static double limit_junction(double v, double previous, double nvt, double critical) {
+		if (v > critical && std::abs(v - previous) > 2 * nvt) {
+			if (previous > 0) {
+				const double arg = 1 + (v - previous) / nvt;
+				return arg > 0 ? previous + nvt * std::log(arg) : critical;
+			}
+			return nvt * std::log(v / nvt);
+		}
+		return v;
+	}
+
+	// Whether any junction conductance has moved far from the factored one
+	bool jacobian_stale() const {
+		for (std::size_t k = 0; k < elements.size(); ++k) {
+			const element& e = elements[k];
+			if (e.junction) {
+				const double g = diode::conductance_of(junction_voltages[k], e.saturation_current, e.emission_coefficient);
+				if (!(g < 1.25 * factored_conductances[k] && g > 0.8 * factored_conductances[k])) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	// Newton-Raphson from x; returns whether it converged, leaving the result in x
+	bool newton(std::vector<double>& x, double gmin, double source_scale, const dc_options& options, dc_solution& stats) {
+		const std::vector<netlist::branch>& branches = reduced.get_branches();
+		for (std::size_t k = 0; k < elements.size(); ++k) {
+			junction_voltages[k] = voltage(x, branches[k].from) - voltage(x, branches[k].to);
+		}
+		factored = false;
+		double last_update = std::numeric_limits<double>::infinity();
+		for (std::size_t iteration = 0; iteration < options.max_iterations; ++iteration) {
+			++stats.iterations;
+			const bool refactor = !factored || jacobian_stale();
+			evaluate(x, gmin, source_scale, refactor);
+			if (refactor) {
+				factor_lu(np.pattern, values, symbolic, factors);
+				++stats.factorizations;
+				factored = true;
+				for (std::size_t k = 0; k < elements.size(); ++k) {
+					if (elements[k].junction) {
+						factored_conductances[k] = diode::conductance_of(junction_voltages[k],
+							elements[k].saturation_current, elements[k].emission_coefficient);
+					}
+				}
+			}
+			step = residual;
+			solve_lu_refined(np.pattern, values, symbolic, factors, step);
+			double update = 0.0;
+			bool converged = true;
+			for (std::size_t i = 0; i < x.size(); ++i) {
+				x[i] -= step[i];
+				if (!std::isfinite(x[i])) {
+					return false;
+				}
+				update = std::max(update, std::abs(step[i]));
+				if (std::abs(step[i]) > options.absolute_tolerance + options.relative_tolerance * std::abs(x[i])) {
+					converged = false;
+				}
+			}
+			// Damping: each junction follows its new voltage only as far as the limit allows
+			for (std::size_t k = 0; k < elements.size(); ++k) {
+				const element& e = elements[k];
+				if (!e.junction) {
+					continue;
+				}
+				const double nvt = e.emission_coefficient * diode::thermal_voltage;
+				const double critical = nvt * std::log(nvt / (std::sqrt(2.0) * e.saturation_current));
+				const double v = voltage(x, branches[k].from) - voltage(x, branches[k].to);
+				const double limited = limit_junction(v, junction_voltages[k], nvt, critical);
+				// Junction currents are exponential in voltage, so their voltages must settle too
+				if (limited != v || std::abs(limited - junction_voltages[k]) > options.absolute_tolerance + options.relative_tolerance * std::abs(limited)) {
+					converged = false;
+				}
+				junction_voltages[k] = limited;
+			}
+			if (converged) {
+				return true;
+			}
+			// A reused Jacobian that stops making progress is refreshed
+			if (update > 0.5 * last_update) {
+				factored = false;
+			}
+			last_update = update;
+		}
+		return false;
+	}
+
+	dc_solution make_solution(const std::vector<double>& x, dc_solution stats) const {
+		const std::vector<netlist::branch>& branches = net.get_branches();
+		dc_solution result = stats;
+		result.node_voltages.assign(net.get_node_count(), 0.0);
+		for (std::size_t i = 0; i < net.get_node_count(); ++i) {
+			result.node_voltages[i] = voltage(x, node_map[i]);
+		}
+		result.branch_currents.assign(branches.size(), 0.0);
+		result.junction_voltages.assign(branches.size(), 0.0);
+		// Current leaving each node through non-inductor branches, less the source current entering it
+		std::vector<double> imbalance(net.get_node_count(), 0.0);
+		std::vector<std::size_t> inductor_count(net.get_node_count(), 0);
+		for (std::size_t k = 0; k < branches.size(); ++k) {
+			const netlist::branch& b = branches[k];
+			const component_kind kind = branch_kinds[k];
+			double current = 0.0;
+			if (kind == component_kind::inductor) {
+				++inductor_count[b.from];
+				++inductor_count[b.to];
+				continue;
+			}
+			if (kind == component_kind::resistor) {
+				current = (result.node_voltages[b.from] - result.node_voltages[b.to]) / branch_values[k];
+			}
+			else if (kind == component_kind::diode && node_map[b.from] != node_map[b.to]) {
+				const std::size_t anode = internal_nodes[k] == none ? node_map[b.from] : internal_nodes[k];
+				const double v = voltage(x, anode) - voltage(x, node_map[b.to]);
+				const diode* d = static_cast<const diode*>(b.part);
+				current = diode::current_of(v, d->get_saturation_current(), d->get_emission_coefficient());
+				result.junction_voltages[k] = v;
+			}
+			result.branch_currents[k] = current;
+			imbalance[b.from] += current;
+			imbalance[b.to] -= current;
+		}
+		for (const dc_source& s : sources) {
+			imbalance[s.to] -= s.current;
+			imbalance[s.from] += s.current;
+			if (s.branch != none) {
+				// The source sits in series with its resistor, so the branch carries less current
+				result.branch_currents[s.branch] -= s.current;
+			}
+		}
+		// Inductor currents follow from KCL, peeling the inductor forest from its leaves
+		std::vector<char> resolved(branches.size(), 0);
+		bool progress = true;
+		while (progress) {
+			progress = false;
+			for (std::size_t k = 0; k < branches.size(); ++k) {
+				const netlist::branch& b = branches[k];
+				if (resolved[k] || branch_kinds[k] != component_kind::inductor) {
+					continue;
+				}
+				double current;
+				if (b.from != netlist::ground && inductor_count[b.from] == 1) {
+					current = -imbalance[b.from];
+				}
+				else if (b.to != netlist::ground && inductor_count[b.to] == 1) {
+					current = imbalance[b.to];
+				}
+				else {
+					continue;
+				}
+				result.branch_currents[k] = current;
+				imbalance[b.from] += current;
+				imbalance[b.to] -= current;
+				--inductor_count[b.from];
+				--inductor_count[b.to];
+				resolved[k] = 1;
+				progress = true;
+			}
+		}
+		for (std::size_t k = 0; k < branches.size(); ++k) {
+			if (!resolved[k] && branch_kinds[k] == component_kind::inductor) {
+				result.branch_currents[k] = std::numeric_limits<double>::quiet_NaN();
+			}
+		}
+		return result;
+	}
+
+public:
+	explicit operating_point_analysis(netlist& n) : net(n), factored(false) {
+		if (!net.get_devices().empty()) {
+			// Their bias is part of the small-signal model they were created with
+			throw std::invalid_argument("Error: DC analysis does not support three-terminal transistors.");
+		}
+		const std::vector<netlist::branch>& branches = net.get_branches();
+		for (const netlist::branch& b : branches) {
+			branch_kinds.push_back(read_kind(b.part));
+			branch_values.push_back(b.part->get_value());
+		}
+		// Merge the nodes joined by inductors, keeping ground as its own representative
+		std::vector<std::size_t> parent(net.get_node_count());
+		for (std::size_t i = 0; i < parent.size(); ++i) {
+			parent[i] = i;
+		}
+		for (std::size_t k = 0; k < branches.size(); ++k) {
+			const netlist::branch& b = branches[k];
+			if (branch_kinds[k] == component_kind::inductor) {
+				std::size_t a = find_root(parent, b.from);
+				std::size_t c = find_root(parent, b.to);
+				if (a != c) {
+					if (c == netlist::ground) {
+						std::swap(a, c);
+					}
+					parent[c] = a;
+				}
+			}
+		}
+		node_map.assign(net.get_node_count(), none);
+		node_map[netlist::ground] = netlist::ground;
+		for (std::size_t i = 1; i < node_map.size(); ++i) {
+			const std::size_t root = find_root(parent, i);
+			if (node_map[root] == none) {
+				node_map[root] = reduced.add_node();
+			}
+			node_map[i] = node_map[root];
+		}
+		internal_nodes.assign(branches.size(), none);
+		for (std::size_t k = 0; k < branches.size(); ++k) {
+			const netlist::branch& b = branches[k];
+			const component_kind kind = branch_kinds[k];
+			const double value = branch_values[k];
+			const std::size_t from = node_map[b.from];
+			const std::size_t to = node_map[b.to];
+			if (from == to || kind == component_kind::capacitor || kind == component_kind::inductor) {
+				continue;
+			}
+			if (kind == component_kind::resistor) {
+				reduced.add_component(b.part, from, to);
+				elements.push_back({ false, 1.0 / value, 0.0, 0.0 });
+				continue;
+			}
+			const diode* d = static_cast<const diode*>(b.part);
+			std::size_t anode = from;
+			if (value > 0) {
+				anode = reduced.add_node();
+				internal_nodes[k] = anode;
+				reduced.add_component(b.part, from, anode);
+				elements.push_back({ false, 1.0 / value, 0.0, 0.0 });
+			}
+			reduced.add_component(b.part, anode, to);
+			elements.push_back({ true, 0.0, d->get_saturation_current(), d->get_emission_coefficient() });
+		}
+		np = build_nodal_pattern(reduced);
+		symbolic = analyse_lu(np.pattern, minimum_degree_order(np.pattern));
+		linear_values.assign(np.pattern.row_index.size(), 0.0);
+		for (std::size_t k = 0; k < elements.size(); ++k) {
+			if (!elements[k].junction) {
+				stamp_branch(np.stamps[k], elements[k].conductance, linear_values);
+			}
+		}
+		for (std::size_t i = 0; i < np.pattern.n; ++i) {
+			diagonal.push_back(np.pattern.find(i, i));
+		}
+		junction_voltages.assign(elements.size(), 0.0);
+		factored_conductances.assign(elements.size(), 0.0);
+	}
+	~operating_point_analysis() {}
+	// DC current out of node 'from' and into node 'to'
+	void add_current_source(std::size_t from, std::size_t to, double current) {
+		if (from >= net.get_node_count() || to >= net.get_node_count()) {
+			throw std::out_of_range("Error: Node does not exist in the netlist.");
+		}
+		sources.push_back({ from, to, current, none });
+	}
+	// DC voltage in series with resistive branch 'branch', positive towards its 'from' node
+	void add_voltage_source(std::size_t branch, double voltage) {
+		if (branch >= net.get_branches().size()) {
+			throw std::out_of_range("Error: Branch does not exist in the netlist.");
+		}
+		if (branch_kinds[branch] != component_kind::resistor) {
+			throw std::invalid_argument("Error: A voltage source must drive a resistive branch.");
+		}
+		const netlist::branch& b = net.get_branches()[branch];
+		sources.push_back({ b.to, b.from, voltage / branch_values[branch], branch });
+	}
+	dc_solution solve(const dc_options& options = dc_options()) {
+		if (net.get_branches().size() != internal_nodes.size() || net.get_node_count() != node_map.size()) {
+			throw std::logic_error("Error: Netlist topology changed after it was prepared.");
+		}
+		dc_solution stats;
+		std::vector<double> x(np.pattern.n, 0.0);
+		if (newton(x, options.gmin, 1.0, options, stats)) {
+			return make_solution(x, stats);
+		}
+		// gmin stepping: start heavily damped towards ground and relax a decade at a time
+		std::fill(x.begin(), x.end(), 0.0);
+		bool converged = true;
+		for (double gmin = 1e-2; converged; gmin /= 10) {
+			const double g = std::max(gmin, options.gmin);
+			converged = newton(x, g, 1.0, options, stats);
+			if (g == options.gmin) {
+				break;
+			}
+		}
+		if (converged) {
+			return make_solution(x, stats);
+		}
+		// Source stepping: ramp the sources up from zero, shortening the ramp on failure
+		std::fill(x.begin(), x.end(), 0.0);
+		std::vector<double> saved;
+		double scale = 0.0;
+		double increment = 0.1;
+		while (scale < 1.0) {
+			const double next = std::min(1.0, scale + increment);
+			saved = x;
+			if (newton(x, options.gmin, next, options, stats)) {
+				scale = next;
+				increment = std::min(2 * increment, 0.5);
+			}
+			else {
+				x = saved;
+				increment /= 4;
+				if (increment < 1e-6) {
+					throw std::runtime_error("Error: DC operating point did not converge.");
+				}
+			}
+		}
+		return make_solution(x, stats);
+	}
+	// Set every diode to its junction voltage in 'op', so AC analysis uses the
+	// small-signal model at that operating point
+	void bias(const dc_solution& op) {
+		const std::vector<netlist::branch>& branches = net.get_branches();
+		for (std::size_t k = 0; k < branches.size(); ++k) {
+			if (branch_kinds[k] == component_kind::diode) {
+				static_cast<diode*>(branches[k].part)->set_operating_point(op.junction_voltages[k]);
+			}
+		}
+	}
+};
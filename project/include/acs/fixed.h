@@ -0,0 +1,275 @@
+﻿#pragma once
+
+#include "acs/components.h"
+
+#include <cmath>
+#include <complex>
+#include <utility>
+
+// Fixed-topology circuits. When the topology is known at compile time,
+// series<...> and parallel<...> fold the impedance into straight-line code
+// with no virtual calls and no heap, e.g.
+//   parallel<resistor, capacitor, inductor> rlc(100.0, 1e-6, 1e-3);
+//   std::complex<double> z = rlc.impedance_at(1000.0);
+// Parameters are given in the order of the parts, and groups can be nested:
+//   series<resistor, parallel<capacitor, inductor>> filter(50.0, 1e-6, 1e-3);
+// impedance_gradient_at(f) also gives dZ/dp for every parameter by forward-mode
+// dual numbers, which for a handful of parameters is cheaper than any bookkeeping.
+
+// Reciprocal of z without the overflow guards of the library division
+inline std::complex<double> fast_reciprocal(std::complex<double> z) {
+	const double scale = 1.0 / (z.real() * z.real() + z.imag() * z.imag());
+	return { z.real() * scale, -z.imag() * scale };
+}
+
+// Derivatives of |z| and arg(z) given the derivative dz of z
+inline double magnitude_derivative(std::complex<double> z, std::complex<double> dz) {
+	return (z.real() * dz.real() + z.imag() * dz.imag()) / std::abs(z);
+}
+inline double phase_derivative(std::complex<double> z, std::complex<double> dz) {
+	return (dz / z).imag();
+}
+
+// Forward-mode dual number: a complex value together with its derivatives with
+// respect to N parameters, carried through the same sums and reciprocals
+template<std::size_t N>
+struct dual
+{
+	std::complex<double> value;
+	std::complex<double> derivative[N];
+
+	// A value depending on parameter 'at' alone, with derivative d
+	static dual seeded(std::complex<double> v, std::size_t at, std::complex<double> d) {
+		dual result{ v, {} };
+		result.derivative[at] = d;
+		return result;
+	}
+	double get_magnitude_derivative(std::size_t i) const {
+		return magnitude_derivative(value, derivative[i]);
+	}
+	double get_phase_derivative(std::size_t i) const {
+		return phase_derivative(value, derivative[i]);
+	}
+};
+
+template<std::size_t N>
+dual<N> operator+(const dual<N>& a, const dual<N>& b) {
+	dual<N> result{ a.value + b.value, {} };
+	for (std::size_t i = 0; i < N; ++i) {
+		result.derivative[i] = a.derivative[i] + b.derivative[i];
+	}
+	return result;
+}
+
+// 1/a, whose derivatives are -a'/a^2
+template<std::size_t N>
+dual<N> reciprocal(const dual<N>& a) {
+	const std::complex<double> v = fast_reciprocal(a.value);
+	dual<N> result{ v, {} };
+	for (std::size_t i = 0; i < N; ++i) {
+		result.derivative[i] = -v * v * a.derivative[i];
+	}
+	return result;
+}
+
+// How a part of a fixed circuit is evaluated. omega is the angular frequency and
+// p points at the part's parameters. Groups supply the same members themselves.
+// The *_dual forms also give the derivatives, with the part's first parameter
+// at position 'at' of an N parameter circuit.
+template<typename T>
+struct element_traits
+{
+	static constexpr std::size_t parameter_count = T::parameter_count;
+	static std::complex<double> impedance_of(double omega, const double* p) { return T::impedance_of(omega, p); }
+	static std::complex<double> admittance_of(double omega, const double* p) { return T::admittance_of(omega, p); }
+	template<std::size_t N>
+	static dual<N> impedance_dual(double omega, const double* p, std::size_t at) { return T::template impedance_dual<N>(omega, p, at); }
+	template<std::size_t N>
+	static dual<N> admittance_dual(double omega, const double* p, std::size_t at) { return T::template admittance_dual<N>(omega, p, at); }
+};
+
+template<>
+struct element_traits<resistor>
+{
+	static constexpr std::size_t parameter_count = 1;
+	static std::complex<double> impedance_of(double /*omega*/, const double* p) { return { p[0], 0.0 }; }
+	static std::complex<double> admittance_of(double /*omega*/, const double* p) { return { 1.0 / p[0], 0.0 }; }
+	template<std::size_t N>
+	static dual<N> impedance_dual(double omega, const double* p, std::size_t at) {
+		return dual<N>::seeded(impedance_of(omega, p), at, 1.0);
+	}
+	template<std::size_t N>
+	static dual<N> admittance_dual(double omega, const double* p, std::size_t at) {
+		return dual<N>::seeded(admittance_of(omega, p), at, -1.0 / (p[0] * p[0]));
+	}
+};
+
+template<>
+struct element_traits<capacitor>
+{
+	static constexpr std::size_t parameter_count = 1;
+	static std::complex<double> impedance_of(double omega, const double* p) { return { 0.0, -1.0 / (omega * p[0]) }; }
+	static std::complex<double> admittance_of(double omega, const double* p) { return { 0.0, omega * p[0] }; }
+	template<std::size_t N>
+	static dual<N> impedance_dual(double omega, const double* p, std::size_t at) {
+		return dual<N>::seeded(impedance_of(omega, p), at, { 0.0, 1.0 / (omega * p[0] * p[0]) });
+	}
+	template<std::size_t N>
+	static dual<N> admittance_dual(double omega, const double* p, std::size_t at) {
+		return dual<N>::seeded(admittance_of(omega, p), at, { 0.0, omega });
+	}
+};
+
+template<>
+struct element_traits<inductor>
+{
+	static constexpr std::size_t parameter_count = 1;
+	static std::complex<double> impedance_of(double omega, const double* p) { return { 0.0, omega * p[0] }; }
+	static std::complex<double> admittance_of(double omega, const double* p) { return { 0.0, -1.0 / (omega * p[0]) }; }
+	template<std::size_t N>
+	static dual<N> impedance_dual(double omega, const double* p, std::size_t at) {
+		return dual<N>::seeded(impedance_of(omega, p), at, { 0.0, omega });
+	}
+	template<std::size_t N>
+	static dual<N> admittance_dual(double omega, const double* p, std::size_t at) {
+		return dual<N>::seeded(admittance_of(omega, p), at, { 0.0, 1.0 / (omega * p[0] * p[0]) });
+	}
+};
+
+// Shared parts of series<> and parallel<>: parameter storage and offsets
+template<typename... Parts>
+class fixed_group
+{
+	static_assert(sizeof...(Parts) > 0, "A fixed circuit needs at least one part");
+public:
+	static constexpr std::size_t parameter_count = (element_traits<Parts>::parameter_count + ...);
+
+	template<typename... Values>
+	constexpr explicit fixed_group(Values... v) : values{ static_cast<double>(v)... } {
+		static_assert(sizeof...(Values) == parameter_count, "Wrong number of parameters for this circuit");
+	}
+	constexpr double get_parameter(std::size_t i) const { return values[i]; }
+	void set_parameter(std::size_t i, double value) { values[i] = value; }
+
+protected:
+	// Index of the first parameter of part i
+	template<std::size_t I>
+	static constexpr std::size_t offset() {
+		constexpr std::size_t counts[] = { element_traits<Parts>::parameter_count... };
+		std::size_t sum = 0;
+		for (std::size_t k = 0; k < I; ++k) {
+			sum += counts[k];
+		}
+		return sum;
+	}
+
+	double values[parameter_count];
+};
+
+// Parts connected end to end: impedances add
+template<typename... Parts>
+class series : public fixed_group<Parts...>
+{
+public:
+	using fixed_group<Parts...>::fixed_group;
+
+	static std::complex<double> impedance_of(double omega, const double* p) {
+		return sum(omega, p, std::index_sequence_for<Parts...>());
+	}
+	static std::complex<double> admittance_of(double omega, const double* p) {
+		return fast_reciprocal(impedance_of(omega, p));
+	}
+	template<std::size_t N>
+	static dual<N> impedance_dual(double omega, const double* p, std::size_t at) {
+		return sum_dual<N>(omega, p, at, std::index_sequence_for<Parts...>());
+	}
+	template<std::size_t N>
+	static dual<N> admittance_dual(double omega, const double* p, std::size_t at) {
+		return reciprocal(impedance_dual<N>(omega, p, at));
+	}
+	std::complex<double> impedance_at(double f) const {
+		return impedance_of(2 * pi * f, this->values);
+	}
+	// Impedance with its derivative with respect to every parameter, in parameter order
+	dual<fixed_group<Parts...>::parameter_count> impedance_gradient_at(double f) const {
+		return impedance_dual<fixed_group<Parts...>::parameter_count>(2 * pi * f, this->values, 0);
+	}
+	// Magnitude and phase at n frequencies
+	void sweep(const double* freqs, std::size_t n, double* magnitude, double* phase) const {
+		for (std::size_t i = 0; i < n; ++i) {
+			const std::complex<double> z = impedance_at(freqs[i]);
+			magnitude[i] = std::abs(z);
+			phase[i] = std::arg(z);
+		}
+	}
+
+private:
+	template<std::size_t... I>
+	static std::complex<double> sum(double omega, const double* p, std::index_sequence<I...>) {
+		return (... + element_traits<Parts>::impedance_of(omega, p + fixed_group<Parts...>::template offset<I>()));
+	}
+	template<std::size_t N, std::size_t... I>
+	static dual<N> sum_dual(double omega, const double* p, std::size_t at, std::index_sequence<I...>) {
+		return (... + element_traits<Parts>::template impedance_dual<N>(omega, p + fixed_group<Parts...>::template offset<I>(),
+			at + fixed_group<Parts...>::template offset<I>()));
+	}
+};
+
+// Parts connected across the same two nodes: admittances add
+template<typename... Parts>
+class parallel : public fixed_group<Parts...>
+{
+public:
+	using fixed_group<Parts...>::fixed_group;
+
+	static std::complex<double> admittance_of(double omega, const double* p) {
+		return sum(omega, p, std::index_sequence_for<Parts...>());
+	}
+	static std::complex<double> impedance_of(double omega, const double* p) {
+		return fast_reciprocal(admittance_of(omega, p));
+	}
+	template<std::size_t N>
+	static dual<N> admittance_dual(double omega, const double* p, std::size_t at) {
+		return sum_dual<N>(omega, p, at, std::index_sequence_for<Parts...>());
+	}
+	template<std::size_t N>
+	static dual<N> impedance_dual(double omega, const double* p, std::size_t at) {
+		return reciprocal(admittance_dual<N>(omega, p, at));
+	}
+	std::complex<double> impedance_at(double f) const {
+		return impedance_of(2 * pi * f, this->values);
+	}
+	// Impedance with its derivative with respect to every parameter, in parameter order
+	dual<fixed_group<Parts...>::parameter_count> impedance_gradient_at(double f) const {
+		return impedance_dual<fixed_group<Parts...>::parameter_count>(2 * pi * f, this->values, 0);
+	}
+	// Magnitude and phase at n frequencies
+	void sweep(const double* freqs, std::size_t n, double* magnitude, double* phase) const {
+		for (std::size_t i = 0; i < n; ++i) {
+			const std::complex<double> z = impedance_at(freqs[i]);
+			magnitude[i] = std::abs(z);
+			phase[i] = std::arg(z);
+		}
+	}
+
+private:
+	template<std::size_t... I>
+	static std::complex<double> sum(double omega, const double* p, std::index_sequence<I...>) {
+		return (... + element_traits<Parts>::admittance_of(omega, p + fixed_group<Parts...>::template offset<I>()));
+	}
+	template<std::size_t N, std::size_t... I>
+	static dual<N> sum_dual(double omega, const double* p, std::size_t at, std::index_sequence<I...>) {
+		return (... + element_traits<Parts>::template admittance_dual<N>(omega, p + fixed_group<Parts...>::template offset<I>(),
+			at + fixed_group<Parts...>::template offset<I>()));
+	}
+};
+
+// The menu circuits, with parameters in the order the menu asks for them
+using parallel_rlc = parallel<resistor, capacitor, inductor>;
+using series_rlc = series<resistor, capacitor, inductor>;
+using series_rl = series<resistor, inductor>;
+using parallel_rl = parallel<resistor, inductor>;
+using series_rc = series<resistor, capacitor>;
+using parallel_rc = parallel<resistor, capacitor>;
+using series_lc = series<capacitor, inductor>;
+using parallel_lc = parallel<capacitor, inductor>;
@@ -0,0 +1,104 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Timing and counters for the stages of a run. Code is marked with ACS_TIMED(stage)
+// for a scope to time and ACS_COUNT(event, n) for a counter. Both compile to
+// nothing unless the library is built with ACS_INSTRUMENTATION defined; when
+// built in they cost one relaxed load until instrumentation::enable() is called.
+// Totals are kept per thread, so threads never contend, and are summed for the
+// report. With tracing on, every timed scope is also kept as a trace event.
+// Hooks go around whole stages, never inside a per-point or per-component loop.
+
+// Stages that are timed
+enum class timed_stage { read, parse, build, update, evaluate, sweep, assemble, factor, solve, output, write };
+const std::size_t timed_stage_count = 11;
+
+// Events that are counted
+enum class counted_event { records, evaluations, factorizations, solves, refinements, precision_fallbacks,
+	cache_hits, cache_misses, allocations };
+const std::size_t counted_event_count = 9;
+
+struct stage_totals
+{
+	std::uint64_t calls = 0;
+	std::uint64_t nanoseconds = 0;
+};
+
+class instrumentation
+{
+private:
+	static std::atomic<bool> enabled;
+	static std::atomic<bool> tracing;
+public:
+	// Whether the hooks were compiled into this build
+	static constexpr bool is_built_in() {
+#ifdef ACS_INSTRUMENTATION
+		return true;
+#else
+		return false;
+#endif
+	}
+	// Start collecting, clearing anything collected before. With 'trace' every timed
+	// scope is kept for write_trace as well as added to the totals.
+	static void enable(bool trace = false);
+	static void disable();
+	static bool is_enabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+	static bool is_tracing() {
+		return tracing.load(std::memory_order_relaxed);
+	}
+	// Nanoseconds on the steady clock
+	static std::uint64_t now() {
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+	static void add_time(timed_stage stage, std::uint64_t start, std::uint64_t end);
+	static void add_count(counted_event event, std::uint64_t n);
+	// Totals over every thread so far
+	static stage_totals get_totals(timed_stage stage);
+	static std::uint64_t get_count(counted_event event);
+	static const char* get_name(timed_stage stage);
+	static const char* get_name(counted_event event);
+	// Table of every stage and counter that was used, with the wall time since enable()
+	static void write_summary(std::ostream& out);
+	// Trace events in the Chrome trace event format, which Perfetto and
+	// chrome://tracing open directly
+	static void write_trace(std::ostream& out);
+};
+
+// Times the enclosing scope as one call of a stage
+class scoped_timer
+{
+private:
+	timed_stage stage;
+	std::uint64_t start;
+public:
+	explicit scoped_timer(timed_stage s) : stage(s), start(instrumentation::is_enabled() ? instrumentation::now() : 0) {}
+	~scoped_timer() {
+		if (start != 0) {
+			instrumentation::add_time(stage, start, instrumentation::now());
+		}
+	}
+	scoped_timer(const scoped_timer&) = delete;
+	scoped_timer& operator=(const scoped_timer&) = delete;
+};
+
+#define ACS_CONCAT_INNER(a, b) a##b
+#define ACS_CONCAT(a, b) ACS_CONCAT_INNER(a, b)
+#ifdef ACS_INSTRUMENTATION
+#define ACS_TIMED(stage) scoped_timer ACS_CONCAT(acs_timer_, __LINE__)(timed_stage::stage)
+#define ACS_COUNT(event, n) \
+	do { \
+		if (instrumentation::is_enabled()) { \
+			instrumentation::add_count(counted_event::event, (n)); \
+		} \
+	} while (false)
+#else
+#define ACS_TIMED(stage) ((void)0)
+#define ACS_COUNT(event, n) ((void)0)
+#endif
@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// SIMD kernels for the sweep hot loops. Each instruction set gets its own
+// implementation and the widest one supported by the running CPU is picked
+// once at start-up, so a single binary runs everywhere.
+
+// Table of kernels used by circuit::sweep and circuit_lanes, for double or float
+// arrays. The float kernels do twice as many points per instruction.
+template <typename T>
+struct basic_sweep_kernels
+{
+	// im[i] += a * f[i] + b / f[i] (capacitor and inductor reactance or susceptance)
+	void (*add_reactance)(const T* f, std::size_t n, T a, T b, T* im);
+	// y[i] += a * x[i]
+	void (*add_scaled)(const T* x, std::size_t n, T a, T* y);
+	// out[i] += a * x[i] + b * y[i] (reactance from shared omega and 1/omega tables)
+	void (*add_linear)(const T* x, const T* y, std::size_t n, T a, T b, T* out);
+	// (re[i], im[i]) += 1 / (zr[i] + j zi[i])
+	void (*add_reciprocal)(const T* zr, const T* zi, std::size_t n, T* re, T* im);
+	// (re[i], im[i]) = 1 / (re[i] + j im[i])
+	void (*invert)(T* re, T* im, std::size_t n);
+	// mag[i] = |re[i] + j im[i]|
+	void (*magnitude)(const T* re, const T* im, std::size_t n, T* mag);
+	// phase[i] = atan2(im[i], re[i]), to within an ulp for double and three for float
+	void (*phase)(const T* re, const T* im, std::size_t n, T* phase);
+	const char* name;
+};
+
+using sweep_kernels = basic_sweep_kernels<double>;
+
+// Pick the widest kernel set the CPU supports (evaluated once)
+template <typename T = double>
+const basic_sweep_kernels<T>& get_sweep_kernels();
+
+template <>
+const basic_sweep_kernels<double>& get_sweep_kernels<double>();
+template <>
+const basic_sweep_kernels<float>& get_sweep_kernels<float>();
+
+// Every kernel set the CPU supports, from scalar up to the one get_sweep_kernels picks
+template <typename T = double>
+const std::vector<basic_sweep_kernels<T>>& get_available_sweep_kernels();
+
+template <>
+const std::vector<basic_sweep_kernels<double>>& get_available_sweep_kernels<double>();
+template <>
+const std::vector<basic_sweep_kernels<float>>& get_available_sweep_kernels<float>();
+
+// Flushes denormal results and inputs to zero on the calling thread while in scope,
+// on x86-64 (elsewhere it does nothing). Single-precision work on networks whose
+// values decay from node to node would otherwise spend most of its time in the
+// slow denormal path.
+class scoped_flush_denormals
+{
+private:
+	unsigned int saved;
+public:
+	scoped_flush_denormals();
+	~scoped_flush_denormals();
+	scoped_flush_denormals(const scoped_flush_denormals&) = delete;
+	scoped_flush_denormals& operator=(const scoped_flush_denormals&) = delete;
+};
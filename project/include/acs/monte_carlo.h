@@ -0,0 +1,359 @@
+﻿#pragma once
+
+#include "acs/fixed.h"
+#include "acs/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Monte Carlo tolerance analysis. Every component value is drawn from its
+// tolerance band, the circuit is evaluated over a sweep, and the results are
+// folded into streaming statistics so no sample is kept. Samples are generated
+// by a counter-based generator and reduced in a fixed order, so the result is
+// the same for any number of threads.
+
+// Counter-based random numbers: a stateless hash of (seed, sample, draw), so any
+// sample can be generated on any thread, in any order, with the same result
+inline std::uint64_t mix64(std::uint64_t x) {
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+inline std::uint64_t counter_random(std::uint64_t seed, std::uint64_t sample, std::uint64_t draw) {
+	return mix64(mix64(mix64(seed) ^ sample) ^ draw);
+}
+// Uniform in [0, 1)
+inline double counter_uniform(std::uint64_t seed, std::uint64_t sample, std::uint64_t draw) {
+	return static_cast<double>(counter_random(seed, sample, draw) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Count, mean and variance by Welford's method, plus the extremes. Infinite and
+// NaN samples (|Z| of a zero-valued capacitor in series) would turn the mean and
+// variance into inf and NaN, so they are counted apart instead.
+class running_statistics
+{
+private:
+	std::size_t n;
+	double mean;
+	double m2;
+	double low;
+	double high;
+	std::size_t non_finite;
+public:
+	running_statistics() : n(0), mean(0.0), m2(0.0),
+		low(std::numeric_limits<double>::infinity()), high(-std::numeric_limits<double>::infinity()), non_finite(0) {}
+	void add(double x) {
+		if (!std::isfinite(x)) {
+			++non_finite;
+			return;
+		}
+		++n;
+		const double delta = x - mean;
+		mean += delta / static_cast<double>(n);
+		m2 += delta * (x - mean);
+		low = std::min(low, x);
+		high = std::max(high, x);
+	}
+	// Combine with statistics of another set of samples (Chan et al.)
+	void merge(const running_statistics& other) {
+		non_finite += other.non_finite;
+		if (other.n == 0) {
+			return;
+		}
+		const std::size_t total = n + other.n;
+		const double delta = other.mean - mean;
+		mean += delta * static_cast<double>(other.n) / static_cast<double>(total);
+		m2 += other.m2 + delta * delta * static_cast<double>(n) * static_cast<double>(other.n) / static_cast<double>(total);
+		n = total;
+		low = std::min(low, other.low);
+		high = std::max(high, other.high);
+	}
+	// Number of finite samples, the ones the other statistics are taken over
+	std::size_t get_count() const {
+		return n;
+	}
+	std::size_t get_non_finite_count() const {
+		return non_finite;
+	}
+	double get_mean() const {
+		return mean;
+	}
+	// Sample variance
+	double get_variance() const {
+		return n > 1 ? m2 / static_cast<double>(n - 1) : 0.0;
+	}
+	double get_standard_deviation() const {
+		return std::sqrt(get_variance());
+	}
+	double get_minimum() const {
+		return low;
+	}
+	double get_maximum() const {
+		return high;
+	}
+};
+
+// Quantiles with a bounded relative error, in the manner of DDSketch: values are
+// counted in logarithmically spaced buckets, so memory grows with the spread of the
+// values rather than their number. Counts are integers, so merging is exact and
+// independent of order. Infinite and NaN samples (|Z| at an exact resonance) have no
+// bucket, so they are counted apart and left out of the quantiles.
+class quantile_sketch
+{
+private:
+	double gamma;
+	double inverse_log_gamma;
+	std::vector<std::uint64_t> positive;
+	std::vector<std::uint64_t> negative;
+	std::int64_t positive_offset;
+	std::int64_t negative_offset;
+	std::uint64_t zeros;
+	std::uint64_t count;
+	std::uint64_t non_finite;
+
+	std::int64_t key(double magnitude) const {
+		return static_cast<std::int64_t>(std::ceil(std::log(magnitude) * inverse_log_gamma));
+	}
+	static void increment(std::vector<std::uint64_t>& bins, std::int64_t& offset, std::int64_t k, std::uint64_t amount) {
+		if (bins.empty()) {
+			bins.assign(1, 0);
+			offset = k;
+		}
+		else if (k < offset) {
+			bins.insert(bins.begin(), static_cast<std::size_t>(offset - k), 0);
+			offset = k;
+		}
+		else if (k >= offset + static_cast<std::int64_t>(bins.size())) {
+			bins.resize(static_cast<std::size_t>(k - offset + 1), 0);
+		}
+		bins[static_cast<std::size_t>(k - offset)] += amount;
+	}
+	double bucket_value(std::int64_t k) const {
+		return 2.0 * std::pow(gamma, static_cast<double>(k)) / (gamma + 1.0);
+	}
+public:
+	// Quantiles are returned within relative_accuracy of a true sample value
+	explicit quantile_sketch(double relative_accuracy = 0.01) :
+		gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)), inverse_log_gamma(1.0 / std::log(gamma)),
+		positive_offset(0), negative_offset(0), zeros(0), count(0), non_finite(0) {
+		if (!(relative_accuracy > 0 && relative_accuracy < 1)) {
+			throw std::invalid_argument("Error: Sketch accuracy must be between 0 and 1.");
+		}
+	}
+	void add(double x) {
+		if (!std::isfinite(x)) {
+			++non_finite;
+			return;
+		}
+		++count;
+		if (std::abs(x) < std::numeric_limits<double>::min()) {
+			++zeros;
+		}
+		else if (x > 0) {
+			increment(positive, positive_offset, key(x), 1);
+		}
+		else {
+			increment(negative, negative_offset, key(-x), 1);
+		}
+	}
+	void merge(const quantile_sketch& other) {
+		if (other.gamma != gamma) {
+			throw std::invalid_argument("Error: Cannot merge sketches of different accuracy.");
+		}
+		for (std::size_t i = 0; i < other.positive.size(); ++i) {
+			if (other.positive[i] != 0) {
+				increment(positive, positive_offset, other.positive_offset + static_cast<std::int64_t>(i), other.positive[i]);
+			}
+		}
+		for (std::size_t i = 0; i < other.negative.size(); ++i) {
+			if (other.negative[i] != 0) {
+				increment(negative, negative_offset, other.negative_offset + static_cast<std::int64_t>(i), other.negative[i]);
+			}
+		}
+		zeros += other.zeros;
+		count += other.count;
+		non_finite += other.non_finite;
+	}
+	// Number of finite samples, the ones the quantiles are taken over
+	std::uint64_t get_count() const {
+		return count;
+	}
+	std::uint64_t get_non_finite_count() const {
+		return non_finite;
+	}
+	// Value at quantile q in [0, 1]
+	double quantile(double q) const {
+		if (count == 0) {
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+		const double rank = std::min(std::max(q, 0.0), 1.0) * static_cast<double>(count - 1);
+		double seen = 0.0;
+		for (std::size_t i = negative.size(); i-- > 0;) {
+			seen += static_cast<double>(negative[i]);
+			if (seen > rank) {
+				return -bucket_value(negative_offset + static_cast<std::int64_t>(i));
+			}
+		}
+		seen += static_cast<double>(zeros);
+		if (seen > rank) {
+			return 0.0;
+		}
+		for (std::size_t i = 0; i < positive.size(); ++i) {
+			seen += static_cast<double>(positive[i]);
+			if (seen > rank) {
+				return bucket_value(positive_offset + static_cast<std::int64_t>(i));
+			}
+		}
+		return bucket_value(positive_offset + static_cast<std::int64_t>(positive.size()) - 1);
+	}
+};
+
+enum class tolerance_distribution { uniform, normal };
+
+// A component value and its tolerance band. Uniform values lie within
+// nominal * (1 +- relative); for normal ones 'relative' is three standard deviations.
+struct tolerance
+{
+	double nominal;
+	double relative;
+	tolerance_distribution distribution = tolerance_distribution::uniform;
+};
+
+struct monte_carlo_options
+{
+	std::size_t samples = 10000;
+	std::uint64_t seed = 1;
+	double sketch_accuracy = 0.01;
+	// Optional magnitude limits at every frequency; a sample passes if it stays within them
+	std::vector<double> min_magnitude;
+	std::vector<double> max_magnitude;
+};
+
+// Statistics at one frequency
+struct monte_carlo_point
+{
+	running_statistics magnitude;
+	running_statistics phase;
+	quantile_sketch magnitude_quantiles;
+	quantile_sketch phase_quantiles;
+	explicit monte_carlo_point(double accuracy = 0.01) : magnitude_quantiles(accuracy), phase_quantiles(accuracy) {}
+};
+
+struct monte_carlo_result
+{
+	std::vector<double> frequency;
+	std::vector<monte_carlo_point> points;
+	std::size_t samples = 0;
+	std::size_t passed = 0;
+	// Fraction of samples within the limits
+	double get_yield() const {
+		return samples == 0 ? 0.0 : static_cast<double>(passed) / static_cast<double>(samples);
+	}
+};
+
+// Draw the parameter values of one sample
+void draw_sample(const std::vector<tolerance>& parameters, std::uint64_t seed, std::uint64_t sample, double* values);
+
+// Monte Carlo over any circuit model. evaluate(values, freqs, n, magnitude, phase)
+// fills the sweep of one sample and is called from several threads at once.
+template <typename Evaluate>
+monte_carlo_result monte_carlo(const std::vector<tolerance>& parameters, const std::vector<double>& freqs,
+	const monte_carlo_options& options, thread_pool& pool, Evaluate evaluate) {
+	const std::size_t n = freqs.size();
+	const bool limited = !options.min_magnitude.empty() || !options.max_magnitude.empty();
+	if ((!options.min_magnitude.empty() && options.min_magnitude.size() != n) ||
+		(!options.max_magnitude.empty() && options.max_magnitude.size() != n)) {
+		throw std::invalid_argument("Error: Magnitude limits must have one entry per frequency.");
+	}
+	// Samples are taken in fixed blocks whose running statistics are merged in block
+	// order, a wave of blocks at a time; the sketches and pass counts are integer
+	// counts and are merged per thread
+	const std::size_t block = 256;
+	const std::size_t wave = 64;
+	const std::size_t blocks = (options.samples + block - 1) / block;
+	struct worker_state
+	{
+		std::vector<double> values;
+		std::vector<double> magnitude;
+		std::vector<double> phase;
+		std::vector<monte_carlo_point> sketches;
+		std::size_t passed = 0;
+	};
+	std::vector<worker_state> workers(pool.size());
+	for (worker_state& w : workers) {
+		w.values.resize(parameters.size());
+		w.magnitude.resize(n);
+		w.phase.resize(n);
+		w.sketches.assign(n, monte_carlo_point(options.sketch_accuracy));
+	}
+	std::vector<std::vector<running_statistics>> block_statistics(std::min(wave, blocks), std::vector<running_statistics>(2 * n));
+	monte_carlo_result result;
+	result.frequency = freqs;
+	result.points.assign(n, monte_carlo_point(options.sketch_accuracy));
+	result.samples = options.samples;
+	for (std::size_t first = 0; first < blocks; first += wave) {
+		const std::size_t count = std::min(wave, blocks - first);
+		pool.parallel_for(count, 1, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+			worker_state& w = workers[worker];
+			for (std::size_t b = begin; b < end; ++b) {
+				std::vector<running_statistics>& stats = block_statistics[b];
+				std::fill(stats.begin(), stats.end(), running_statistics());
+				const std::size_t start = (first + b) * block;
+				const std::size_t stop = std::min(start + block, options.samples);
+				for (std::size_t sample = start; sample < stop; ++sample) {
+					draw_sample(parameters, options.seed, sample, w.values.data());
+					evaluate(static_cast<const double*>(w.values.data()), freqs.data(), n, w.magnitude.data(), w.phase.data());
+					bool pass = true;
+					for (std::size_t i = 0; i < n; ++i) {
+						stats[2 * i].add(w.magnitude[i]);
+						stats[2 * i + 1].add(w.phase[i]);
+						w.sketches[i].magnitude_quantiles.add(w.magnitude[i]);
+						w.sketches[i].phase_quantiles.add(w.phase[i]);
+						if (limited) {
+							pass = pass && (options.min_magnitude.empty() || w.magnitude[i] >= options.min_magnitude[i]) &&
+								(options.max_magnitude.empty() || w.magnitude[i] <= options.max_magnitude[i]);
+						}
+					}
+					w.passed += pass ? 1 : 0;
+				}
+			}
+		});
+		for (std::size_t b = 0; b < count; ++b) {
+			for (std::size_t i = 0; i < n; ++i) {
+				result.points[i].magnitude.merge(block_statistics[b][2 * i]);
+				result.points[i].phase.merge(block_statistics[b][2 * i + 1]);
+			}
+		}
+	}
+	for (const worker_state& w : workers) {
+		for (std::size_t i = 0; i < n; ++i) {
+			result.points[i].magnitude_quantiles.merge(w.sketches[i].magnitude_quantiles);
+			result.points[i].phase_quantiles.merge(w.sketches[i].phase_quantiles);
+		}
+		result.passed += w.passed;
+	}
+	return result;
+}
+
+// Monte Carlo over a fixed-topology circuit such as series_rlc, with one tolerance per parameter
+template <typename Fixed>
+monte_carlo_result monte_carlo_fixed(const std::vector<tolerance>& parameters, const std::vector<double>& freqs,
+	const monte_carlo_options& options, thread_pool& pool) {
+	if (parameters.size() != Fixed::parameter_count) {
+		throw std::invalid_argument("Error: Wrong number of parameters for this circuit.");
+	}
+	return monte_carlo(parameters, freqs, options, pool,
+		[](const double* values, const double* f, std::size_t n, double* magnitude, double* phase) {
+			for (std::size_t i = 0; i < n; ++i) {
+				const std::complex<double> z = Fixed::impedance_of(2 * pi * f[i], values);
+				magnitude[i] = std::abs(z);
+				phase[i] = std::arg(z);
+			}
+		});
+}
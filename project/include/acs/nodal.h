@@ -0,0 +1,731 @@
+﻿#pragma once
+
+#include "acs/components.h"
+#include "acs/circuit.h"
+#include "acs/instrument.h"
+#include "acs/kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Sparse nodal analysis. A netlist connects two-terminal components between
+// numbered nodes (node 0 is ground). At a given frequency every component is
+// stamped into a sparse complex admittance matrix using its impedance model,
+// which is then reordered to limit fill-in and solved by sparse LU.
+
+// Nonzero pattern of a square sparse matrix in compressed column form. The
+// matrices used here are structurally symmetric, so the same arrays also
+// describe the rows.
+struct sparse_pattern
+{
+	std::size_t n = 0;
+	std::vector<std::size_t> col_start;
+	std::vector<std::size_t> row_index;
+	// transpose[p] is the position of the entry mirroring entry p across the diagonal
+	std::vector<std::size_t> transpose;
+	// Position of entry (row, col) in the value array
+	std::size_t find(std::size_t row, std::size_t col) const {
+		const auto first = row_index.begin() + col_start[col];
+		const auto last = row_index.begin() + col_start[col + 1];
+		const auto it = std::lower_bound(first, last, row);
+		if (it == last || *it != row) {
+			throw std::logic_error("Error: Entry is not part of the sparse pattern.");
+		}
+		return static_cast<std::size_t>(it - row_index.begin());
+	}
+	void build_transpose() {
+		transpose.assign(row_index.size(), 0);
+		for (std::size_t j = 0; j < n; ++j) {
+			for (std::size_t p = col_start[j]; p < col_start[j + 1]; ++p) {
+				transpose[p] = find(j, row_index[p]);
+			}
+		}
+	}
+};
+
+// Minimum degree ordering of a symmetric pattern using a quotient graph, so
+// memory stays proportional to the original matrix rather than to the fill.
+// Returns the order in which the variables are eliminated.
+std::vector<std::size_t> minimum_degree_order(const sparse_pattern& pattern);
+
+// Symbolic LU factorization of a structurally symmetric matrix under a given
+// ordering. With diagonal pivoting the pattern of U is the transpose of L's,
+// so both are derived from the elimination tree of the reordered matrix.
+struct lu_symbolic
+{
+	std::size_t n = 0;
+	// perm[k] is the original index of the k-th pivot, inverse is the reverse map
+	std::vector<std::size_t> perm;
+	std::vector<std::size_t> inverse;
+	// Strictly lower part of L by rows, in ascending column order
+	std::vector<std::size_t> l_start;
+	std::vector<std::size_t> l_index;
+	// U by rows with the diagonal stored first
+	std::vector<std::size_t> u_start;
+	std::vector<std::size_t> u_index;
+};
+
+lu_symbolic analyse_lu(const sparse_pattern& pattern, const std::vector<std::size_t>& order);
+
+// Size of a matrix entry for pivot and convergence tests: |x| for real entries
+// and the larger of |re| and |im| for complex ones, which avoids a hypot per entry
+inline double entry_size(double x) {
+	return std::abs(x);
+}
+template <typename T>
+T entry_size(const std::complex<T>& z) {
+	return std::max(std::abs(z.real()), std::abs(z.imag()));
+}
+
+// Real type of a matrix entry
+template <typename T>
+struct entry_real
+{
+	using type = T;
+};
+template <typename T>
+struct entry_real<std::complex<T>>
+{
+	using type = T;
+};
+
+// Numeric LU factors for one set of matrix values
+template <typename T>
+struct lu_numeric
+{
+	using real = typename entry_real<T>::type;
+	std::vector<T> l_values;
+	std::vector<T> u_values;
+	std::vector<T> work;
+	// Pivots that were too small for their column and were replaced, so the factors
+	// are of a nearby matrix and solves have to be refined against the real one
+	std::size_t perturbed = 0;
+	// Larger of the matrix's 1- and infinity-norms, for the refinement tests
+	real norm = 0;
+	// Scratch for refinement
+	std::vector<T> target;
+	std::vector<T> residual;
+};
+
+// Row-by-row LU of the permuted matrix whose values are given in the layout of pattern.
+// The pivots stay on the diagonal so the symbolic factorization holds, but an AC
+// admittance matrix can have a diagonal entry that cancels to nothing, such as a node
+// between an inductor to ground and a capacitor at their resonance. A pivot smaller
+// than sqrt(epsilon) times the largest entry of its column is replaced by that size,
+// as SuperLU_DIST's static pivoting does, and solve_lu_refined recovers the accuracy.
+template <typename T>
+void factor_lu(const sparse_pattern& pattern, const std::vector<T>& values, const lu_symbolic& s, lu_numeric<T>& f) {
+	ACS_TIMED(factor);
+	ACS_COUNT(factorizations, 1);
+	using real = typename lu_numeric<T>::real;
+	const real threshold = std::sqrt(std::numeric_limits<real>::epsilon());
+	const std::size_t n = s.n;
+	f.l_values.resize(s.l_index.size());
+	f.u_values.resize(s.u_index.size());
+	f.work.assign(n, T(0));
+	f.perturbed = 0;
+	f.norm = 0;
+	std::vector<T>& w = f.work;
+	for (std::size_t i = 0; i < n; ++i) {
+		const std::size_t col = s.perm[i];
+		// Row perm[i] has the same pattern as column perm[i], but the values need
+		// not be symmetric, so read the row through the transposed positions
+		real column_largest = 0;
+		real column_sum = 0;
+		real row_sum = 0;
+		for (std::size_t p = pattern.col_start[col]; p < pattern.col_start[col + 1]; ++p) {
+			w[s.inverse[pattern.row_index[p]]] = values[pattern.transpose[p]];
+			const real size = entry_size(values[p]);
+			column_largest = std::max(column_largest, size);
+			column_sum += size;
+			row_sum += entry_size(values[pattern.transpose[p]]);
+		}
+		f.norm = std::max(f.norm, std::max(column_sum, row_sum));
+		for (std::size_t p = s.l_start[i]; p < s.l_start[i + 1]; ++p) {
+			const std::size_t k = s.l_index[p];
+			const T lik = w[k] / f.u_values[s.u_start[k]];
+			f.l_values[p] = lik;
+			w[k] = T(0);
+			for (std::size_t q = s.u_start[k] + 1; q < s.u_start[k + 1]; ++q) {
+				w[s.u_index[q]] -= lik * f.u_values[q];
+			}
+		}
+		for (std::size_t q = s.u_start[i]; q < s.u_start[i + 1]; ++q) {
+			f.u_values[q] = w[s.u_index[q]];
+			w[s.u_index[q]] = T(0);
+		}
+		T& pivot = f.u_values[s.u_start[i]];
+		const real smallest = threshold * column_largest;
+		if (smallest == 0) {
+			throw std::runtime_error("Error: Admittance matrix is singular (is every node connected to ground?).");
+		}
+		const real size = entry_size(pivot);
+		if (size < smallest) {
+			// Keep the pivot's direction where it has one
+			pivot = size > 0 ? pivot * (smallest / size) : T(smallest);
+			++f.perturbed;
+		}
+	}
+}
+
+// Solve A x = b in place using the factors, with f.work as scratch space
+template <typename T>
+void solve_lu(const lu_symbolic& s, lu_numeric<T>& f, std::vector<T>& b) {
+	ACS_TIMED(solve);
+	ACS_COUNT(solves, 1);
+	const std::size_t n = s.n;
+	std::vector<T>& y = f.work;
+	for (std::size_t i = 0; i < n; ++i) {
+		T sum = b[s.perm[i]];
+		for (std::size_t p = s.l_start[i]; p < s.l_start[i + 1]; ++p) {
+			sum -= f.l_values[p] * y[s.l_index[p]];
+		}
+		y[i] = sum;
+	}
+	for (std::size_t i = n; i-- > 0;) {
+		T sum = y[i];
+		for (std::size_t q = s.u_start[i] + 1; q < s.u_start[i + 1]; ++q) {
+			sum -= f.u_values[q] * y[s.u_index[q]];
+		}
+		y[i] = sum / f.u_values[s.u_start[i]];
+	}
+	for (std::size_t i = 0; i < n; ++i) {
+		b[s.perm[i]] = y[i];
+	}
+}
+
+// Solve A^T x = b in place using the factors of A: U^T then L^T, with each
+// solved entry scattered along its row of the factor
+template <typename T>
+void solve_lu_transpose(const lu_symbolic& s, lu_numeric<T>& f, std::vector<T>& b) {
+	ACS_TIMED(solve);
+	ACS_COUNT(solves, 1);
+	const std::size_t n = s.n;
+	std::vector<T>& y = f.work;
+	for (std::size_t i = 0; i < n; ++i) {
+		y[i] = b[s.perm[i]];
+	}
+	for (std::size_t i = 0; i < n; ++i) {
+		y[i] /= f.u_values[s.u_start[i]];
+		for (std::size_t q = s.u_start[i] + 1; q < s.u_start[i + 1]; ++q) {
+			y[s.u_index[q]] -= f.u_values[q] * y[i];
+		}
+	}
+	for (std::size_t i = n; i-- > 0;) {
+		for (std::size_t p = s.l_start[i]; p < s.l_start[i + 1]; ++p) {
+			y[s.l_index[p]] -= f.l_values[p] * y[i];
+		}
+	}
+	for (std::size_t i = 0; i < n; ++i) {
+		b[s.perm[i]] = y[i];
+	}
+}
+
+// r = b - A x, or b - A^T x with transpose, for a matrix in the layout of pattern
+template <typename T>
+void lu_residual(const sparse_pattern& pattern, const std::vector<T>& values, const std::vector<T>& x,
+	const std::vector<T>& b, bool transpose, std::vector<T>& r) {
+	r = b;
+	for (std::size_t j = 0; j < pattern.n; ++j) {
+		for (std::size_t p = pattern.col_start[j]; p < pattern.col_start[j + 1]; ++p) {
+			const std::size_t i = pattern.row_index[p];
+			if (transpose) {
+				r[j] -= values[p] * x[i];
+			}
+			else {
+				r[i] -= values[p] * x[j];
+			}
+		}
+	}
+}
+
+// Refinement steps allowed per solve before giving up
+const std::size_t max_refinement_steps = 30;
+
+// Solve A x = b (or A^T x = b) in place with factors of the matrix given by values.
+// If factor_lu perturbed a pivot the factors are of a nearby matrix, so the answer is
+// refined against A until the correction is down to rounding, or the corrections
+// stop halving and the residual passes LAPACK's backward error test. A matrix that
+// cannot be solved that way is numerically singular.
+template <typename T>
+void solve_lu_refined(const sparse_pattern& pattern, const std::vector<T>& values, const lu_symbolic& s,
+	lu_numeric<T>& f, std::vector<T>& b, bool transpose = false) {
+	auto solve = [&](std::vector<T>& v) {
+		if (transpose) {
+			solve_lu_transpose(s, f, v);
+		}
+		else {
+			solve_lu(s, f, v);
+		}
+	};
+	if (f.perturbed == 0) {
+		solve(b);
+		return;
+	}
+	using real = typename lu_numeric<T>::real;
+	const real epsilon = std::numeric_limits<real>::epsilon();
+	auto largest = [](const std::vector<T>& v) {
+		real m = 0;
+		for (const T& e : v) {
+			m = std::max(m, entry_size(e));
+		}
+		return m;
+	};
+	f.target = b;
+	solve(b);
+	real previous = std::numeric_limits<real>::infinity();
+	for (std::size_t step = 0; step < max_refinement_steps; ++step) {
+		lu_residual(pattern, values, b, f.target, transpose, f.residual);
+		solve(f.residual);
+		ACS_COUNT(refinements, 1);
+		const real correction = largest(f.residual);
+		for (std::size_t i = 0; i < b.size(); ++i) {
+			b[i] += f.residual[i];
+		}
+		if (correction <= epsilon * largest(b)) {
+			return;
+		}
+		if (!(correction < previous / 2)) {
+			break;
+		}
+		previous = correction;
+	}
+	lu_residual(pattern, values, b, f.target, transpose, f.residual);
+	if (!(largest(f.residual) <= epsilon * std::sqrt(static_cast<real>(pattern.n)) * f.norm * largest(b))) {
+		throw std::runtime_error("Error: Admittance matrix is singular (is every node connected to ground?).");
+	}
+}
+
+// Components connected between numbered nodes, plus independent sources
+class netlist
+{
+public:
+	static const std::size_t ground = 0;
+	// Component connected from one node to another. The netlist does not own the
+	// part, and an operating point analysis may bias it.
+	struct branch
+	{
+		components* part;
+		std::size_t from;
+		std::size_t to;
+	};
+	// Current injected into node 'to' and drawn out of node 'from'. A voltage source
+	// keeps its voltage and internal part instead, and injects voltage / Z(f).
+	struct source
+	{
+		std::size_t from;
+		std::size_t to;
+		std::complex<double> current;
+		const components* internal = nullptr;
+		std::complex<double> voltage = 0.0;
+		std::complex<double> current_at(const frequency_point& p) const {
+			return internal != nullptr ? voltage * internal->admittance_at(p) : current;
+		}
+	};
+	// Transistor with its collector, base and emitter connected
+	struct device
+	{
+		const transistor* part;
+		std::size_t collector;
+		std::size_t base;
+		std::size_t emitter;
+	};
+private:
+	std::size_t node_count;
+	std::vector<branch> branches;
+	std::vector<source> sources;
+	std::vector<device> devices;
+	void check_node(std::size_t node) const {
+		if (node >= node_count) {
+			throw std::out_of_range("Error: Node does not exist in the netlist.");
+		}
+	}
+public:
+	netlist() : node_count(1) {}
+	~netlist() {}
+	// Create a new node and return its number
+	std::size_t add_node() {
+		return node_count++;
+	}
+	// Connect a component between two nodes; returns the branch number
+	std::size_t add_component(components* part, std::size_t from, std::size_t to) {
+		check_node(from);
+		check_node(to);
+		if (from == to) {
+			throw std::invalid_argument("Error: Component must connect two different nodes.");
+		}
+		branches.push_back({ part, from, to });
+		return branches.size() - 1;
+	}
+	// Connect a transistor by all three terminals; returns the device number
+	std::size_t add_transistor(const transistor* part, std::size_t collector, std::size_t base, std::size_t emitter) {
+		check_node(collector);
+		check_node(base);
+		check_node(emitter);
+		devices.push_back({ part, collector, base, emitter });
+		return devices.size() - 1;
+	}
+	void add_current_source(std::size_t from, std::size_t to, std::complex<double> current) {
+		check_node(from);
+		check_node(to);
+		sources.push_back({ from, to, current });
+	}
+	// A voltage source with a non-zero internal impedance, added as its Norton
+	// equivalent: the internal part as a branch, and a current of voltage / Z(f)
+	// worked out at each frequency
+	void add_voltage_source(std::size_t plus, std::size_t minus, std::complex<double> voltage, components* internal) {
+		if (internal->impedance_at(1.0) == 0.0) {
+			throw std::invalid_argument("Error: Voltage source needs a non-zero internal impedance.");
+		}
+		add_component(internal, plus, minus);
+		sources.push_back({ minus, plus, 0.0, internal, voltage });
+	}
+	std::size_t get_node_count() const {
+		return node_count;
+	}
+	const std::vector<branch>& get_branches() const {
+		return branches;
+	}
+	const std::vector<source>& get_sources() const {
+		return sources;
+	}
+	const std::vector<device>& get_devices() const {
+		return devices;
+	}
+};
+
+// Node voltages (ground included as node 0) and the current through each component
+struct ac_solution
+{
+	double frequency;
+	std::vector<std::complex<double>> node_voltages;
+	std::vector<std::complex<double>> branch_currents;
+};
+
+// Sparse admittance matrix pattern of a netlist, with the value positions each branch stamps into
+struct nodal_pattern
+{
+	// Positions of the (from, from), (to, to), (from, to) and (to, from) entries
+	struct stamp
+	{
+		std::size_t ff, tt, ft, tf;
+	};
+	// Positions of the collector, base and emitter rows and columns of a device
+	struct device_stamp
+	{
+		std::size_t entry[3][3];
+	};
+	sparse_pattern pattern;
+	std::vector<stamp> stamps;
+	std::vector<device_stamp> device_stamps;
+};
+
+nodal_pattern build_nodal_pattern(const netlist& net);
+
+// Pattern of branches given as columns of from and to nodes, with no devices
+nodal_pattern build_nodal_pattern(std::size_t node_count, const std::uint32_t* from, const std::uint32_t* to, std::size_t branch_count);
+
+// Add admittance y between the two nodes of a branch
+template <typename T>
+void stamp_branch(const nodal_pattern::stamp& s, T y, std::vector<T>& values) {
+	const std::size_t none = std::numeric_limits<std::size_t>::max();
+	if (s.ff != none) {
+		values[s.ff] += y;
+	}
+	if (s.tt != none) {
+		values[s.tt] += y;
+	}
+	if (s.ft != none) {
+		values[s.ft] -= y;
+		values[s.tf] -= y;
+	}
+}
+
+// Fill the admittance values of every branch at frequency f. The omega terms are
+// worked out once and shared by every component's admittance_at.
+void stamp_admittances(const netlist& net, const nodal_pattern& np, double f, std::vector<std::complex<double>>& values);
+
+// Right-hand side of the nodal equations from the netlist's sources at frequency f
+std::vector<std::complex<double>> source_currents(const netlist& net, double f);
+
+// Node voltages and branch currents from the solved non-ground voltages
+ac_solution make_ac_solution(const netlist& net, double f, const std::vector<std::complex<double>>& x);
+
+// Values, right-hand side and LU factors for solving one frequency point. Each
+// thread of a parallel sweep owns one, so only read-only state is shared.
+struct nodal_workspace
+{
+	lu_numeric<std::complex<double>> factors;
+	std::vector<std::complex<double>> values;
+	std::vector<std::complex<double>> rhs;
+	std::vector<std::complex<double>> adjoint;
+	// Single-precision factors and refinement scratch for nodal_precision::mixed
+	lu_numeric<std::complex<float>> single_factors;
+	std::vector<std::complex<float>> single_values;
+	std::vector<std::complex<float>> single_rhs;
+	std::vector<std::complex<double>> target;
+	std::vector<std::complex<double>> residual;
+	// The current factors are single_factors rather than factors
+	bool single = false;
+};
+
+// Precision the admittance matrix is factored in. With mixed the LU runs in single
+// precision, halving the factor storage and memory traffic, and each solve is then
+// refined in double against the double matrix, so the answers keep double accuracy
+// on ill-conditioned, high-Q networks. Refinement takes a few extra solves per point,
+// so it suits netlists whose factors have a lot of fill rather than ladders. A point
+// whose single-precision factors cannot be refined to that accuracy is refactored in
+// double.
+enum class nodal_precision { full, mixed };
+
+// A netlist analysed once for repeated solves. The matrix pattern, the fill-reducing
+// ordering and the symbolic factorization only depend on the topology, so they are
+// computed here once; each frequency point then only restamps the values and runs
+// the numeric factorization into preallocated storage. The netlist must not gain
+// or lose components while it is prepared, though component values may change.
+class prepared_netlist
+{
+private:
+	const netlist& net;
+	nodal_pattern np;
+	lu_symbolic symbolic;
+	nodal_precision precision;
+	nodal_workspace own_workspace;
+
+	// Factor the stamped values in single precision; false if they do not fit in a
+	// float or the factorization breaks down
+	bool factor_single(nodal_workspace& ws) const {
+		const sparse_pattern& p = np.pattern;
+		const double largest = std::numeric_limits<float>::max();
+		ws.single_values.resize(ws.values.size());
+		for (std::size_t k = 0; k < ws.values.size(); ++k) {
+			const std::complex<double> v = ws.values[k];
+			if (!(std::abs(v.real()) <= largest && std::abs(v.imag()) <= largest)) {
+				return false;
+			}
+			ws.single_values[k] = std::complex<float>(v);
+		}
+		try {
+			const scoped_flush_denormals flush;
+			factor_lu(p, ws.single_values, symbolic, ws.single_factors);
+		}
+		catch (const std::runtime_error&) {
+			return false;
+		}
+		return std::isfinite(ws.single_factors.norm);
+	}
+	// Iterative refinement of A x = b (or A^T x = b): each step solves for the
+	// correction with the single-precision factors and recomputes the residual in
+	// double. It stops once the correction is down to double rounding of x, or when
+	// the corrections stop halving, in which case the answer is kept only if its
+	// residual passes LAPACK's zcgesv test. Otherwise b is left untouched.
+	bool refine(nodal_workspace& ws, std::vector<std::complex<double>>& b, bool transpose) const {
+		const std::size_t n = np.pattern.n;
+		const double epsilon = std::numeric_limits<double>::epsilon();
+		const double tolerance = epsilon * std::sqrt(static_cast<double>(n)) * static_cast<double>(ws.single_factors.norm);
+		auto largest = [](const std::vector<std::complex<double>>& v) {
+			double m = 0.0;
+			for (const std::complex<double>& e : v) {
+				m = std::max(m, entry_size(e));
+			}
+			return m;
+		};
+		ws.target = b;
+		ws.residual = b;
+		b.assign(n, 0.0);
+		double previous = std::numeric_limits<double>::infinity();
+		for (std::size_t step = 0; step < max_refinement_steps; ++step) {
+			const double r = largest(ws.residual);
+			if (r == 0.0) {
+				return true;
+			}
+			// The residual is scaled to unit size so it cannot overflow a float
+			ws.single_rhs.resize(n);
+			for (std::size_t i = 0; i < n; ++i) {
+				ws.single_rhs[i] = std::complex<float>(ws.residual[i] / r);
+			}
+			{
+				const scoped_flush_denormals flush;
+				if (transpose) {
+					solve_lu_transpose(symbolic, ws.single_factors, ws.single_rhs);
+				}
+				else {
+					solve_lu(symbolic, ws.single_factors, ws.single_rhs);
+				}
+			}
+			ACS_COUNT(refinements, 1);
+			double correction = 0.0;
+			for (std::size_t i = 0; i < n; ++i) {
+				const std::complex<double> d = r * std::complex<double>(ws.single_rhs[i]);
+				b[i] += d;
+				correction = std::max(correction, entry_size(d));
+			}
+			lu_residual(np.pattern, ws.values, b, ws.target, transpose, ws.residual);
+			if (correction <= epsilon * largest(b)) {
+				return true;
+			}
+			if (!(correction < 0.5 * previous)) {
+				break;
+			}
+			previous = correction;
+		}
+		if (largest(ws.residual) <= tolerance * largest(b)) {
+			return true;
+		}
+		b = ws.target;
+		return false;
+	}
+	// Solve in place with the current factors, refactoring in double if the
+	// single-precision ones cannot be refined
+	void solve_factored(nodal_workspace& ws, std::vector<std::complex<double>>& b, bool transpose) const {
+		if (ws.single) {
+			if (refine(ws, b, transpose)) {
+				return;
+			}
+			ACS_COUNT(precision_fallbacks, 1);
+			factor_lu(np.pattern, ws.values, symbolic, ws.factors);
+			ws.single = false;
+		}
+		solve_lu_refined(np.pattern, ws.values, symbolic, ws.factors, b, transpose);
+	}
+public:
+	explicit prepared_netlist(const netlist& n, nodal_precision p = nodal_precision::full) :
+		net(n), np(build_nodal_pattern(n)), precision(p) {
+		symbolic = analyse_lu(np.pattern, minimum_degree_order(np.pattern));
+		own_workspace = make_workspace();
+	}
+	~prepared_netlist() {}
+	nodal_precision get_precision() const {
+		return precision;
+	}
+	// Workspace sized for this netlist, for callers solving from several threads
+	nodal_workspace make_workspace() const {
+		nodal_workspace ws;
+		ws.values.reserve(np.pattern.row_index.size());
+		ws.rhs.reserve(np.pattern.n);
+		if (precision == nodal_precision::mixed) {
+			ws.single_values.reserve(np.pattern.row_index.size());
+			ws.single_rhs.reserve(np.pattern.n);
+			ws.single_factors.l_values.reserve(symbolic.l_index.size());
+			ws.single_factors.u_values.reserve(symbolic.u_index.size());
+			ws.single_factors.work.reserve(np.pattern.n);
+			ws.target.reserve(np.pattern.n);
+			ws.residual.reserve(np.pattern.n);
+		}
+		else {
+			ws.factors.l_values.reserve(symbolic.l_index.size());
+			ws.factors.u_values.reserve(symbolic.u_index.size());
+			ws.factors.work.reserve(np.pattern.n);
+		}
+		return ws;
+	}
+	// Numeric factorization of the admittance matrix at frequency f
+	void factor(double f, nodal_workspace& ws) const {
+		if (net.get_branches().size() != np.stamps.size() || net.get_devices().size() != np.device_stamps.size() ||
+			net.get_node_count() != np.pattern.n + 1) {
+			throw std::logic_error("Error: Netlist topology changed after it was prepared.");
+		}
+		stamp_admittances(net, np, f, ws.values);
+		ws.single = precision == nodal_precision::mixed && factor_single(ws);
+		if (precision == nodal_precision::mixed && !ws.single) {
+			ACS_COUNT(precision_fallbacks, 1);
+		}
+		if (!ws.single) {
+			factor_lu(np.pattern, ws.values, symbolic, ws.factors);
+		}
+	}
+	void factor(double f) {
+		factor(f, own_workspace);
+	}
+	// Full solution driven by the netlist's sources
+	ac_solution solve(double f, nodal_workspace& ws) const {
+		factor(f, ws);
+		ws.rhs = source_currents(net, f);
+		solve_factored(ws, ws.rhs, false);
+		return make_ac_solution(net, f, ws.rhs);
+	}
+	ac_solution solve(double f) {
+		return solve(f, own_workspace);
+	}
+	// Impedance seen between two nodes, found by driving 1 A between them with the netlist's own sources switched off.
+	// The matrix is refactored on every call, since component values may have changed since the last one.
+	std::complex<double> port_impedance(std::size_t plus, std::size_t minus, double f, nodal_workspace& ws) const {
+		factor(f, ws);
+		ws.rhs.assign(np.pattern.n, 0.0);
+		if (plus != netlist::ground) {
+			ws.rhs[plus - 1] += 1.0;
+		}
+		if (minus != netlist::ground) {
+			ws.rhs[minus - 1] -= 1.0;
+		}
+		solve_factored(ws, ws.rhs, false);
+		const std::complex<double> vp = plus != netlist::ground ? ws.rhs[plus - 1] : 0.0;
+		const std::complex<double> vm = minus != netlist::ground ? ws.rhs[minus - 1] : 0.0;
+		return vp - vm;
+	}
+	std::complex<double> port_impedance(std::size_t plus, std::size_t minus, double f) {
+		return port_impedance(plus, minus, f, own_workspace);
+	}
+	// Port impedance together with its derivative with respect to the value of every
+	// branch component, in branch order (0 for parts without a single value, and
+	// transistors connected by add_transistor are not included). With Z = c^T A^-1 c
+	// for the port vector c, dZ/dp = -lambda^T (dA/dp) x where A^T lambda = c, so all
+	// of the derivatives together cost one extra solve with the same factors.
+	std::complex<double> port_sensitivities(std::size_t plus, std::size_t minus, double f,
+		std::vector<std::complex<double>>& derivatives, nodal_workspace& ws) const {
+		const std::complex<double> z = port_impedance(plus, minus, f, ws);
+		ws.adjoint.assign(np.pattern.n, 0.0);
+		if (plus != netlist::ground) {
+			ws.adjoint[plus - 1] += 1.0;
+		}
+		if (minus != netlist::ground) {
+			ws.adjoint[minus - 1] -= 1.0;
+		}
+		solve_factored(ws, ws.adjoint, true);
+		auto across = [](const std::vector<std::complex<double>>& v, const netlist::branch& b) {
+			const std::complex<double> from = b.from != netlist::ground ? v[b.from - 1] : 0.0;
+			const std::complex<double> to = b.to != netlist::ground ? v[b.to - 1] : 0.0;
+			return from - to;
+		};
+		const std::vector<netlist::branch>& branches = net.get_branches();
+		derivatives.resize(branches.size());
+		for (std::size_t k = 0; k < branches.size(); ++k) {
+			// The branch stamps y = 1/z, so dy/dp = -z'/z^2
+			const std::complex<double> zk = branches[k].part->impedance_at(f);
+			const std::complex<double> dy = -branches[k].part->impedance_derivative_at(f) / (zk * zk);
+			derivatives[k] = -across(ws.adjoint, branches[k]) * dy * across(ws.rhs, branches[k]);
+		}
+		return z;
+	}
+	std::complex<double> port_sensitivities(std::size_t plus, std::size_t minus, double f,
+		std::vector<std::complex<double>>& derivatives) {
+		return port_sensitivities(plus, minus, f, derivatives, own_workspace);
+	}
+	// Bode curve of the impedance between two nodes
+	sweep_result sweep_port(std::size_t plus, std::size_t minus, const std::vector<double>& freqs) {
+		sweep_result result;
+		result.frequency = freqs;
+		result.magnitude.resize(freqs.size());
+		result.phase.resize(freqs.size());
+		for (std::size_t i = 0; i < freqs.size(); ++i) {
+			const std::complex<double> z = port_impedance(plus, minus, freqs[i]);
+			result.magnitude[i] = std::abs(z);
+			result.phase[i] = std::arg(z);
+		}
+		return result;
+	}
+	std::size_t get_factor_nonzeros() const {
+		return symbolic.l_index.size() + symbolic.u_index.size();
+	}
+};
+
+// Solve the netlist at a single frequency
+ac_solution solve_ac(const netlist& net, double f);
+
+// Impedance between two nodes at a single frequency
+std::complex<double> port_impedance(const netlist& net, std::size_t plus, std::size_t minus, double f);
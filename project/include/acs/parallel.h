@@ -0,0 +1,130 @@
+﻿#pragma once
+
+#include "acs/circuit.h"
+#include "acs/nodal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run a job together. The calling thread takes
+// part as worker 0, so a pool of size 1 runs everything inline.
+class thread_pool
+{
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable start;
+	std::condition_variable finished;
+	std::function<void(std::size_t)> job;
+	std::size_t generation;
+	std::size_t running;
+	bool stopping;
+	std::exception_ptr error;
+
+	void worker_loop(std::size_t index) {
+		std::size_t seen = 0;
+		for (;;) {
+			std::function<void(std::size_t)> current;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				start.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping) {
+					return;
+				}
+				seen = generation;
+				current = job;
+			}
+			run(current, index);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--running == 0) {
+				finished.notify_one();
+			}
+		}
+	}
+	void run(const std::function<void(std::size_t)>& f, std::size_t index) {
+		try {
+			f(index);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	}
+public:
+	explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency()) :
+		generation(0), running(0), stopping(false) {
+		threads = std::max<std::size_t>(threads, 1);
+		for (std::size_t i = 1; i < threads; ++i) {
+			workers.emplace_back(&thread_pool::worker_loop, this, i);
+		}
+	}
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		start.notify_all();
+		for (std::thread& t : workers) {
+			t.join();
+		}
+	}
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+	std::size_t size() const {
+		return workers.size() + 1;
+	}
+	// Run f(worker_index) once on every worker and wait for all of them
+	void run_on_all(const std::function<void(std::size_t)>& f) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = f;
+			running = workers.size();
+			error = nullptr;
+			++generation;
+		}
+		start.notify_all();
+		run(f, 0);
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [&] { return running == 0; });
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+	// Split [0, count) into chunks handed out on demand, so faster threads take more
+	// of the work. body(begin, end, worker_index) is called for each chunk.
+	void parallel_for(std::size_t count, std::size_t chunk, const std::function<void(std::size_t, std::size_t, std::size_t)>& body) {
+		chunk = std::max<std::size_t>(chunk, 1);
+		if (size() == 1 || count <= chunk) {
+			if (count > 0) {
+				body(0, count, 0);
+			}
+			return;
+		}
+		std::atomic<std::size_t> next(0);
+		run_on_all([&](std::size_t worker) {
+			for (;;) {
+				const std::size_t begin = next.fetch_add(chunk);
+				if (begin >= count) {
+					return;
+				}
+				body(begin, std::min(count, begin + chunk), worker);
+			}
+		});
+	}
+};
+
+// Sweep a circuit with the frequency points shared out across the pool. The
+// circuit is only read, so every thread works on its own slice of the output.
+sweep_result parallel_sweep(const circuit& c, const std::vector<double>& freqs, thread_pool& pool);
+
+// Port sweep of a prepared netlist with one workspace per thread
+sweep_result parallel_sweep_port(const prepared_netlist& prepared, std::size_t plus, std::size_t minus,
+	const std::vector<double>& freqs, thread_pool& pool);
@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include "acs/circuit.h"
+#include "acs/columnar.h"
+#include "acs/nodal.h"
+
+#include <complex>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// Model-order reduction of large RLC netlists by PRIMA. Written with a current
+// unknown per inductor, the network is (G + sC) x = B u for the impedance at its
+// ports, Z(s) = B^T (G + sC)^-1 B. An orthonormal basis V of the block Krylov
+// space of (G + s0 C)^-1 C and (G + s0 C)^-1 B, for a real expansion point s0,
+// turns this into the same form with V^T G V, V^T C V and V^T B: a model of a
+// few dozen states whose impedance matches that many moments of Z about s0.
+// One point matches the curve well for a decade or two either side of it, so a
+// wider band takes moments about several points into a single basis.
+// Projecting by congruence keeps the reduced C symmetric and positive
+// semidefinite and the symmetric part of the reduced G positive semidefinite,
+// so the reduced model is passive like the network it came from.
+//
+// Each Krylov step is one sparse solve, using the nodal matrix at an expansion
+// point with the inductor currents eliminated, so reduction costs about as much
+// as solving a few dozen frequency points, and every point of a sweep after that
+// is a small dense solve.
+
+// Pair of nodes at whose terminals the impedance is wanted
+struct netlist_port
+{
+	std::size_t plus;
+	std::size_t minus;
+};
+
+struct reduction_options
+{
+	// Band the model has to be accurate over
+	double f_min = 1.0;
+	double f_max = 1e9;
+	// Real expansion points, spread evenly over the band on a log scale, or 0 for
+	// one per decade of the band
+	std::size_t expansion_points = 0;
+	// Number of states to keep, or 0 to add states until the impedance over the
+	// band changes by less than 'tolerance' as the order grows by a quarter
+	std::size_t order = 0;
+	double tolerance = 1e-6;
+	// Most states kept when the order is chosen by the tolerance
+	std::size_t max_order = 200;
+};
+
+// Reduced model in the form (g + sc) x = b u, with the impedance at its ports
+// evaluated through a Hessenberg form of the system, so each frequency point
+// costs O(order^2) per port
+class reduced_model
+{
+private:
+	std::size_t ports;
+	std::size_t states;
+	double s0;
+	std::vector<double> g;
+	std::vector<double> c;
+	std::vector<double> b;
+	// (g + s0 c)^-1 c = Q h Q^T with h upper Hessenberg; left is Q^T b and
+	// right is Q^T (g + s0 c)^-1 b
+	std::vector<double> h;
+	std::vector<double> left;
+	std::vector<double> right;
+	double estimated_error;
+
+	void check_port(std::size_t port) const {
+		if (port >= ports) {
+			throw std::out_of_range("Error: Reduced model has no such port.");
+		}
+	}
+	// LU factors of I + sigma h in 'factors', with the row swaps in 'swapped'
+	void factor(std::complex<double> sigma, std::vector<std::complex<double>>& factors, std::vector<char>& swapped) const;
+	std::complex<double> solve(std::size_t plus, std::size_t into, const std::vector<std::complex<double>>& factors,
+		const std::vector<char>& swapped, std::vector<std::complex<double>>& y) const;
+public:
+	reduced_model() : ports(0), states(0), s0(0.0), estimated_error(std::numeric_limits<double>::infinity()) {}
+	// Model from its matrices, all row-major: g and c are order x order and b is
+	// order x port_count. The expansion frequency only sets the point the
+	// evaluation form is built around.
+	reduced_model(std::size_t port_count, double expansion_frequency, std::vector<double> g_values,
+		std::vector<double> c_values, std::vector<double> b_values,
+		double error = std::numeric_limits<double>::infinity());
+	~reduced_model() {}
+	std::size_t get_order() const {
+		return states;
+	}
+	std::size_t get_port_count() const {
+		return ports;
+	}
+	double get_expansion_frequency() const {
+		return s0 / (2 * pi);
+	}
+	const std::vector<double>& get_g() const {
+		return g;
+	}
+	const std::vector<double>& get_c() const {
+		return c;
+	}
+	const std::vector<double>& get_b() const {
+		return b;
+	}
+	// Largest relative change of the impedance over the band from a model with
+	// about four fifths of the states, a guide to the error of the model; zero
+	// if the model is exact and infinite if there was nothing to compare
+	double get_estimated_error() const {
+		return estimated_error;
+	}
+	// Voltage across port 'plus' with 1 A driven into port 'into', at frequency f
+	std::complex<double> impedance(double f, std::size_t plus = 0, std::size_t into = 0) const;
+	// Every port impedance at f, row-major by the port the voltage is across
+	std::vector<std::complex<double>> impedance_matrix(double f) const;
+	// Bode curve of the impedance at one port
+	sweep_result sweep_port(const std::vector<double>& freqs, std::size_t port = 0) const;
+};
+
+// Reduce the resistors, capacitors and inductors of a netlist as seen from the
+// given ports. Sources are ignored, as for port_impedance; anything else is an error.
+reduced_model reduce_netlist(const netlist& net, const std::vector<netlist_port>& ports,
+	const reduction_options& options = reduction_options());
+
+// The same straight from the columns of a netlist file
+reduced_model reduce_netlist(const mapped_netlist& net, const std::vector<netlist_port>& ports,
+	const reduction_options& options = reduction_options());
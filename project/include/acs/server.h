@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include "acs/arena.h"
+#include "acs/batch.h"
+#include "acs/cache.h"
+#include "acs/monte_carlo.h"
+#include "acs/parallel.h"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Server mode. One long-running process answers a stream of requests, so the
+// thread pool, the sweep cache and the kernels are set up once instead of per
+// query. Requests and responses are JSON objects, one per line:
+//   {"id":1,"op":"evaluate","type":2,"frequency":1000,"values":[10,1e-6,0.01]}
+//   {"id":2,"op":"sweep","type":2,"values":[10,1e-6,0.01],"start":10,"stop":1e5,"points":200}
+//   {"id":3,"op":"stats"}
+// are answered with
+//   {"id":1,"magnitude":...,"phase":...}
+//   {"id":2,"frequency":[...],"magnitude":[...],"phase":[...]}
+//   {"id":3,"evaluate":{"count":...,"p50_us":...,"p99_us":...,"max_us":...},...}
+// The types and values are those of batch mode. The id may be a number or a
+// string and is echoed back as written; a request that cannot be served is
+// answered with {"id":...,"error":"Error: ..."}. Responses come in request order.
+//
+// A reader thread parses and queues each line as it arrives. The server takes
+// everything queued at once and evaluates the requests for one circuit type
+// together in lanes: every evaluation in one pass, whatever its frequency, and
+// every sweep over the same grid in one lane sweep. Batches grow with the load,
+// so the cost per request falls just when the queue is longest.
+
+// Kinds of request, with "invalid" for lines that could not be parsed
+enum class request_kind { evaluate, sweep, stats, invalid };
+const std::size_t request_kind_count = 4;
+
+// Largest sweep a request may ask for
+const std::size_t max_request_points = 1 << 20;
+
+// One request and, once served, its result
+struct server_request
+{
+	request_kind kind = request_kind::invalid;
+	// The id exactly as written, or empty if the request has none
+	std::string id;
+	// Type and values; the frequency is only used by evaluate
+	circuit_record record = {};
+	double start = 0.0;
+	double stop = 0.0;
+	std::size_t points = 0;
+	// instrumentation::now() when the line was read
+	std::uint64_t received = 0;
+	// Set when the request cannot be served
+	std::string error;
+	double magnitude = 0.0;
+	double phase = 0.0;
+	std::shared_ptr<const sweep_result> curve;
+};
+
+// Parse one request line into 'request'. Returns false for blank lines and throws
+// std::invalid_argument for malformed ones; the id is kept if it was read first.
+bool parse_request(const char* p, const char* last, server_request& request);
+
+struct server_options
+{
+	unsigned threads = std::thread::hardware_concurrency();
+	// Most requests taken off the queue as one batch
+	std::size_t max_batch = 4096;
+	// Sweep cache budget in bytes, and a directory to keep it in across restarts
+	std::size_t cache_bytes = 64 << 20;
+	std::string cache_directory;
+};
+
+// Latency from a request being read to its response being written
+struct latency_summary
+{
+	std::uint64_t count = 0;
+	double p50 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+class simulation_server
+{
+private:
+	server_options options;
+	thread_pool pool;
+	sweep_cache cache;
+	arena circuits;
+	std::vector<quantile_sketch> latency;
+	std::vector<double> worst;
+	std::uint64_t batches;
+	std::size_t largest_batch;
+
+	void evaluate_all(std::vector<server_request>& batch);
+	void sweep_all(std::vector<server_request>& batch);
+public:
+	explicit simulation_server(const server_options& settings = server_options());
+	~simulation_server() {}
+	simulation_server(const simulation_server&) = delete;
+	simulation_server& operator=(const simulation_server&) = delete;
+	// Serve every request in 'in' until it ends, one response line each to 'out'
+	void run(std::istream& in, std::ostream& out);
+	// Serve one batch of parsed requests in place
+	void serve(std::vector<server_request>& batch);
+	// Percentiles in microseconds of every request of one kind answered so far
+	latency_summary get_latency(request_kind kind) const;
+	cache_statistics get_cache_statistics() const {
+		return cache.get_statistics();
+	}
+	std::uint64_t get_batches() const {
+		return batches;
+	}
+	std::size_t get_largest_batch() const {
+		return largest_batch;
+	}
+	// Table of the latencies per kind of request
+	void write_summary(std::ostream& out) const;
+};
@@ -0,0 +1,234 @@
+﻿#pragma once
+
+#include "acs/circuit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Streamed sweeps. A sweep of 10^7 points does not need its frequencies or its
+// results in memory all at once: the grid gives each frequency on demand and the
+// stream fills a caller's buffer one chunk at a time, so memory use is set by the
+// chunk size and not by the length of the sweep.
+
+// Frequencies spaced evenly on a log (or linear) scale from start to stop,
+// computed when asked for rather than stored
+class frequency_grid
+{
+private:
+	double start;
+	double stop;
+	std::size_t points;
+	bool logarithmic;
+public:
+	frequency_grid(double f_start, double f_stop, std::size_t n, bool log_spaced = true) :
+		start(f_start), stop(f_stop), points(n), logarithmic(log_spaced) {
+		if (n == 0) {
+			throw std::invalid_argument("Error: Sweep needs at least one point.");
+		}
+		if (!(f_start > 0) || !(f_stop >= f_start) || !std::isfinite(f_stop)) {
+			throw std::invalid_argument("Error: Sweep frequencies must be positive and in increasing order.");
+		}
+	}
+	std::size_t size() const {
+		return points;
+	}
+	// Frequency of point i; the last point is exactly the stop frequency
+	double operator[](std::size_t i) const {
+		if (i + 1 == points && points > 1) {
+			return stop;
+		}
+		const double t = points > 1 ? static_cast<double>(i) / static_cast<double>(points - 1) : 0.0;
+		return logarithmic ? start * std::pow(stop / start, t) : start + (stop - start) * t;
+	}
+	// Frequencies of points first .. first + n - 1
+	void fill(std::size_t first, std::size_t n, double* out) const {
+		for (std::size_t i = 0; i < n; ++i) {
+			out[i] = (*this)[first + i];
+		}
+	}
+};
+
+// Chunk of a streamed sweep: points first .. first + size - 1 of the grid, in
+// buffers owned by whoever produced the chunk
+struct sweep_chunk
+{
+	std::size_t first = 0;
+	std::size_t size = 0;
+	const double* frequency = nullptr;
+	const double* magnitude = nullptr;
+	const double* phase = nullptr;
+};
+
+// Pull-based sweep over a grid. Each call to next() evaluates the following points
+// into the caller's buffers; evaluate(freqs, n, magnitude, phase) does the work,
+// so the stream can drive a circuit or anything else with a sweep.
+class sweep_stream
+{
+public:
+	using evaluator = std::function<void(const double*, std::size_t, double*, double*)>;
+private:
+	evaluator evaluate;
+	frequency_grid grid;
+	std::size_t position;
+public:
+	sweep_stream(evaluator e, const frequency_grid& g) : evaluate(std::move(e)), grid(g), position(0) {}
+	// Stream of a circuit's Bode curve. The circuit is only read, and must outlive the stream.
+	sweep_stream(const circuit& c, const frequency_grid& g) :
+		sweep_stream([&c](const double* f, std::size_t n, double* magnitude, double* phase) {
+			c.sweep(f, n, magnitude, phase);
+		}, g) {}
+	~sweep_stream() {}
+	// Evaluate up to 'capacity' points into the buffers; returns how many, 0 at the end
+	std::size_t next(double* frequency, double* magnitude, double* phase, std::size_t capacity) {
+		const std::size_t n = std::min(capacity, grid.size() - position);
+		if (n > 0) {
+			grid.fill(position, n, frequency);
+			evaluate(frequency, n, magnitude, phase);
+			position += n;
+		}
+		return n;
+	}
+	bool done() const {
+		return position == grid.size();
+	}
+	// Index of the next point to be evaluated
+	std::size_t get_position() const {
+		return position;
+	}
+	const frequency_grid& get_grid() const {
+		return grid;
+	}
+	void rewind() {
+		position = 0;
+	}
+};
+
+// Sweep stream that works one chunk ahead: while the caller consumes chunk k (for
+// example writing it to an output sink), a worker thread evaluates chunk k + 1
+// into the other of two buffers. A sweep that fits in one chunk is evaluated by
+// the caller's thread, with no worker started.
+class pipelined_sweep
+{
+private:
+	struct buffer
+	{
+		std::vector<double> frequency;
+		std::vector<double> magnitude;
+		std::vector<double> phase;
+		std::size_t first = 0;
+		std::size_t size = 0;
+		bool ready = false;
+	};
+	sweep_stream stream;
+	std::size_t chunk_size;
+	buffer buffers[2];
+	std::size_t current;
+	bool handed_out;
+	bool stopping;
+	std::exception_ptr error;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::thread worker;
+
+	void fill(buffer& b) {
+		b.first = stream.get_position();
+		b.size = stream.next(b.frequency.data(), b.magnitude.data(), b.phase.data(), chunk_size);
+	}
+	// Fill the buffers in turn, each once the caller has handed it back
+	void produce() {
+		for (std::size_t i = 0;; i ^= 1) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				changed.wait(lock, [&] { return stopping || !buffers[i].ready; });
+				if (stopping) {
+					return;
+				}
+			}
+			bool last;
+			try {
+				fill(buffers[i]);
+				last = buffers[i].size == 0;
+			}
+			catch (...) {
+				buffers[i].size = 0;
+				last = true;
+				std::lock_guard<std::mutex> lock(mutex);
+				error = std::current_exception();
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				buffers[i].ready = true;
+			}
+			changed.notify_all();
+			if (last) {
+				return;
+			}
+		}
+	}
+public:
+	pipelined_sweep(sweep_stream s, std::size_t chunk = 4096) :
+		stream(std::move(s)), chunk_size(std::max<std::size_t>(chunk, 1)), current(0), handed_out(false), stopping(false) {
+		for (buffer& b : buffers) {
+			b.frequency.resize(chunk_size);
+			b.magnitude.resize(chunk_size);
+			b.phase.resize(chunk_size);
+		}
+		if (stream.get_grid().size() - stream.get_position() <= chunk_size) {
+			// The second buffer stays empty and marks the end
+			fill(buffers[0]);
+			buffers[0].ready = true;
+			buffers[1].ready = true;
+		}
+		else {
+			worker = std::thread(&pipelined_sweep::produce, this);
+		}
+	}
+	~pipelined_sweep() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		changed.notify_all();
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+	pipelined_sweep(const pipelined_sweep&) = delete;
+	pipelined_sweep& operator=(const pipelined_sweep&) = delete;
+	// Next chunk of results, valid until the following call; false once the sweep is done
+	bool next(sweep_chunk& chunk) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (handed_out) {
+			// The caller is finished with the previous chunk, so the worker may refill it
+			if (worker.joinable()) {
+				buffers[current].ready = false;
+			}
+			current ^= 1;
+			handed_out = false;
+			changed.notify_all();
+		}
+		changed.wait(lock, [&] { return buffers[current].ready; });
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		const buffer& b = buffers[current];
+		if (b.size == 0) {
+			return false;
+		}
+		chunk.first = b.first;
+		chunk.size = b.size;
+		chunk.frequency = b.frequency.data();
+		chunk.magnitude = b.magnitude.data();
+		chunk.phase = b.phase.data();
+		handed_out = true;
+		return true;
+	}
+};
@@ -0,0 +1,358 @@
+﻿#pragma once
+
+#include "acs/nodal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Transient analysis. At every time step each capacitor and inductor is replaced
+// by its companion model, a conductance in parallel with a current source that
+// carries the state of the previous step. The resulting real nodal equations
+// use the same pattern, ordering and sparse LU as the AC solver.
+
+// Source value as a function of time, plus the times where it has corners so the
+// stepper can land on them rather than step across them
+class waveform
+{
+private:
+	std::function<double(double)> value;
+	std::function<double(double)> corner;
+public:
+	waveform(double constant) : value([constant](double) { return constant; }) {}
+	explicit waveform(std::function<double(double)> v, std::function<double(double)> next_corner = nullptr) :
+		value(std::move(v)), corner(std::move(next_corner)) {}
+	~waveform() {}
+	double operator()(double t) const {
+		return value(t);
+	}
+	// First corner strictly after t, or infinity if there is none
+	double next_corner(double t) const {
+		return corner ? corner(t) : std::numeric_limits<double>::infinity();
+	}
+};
+
+// Zero until 'delay', then 'amplitude'
+waveform step_waveform(double amplitude, double delay = 0.0);
+
+// Trapezoidal pulse in the style of SPICE PULSE. A period of 0 gives a single pulse.
+waveform pulse_waveform(double low, double high, double delay, double rise, double fall, double width, double period = 0.0);
+
+// offset + amplitude sin(2 pi f (t - delay)), holding 'offset' before the delay
+waveform sine_waveform(double offset, double amplitude, double frequency, double delay = 0.0);
+
+enum class integration_method { backward_euler, trapezoidal };
+
+struct transient_options
+{
+	integration_method method = integration_method::trapezoidal;
+	// With adaptive stepping the step follows the local truncation error and
+	// 'step' is only the first one; otherwise every step is 'step' long.
+	// Zero picks stop / 1000 for fixed steps and stop * 1e-6 for the first adaptive one.
+	bool adaptive = true;
+	double step = 0.0;
+	// Zero picks stop * 1e-12 and stop / 50
+	double min_step = 0.0;
+	double max_step = 0.0;
+	// Allowed truncation error per step on each node voltage
+	double relative_tolerance = 1e-3;
+	double absolute_tolerance = 1e-6;
+};
+
+struct transient_statistics
+{
+	std::size_t accepted_steps = 0;
+	std::size_t rejected_steps = 0;
+	std::size_t factorizations = 0;
+};
+
+// Time-domain simulation of a netlist made of resistors, capacitors, inductors
+// and two-terminal transistors (taken as their output resistance r_o). The netlist's phasor sources do
+// not take part; time-dependent sources are added to the analysis instead.
+// Every run starts from rest, with capacitors uncharged and no inductor current,
+// and reports the node voltages after each accepted step through a callback, so
+// no history is kept. As with prepared_netlist, the topology must stay fixed.
+class transient_analysis
+{
+private:
+	struct driven_source
+	{
+		std::size_t from;
+		std::size_t to;
+		waveform value;
+		// Branch whose resistance turns a voltage into a Norton current, or none for current sources
+		std::size_t branch;
+	};
+	// Companion model state of one branch
+	struct branch_state
+	{
+		component_kind kind;
+		double value;
+		double conductance;
+		double source;
+		double voltage;
+		double current;
+	};
+
+	const netlist& net;
+	nodal_pattern np;
+	lu_symbolic symbolic;
+	std::vector<driven_source> sources;
+	std::vector<branch_state> states;
+	std::vector<double> values;
+	std::vector<double> rhs;
+	std::vector<double> voltages;
+	lu_numeric<double> factors;
+	// Last few accepted solutions for the error estimate, newest first
+	std::vector<std::vector<double>> history;
+	double history_times[3];
+	std::size_t history_count;
+
+	static constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+	// Read the component values and reset every branch to rest
+	void load_components() {
+		if (net.get_branches().size() != np.stamps.size() || net.get_node_count() != np.pattern.n + 1) {
+			throw std::logic_error("Error: Netlist topology changed after it was prepared.");
+		}
+		states.clear();
+		for (const netlist::branch& b : net.get_branches()) {
+			branch_state state = { b.part->get_kind(), b.part->get_value(), 0.0, 0.0, 0.0, 0.0 };
+			if (state.kind == component_kind::diode) {
+				throw std::invalid_argument("Error: Transient analysis does not support diodes.");
+			}
+			if (state.kind == component_kind::transistor) {
+				state.kind = component_kind::resistor;
+			}
+			if (state.value == 0.0) {
+				throw std::invalid_argument("Error: Component values must be non-zero for transient analysis.");
+			}
+			states.push_back(state);
+		}
+		for (const driven_source& s : sources) {
+			if (s.branch != none && states[s.branch].kind != component_kind::resistor) {
+				throw std::invalid_argument("Error: A voltage source must drive a resistive branch.");
+			}
+		}
+	}
+
+	// Companion conductances for step h, stamped and factored
+	void factor(double h, integration_method method) {
+		const bool trapezoidal = method == integration_method::trapezoidal;
+		values.assign(np.pattern.row_index.size(), 0.0);
+		for (std::size_t k = 0; k < states.size(); ++k) {
+			branch_state& s = states[k];
+			switch (s.kind) {
+			case component_kind::capacitor:
+				s.conductance = (trapezoidal ? 2.0 : 1.0) * s.value / h;
+				break;
+			case component_kind::inductor:
+				s.conductance = h / ((trapezoidal ? 2.0 : 1.0) * s.value);
+				break;
+			default:
+				s.conductance = 1.0 / s.value;
+				break;
+			}
+			stamp_branch(np.stamps[k], s.conductance, values);
+		}
+		factor_lu(np.pattern, values, symbolic, factors);
+	}
+
+	// Right-hand side for the step ending at time t: the companion sources carrying
+	// the previous state plus the independent sources
+	void build_rhs(double t, integration_method method) {
+		const bool trapezoidal = method == integration_method::trapezoidal;
+		const std::vector<netlist::branch>& branches = net.get_branches();
+		rhs.assign(np.pattern.n, 0.0);
+		for (std::size_t k = 0; k < states.size(); ++k) {
+			branch_state& s = states[k];
+			// Branch current is conductance * voltage + source
+			switch (s.kind) {
+			case component_kind::capacitor:
+				s.source = -s.conductance * s.voltage - (trapezoidal ? s.current : 0.0);
+				break;
+			case component_kind::inductor:
+				s.source = s.current + (trapezoidal ? s.conductance * s.voltage : 0.0);
+				break;
+			default:
+				s.source = 0.0;
+				break;
+			}
+			inject(branches[k].from, branches[k].to, s.source);
+		}
+		for (const driven_source& s : sources) {
+			const double current = s.branch == none ? s.value(t) : s.value(t) / states[s.branch].value;
+			inject(s.from, s.to, current);
+		}
+	}
+
+	// Current flowing out of node 'from' into node 'to'
+	void inject(std::size_t from, std::size_t to, double current) {
+		if (to != netlist::ground) {
+			rhs[to - 1] += current;
+		}
+		if (from != netlist::ground) {
+			rhs[from - 1] -= current;
+		}
+	}
+
+	// Local truncation error of the solution in rhs relative to the tolerance,
+	// from the difference to a polynomial extrapolation of earlier steps. Returns
+	// 0 while there is not enough history, otherwise sets 'order' to the order
+	// the error was estimated for.
+	double error_ratio(double t, integration_method method, const transient_options& options, int& order) const {
+		const std::size_t points = std::min<std::size_t>(history_count, method == integration_method::trapezoidal ? 3 : 2);
+		if (points < 2) {
+			return 0.0;
+		}
+		order = static_cast<int>(points) - 1;
+		// Milne's estimate with the error constants of the method and of the predictor
+		const double scale = points == 3 ? 1.0 / 13.0 : 1.0 / 3.0;
+		double weights[3];
+		for (std::size_t j = 0; j < points; ++j) {
+			weights[j] = 1.0;
+			for (std::size_t m = 0; m < points; ++m) {
+				if (m != j) {
+					weights[j] *= (t - history_times[m]) / (history_times[j] - history_times[m]);
+				}
+			}
+		}
+		double worst = 0.0;
+		for (std::size_t i = 0; i < rhs.size(); ++i) {
+			double predicted = 0.0;
+			for (std::size_t j = 0; j < points; ++j) {
+				predicted += weights[j] * history[j][i];
+			}
+			const double tolerance = options.absolute_tolerance +
+				options.relative_tolerance * std::max(std::abs(rhs[i]), std::abs(history[0][i]));
+			worst = std::max(worst, scale * std::abs(rhs[i] - predicted) / tolerance);
+		}
+		return worst;
+	}
+
+public:
+	explicit transient_analysis(const netlist& n) : net(n), np(build_nodal_pattern(n)), history(3), history_count(0) {
+		if (!net.get_devices().empty()) {
+			throw std::invalid_argument("Error: Transient analysis does not support three-terminal transistors.");
+		}
+		symbolic = analyse_lu(np.pattern, minimum_degree_order(np.pattern));
+	}
+	~transient_analysis() {}
+	// Current out of node 'from' and into node 'to'
+	void add_current_source(std::size_t from, std::size_t to, waveform current) {
+		if (from >= net.get_node_count() || to >= net.get_node_count()) {
+			throw std::out_of_range("Error: Node does not exist in the netlist.");
+		}
+		sources.push_back({ from, to, std::move(current), none });
+	}
+	// Voltage in series with resistive branch 'branch', positive towards the branch's
+	// 'from' node. netlist::add_voltage_source adds such a branch.
+	void add_voltage_source(std::size_t branch, waveform voltage) {
+		if (branch >= net.get_branches().size()) {
+			throw std::out_of_range("Error: Branch does not exist in the netlist.");
+		}
+		const netlist::branch& b = net.get_branches()[branch];
+		sources.push_back({ b.to, b.from, std::move(voltage), branch });
+	}
+	// Simulate from 0 to 'stop'. output(t, v) receives the node voltages, ground
+	// included, after every accepted step.
+	transient_statistics run(double stop, const transient_options& options,
+		const std::function<void(double, const std::vector<double>&)>& output) {
+		if (!(stop > 0)) {
+			throw std::invalid_argument("Error: Transient stop time must be positive.");
+		}
+		load_components();
+		const double min_step = options.min_step > 0 ? options.min_step : stop * 1e-12;
+		const double max_step = options.max_step > 0 ? options.max_step : stop / 50;
+		const double first_step = options.step > 0 ? options.step : (options.adaptive ? stop * 1e-6 : stop / 1000);
+		for (std::vector<double>& x : history) {
+			x.assign(np.pattern.n, 0.0);
+		}
+		history_count = 0;
+		voltages.assign(net.get_node_count(), 0.0);
+		transient_statistics stats;
+		double factored_step = 0.0;
+		integration_method factored_method = options.method;
+		double t = 0.0;
+		double h = std::min(first_step, max_step);
+		// One backward Euler step after every corner damps the ringing the trapezoidal rule would show
+		bool restart = true;
+		while (t < stop) {
+			double target = stop;
+			for (const driven_source& s : sources) {
+				target = std::min(target, s.value.next_corner(t));
+			}
+			bool reached = false;
+			if (target - t <= h + min_step) {
+				h = target - t;
+				reached = true;
+			}
+			const integration_method method = restart ? integration_method::backward_euler : options.method;
+			if (stats.factorizations == 0 || h != factored_step || method != factored_method) {
+				factor(h, method);
+				factored_step = h;
+				factored_method = method;
+				++stats.factorizations;
+			}
+			const double next = reached ? target : t + h;
+			build_rhs(next, method);
+			solve_lu_refined(np.pattern, values, symbolic, factors, rhs);
+			int order = 1;
+			const double ratio = options.adaptive ? error_ratio(next, method, options, order) : 0.0;
+			if (ratio > 1.0 && h > min_step) {
+				h = std::max(min_step, h * std::max(0.25, 0.9 * std::pow(ratio, -1.0 / (order + 1))));
+				++stats.rejected_steps;
+				continue;
+			}
+			// Accept: advance the companion state and report
+			const std::vector<netlist::branch>& branches = net.get_branches();
+			std::copy(rhs.begin(), rhs.end(), voltages.begin() + 1);
+			for (std::size_t k = 0; k < states.size(); ++k) {
+				branch_state& s = states[k];
+				s.voltage = voltages[branches[k].from] - voltages[branches[k].to];
+				s.current = s.conductance * s.voltage + s.source;
+			}
+			t = next;
+			++stats.accepted_steps;
+			if (output) {
+				output(t, voltages);
+			}
+			std::rotate(history.begin(), history.end() - 1, history.end());
+			history[0].swap(rhs);
+			rhs.resize(np.pattern.n);
+			history_times[2] = history_times[1];
+			history_times[1] = history_times[0];
+			history_times[0] = t;
+			history_count = std::min<std::size_t>(history_count + 1, 3);
+			restart = false;
+			if (reached && target < stop) {
+				// Extrapolating across a corner says nothing about the error
+				history_count = 1;
+				restart = true;
+				h = std::min(first_step, max_step);
+			}
+			else if (!options.adaptive) {
+				h = first_step;
+			}
+			else if (ratio > 0.0) {
+				// Keep the step, and with it the factorization, unless it can grow well
+				const double growth = 0.9 * std::pow(ratio, -1.0 / (order + 1));
+				if (growth >= 1.5) {
+					h *= std::min(growth, 2.0);
+				}
+				else if (growth < 1.0) {
+					h *= std::max(growth, 0.25);
+				}
+			}
+			else {
+				h *= 2.0;
+			}
+			h = std::min(std::max(h, min_step), max_step);
+		}
+		return stats;
+	}
+};
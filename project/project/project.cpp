@@ -5,246 +5,226 @@
 // The program prompts the user to choose a circuit type and enter values for 
 // the components. The total impedance and phase difference is calculated as well
 // as the individual component impedances and phase shifts.
+// Run with --batch <file> (or - for stdin) to evaluate many circuits without prompts,
+// or with --serve to answer JSON requests on stdin until it closes.
+// The simulation engine itself is the acs library (include/acs, src).
 
+#include "acs/acs.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
 #include <iostream>
-#include <vector>
-#include <complex>
-#include <cmath>
-#include <iomanip>
-#include <string>
-#include <memory>
 #include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// Parse a whole command line argument as a number
+template <typename T>
+bool parse_argument(const char* text, T& value) {
+	const char* end = text + std::strlen(text);
+	const std::from_chars_result r = std::from_chars(text, end, value);
+	return r.ec == std::errc() && r.ptr == end;
+}
 
-const double pi = 3.14159265358979323846;
-
-// Abstract base class for components in circuit
-class components
-{
-protected:
-	double frequency;
-	std::complex<double> impedance;
-public:
-	components() : frequency(0) {}
-	virtual ~components() {}
-	virtual std::string get_type() const = 0;
-	virtual void set_frequency(double f) = 0;
-	virtual double get_frequency() const = 0;
-	virtual std::complex<double> get_impedance() const = 0;
-	virtual double get_impedance_magnitude() const = 0;
-	virtual double get_phase_difference() const = 0;
-};
-
-// Derived class for resistor
-class resistor : public components
-{
-private: 
-	double resistance;
-public:
-	resistor(double r) : resistance(r) {impedance = resistance;}
-	~resistor() {}
-	void set_frequency(double f) override {
-		frequency = f;
-	}
-	double get_frequency() const override {
-		return frequency;
-	}
-	std::complex<double> get_impedance() const override {
-		return { impedance };
-	}
-	double get_impedance_magnitude() const override {
-		return std::abs(impedance);
-	}
-	double get_phase_difference() const override {
-		return std::arg(impedance);
-	}
-	std::string get_type() const override {
-		return "Resistor";
-	}
-};
-
-// Derived class for capacitor
-class capacitor : public components
-{
-private:
-	double capacitance;
-public:
-	capacitor(double c) : capacitance(c) { impedance = std::complex<double>(0, -1.0 / (2.0 * pi * frequency * capacitance)); }
-	~capacitor() {}
-	void set_frequency(double f) override {
-		frequency = f;
-		impedance = std::complex<double>(0, -1.0 / (2 * pi * frequency * capacitance));
-	}
-	double get_frequency() const override {
-		return frequency;
-	}
-	std::complex<double> get_impedance() const override {
-		return impedance;
-	}
-	double get_impedance_magnitude() const override {
-		return std::abs(impedance);
-	}
-	double get_phase_difference() const override {
-		return -pi/2;
-	}
-	std::string get_type() const override {
-		return "Capacitor";
-	}
-};
-
-// Derived class for inductor
-class inductor : public components
-{
-private:
-	double inductance;
-public:
-	inductor(double l) : inductance(l) { impedance = std::complex<double>(0, 2 * pi * inductance); }
-	~inductor() {}
-	void set_frequency(double f) override {
-		frequency = f;
-		impedance = std::complex<double>(0, 2 * pi * frequency * inductance);
-	}
-	double get_frequency() const override {
-		return frequency;
-	}
-	std::complex<double> get_impedance() const override {
-		return impedance;
-	}
-	double get_impedance_magnitude() const override {
-		return std::abs(impedance);
-	}
-	double get_phase_difference() const override {
-		return pi/2;
-	}
-	std::string get_type() const override {
-		return "Inductor";
-	}
-};
-
-// Derived class for diode
-class diode : public components
-{
-private:
-	double capacitance;
-	double resistance;
-	double saturation_current;
-public:
-	diode(double c, double r, double is) : capacitance(c), resistance(r), saturation_current(is)
-	{
-		impedance = std::complex<double>(0, resistance);
-	}
-	~diode() {}
-	void set_frequency(double f) override {
-		frequency = f;
-		// Calculate impedance of diode based on frequency
-		double omega_c = 1.0 / (resistance * capacitance);
-		double omega_s = (saturation_current * resistance) / capacitance;
-		double j = std::sqrt(-1);
-		double denom = 1.0 + (j * 2*pi*f * capacitance * resistance);
-		impedance = std::complex<double>(resistance / denom, omega_s / (j * 2*pi*f * capacitance * denom));
-	}
-	double get_frequency() const override {
-		return frequency;
-	}
-	std::complex<double> get_impedance() const override {
-		return impedance;
-	}
-	double get_impedance_magnitude() const override {
-		return std::abs(impedance);
-	}
-	double get_phase_difference() const override {
-		return std::arg(impedance);
-	}
-	std::string get_type() const override {
-		return "Diode";
+// Stop any instrumentation and write out what was asked for; returns nonzero if
+// the trace could not be written
+inline int finish_instrumentation(bool profile, const std::string& trace_file) {
+	if (instrumentation::is_enabled()) {
+		instrumentation::disable();
+		if (profile) {
+			instrumentation::write_summary(std::clog);
+		}
+		if (!trace_file.empty()) {
+			std::ofstream trace(trace_file);
+			instrumentation::write_trace(trace);
+			if (!trace) {
+				std::cerr << "Error: Cannot write " << trace_file << std::endl;
+				return 1;
+			}
+		}
 	}
-};
+	return 0;
+}
 
-// Derived class for transistor
-class transistor : public components
-{
-private:
-	double collector_current;
-	double base_current;
-	double emitter_current;
-	double collector_emitter_voltage;
-	double base_emitter_voltage;
-public:
-	transistor(double cc, double bc, double ec, double cev, double bev) :
-		collector_current(cc), base_current(bc), emitter_current(ec),
-		collector_emitter_voltage(cev), base_emitter_voltage(bev) {
-		// Calculate transistor impedance at frequency = 0
-		impedance = std::complex<double>(collector_emitter_voltage / collector_current, 0.0);
-	}
-	~transistor() {}
-	void set_frequency(double f) override {
-		// Transistor impedance does not depend on frequency
+// Command line options; with none the program runs interactively
+inline int run_command_line(int argc, char* argv[]) {
+	std::string input;
+	std::string format = "csv";
+	bool show_components = false;
+	bool show_diagram = false;
+	bool valid = true;
+	monte_carlo_options monte_carlo_settings;
+	monte_carlo_settings.samples = 0;
+	double relative_tolerance = 0.05;
+	unsigned threads = std::thread::hardware_concurrency();
+	double limit = 0.0;
+	adaptive_options adaptive_settings;
+	double sweep_start = 0.0;
+	double sweep_stop = 0.0;
+	std::size_t sweep_points = 0;
+	bool adaptive = false;
+	bool profile = false;
+	std::string trace_file;
+	bool serve = false;
+	server_options server_settings;
+	for (int i = 1; i < argc; ++i) {
+		const std::string option = argv[i];
+		if (option == "--batch" && i + 1 < argc) {
+			input = argv[++i];
+		}
+		else if (option == "--monte-carlo" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], monte_carlo_settings.samples) && monte_carlo_settings.samples > 0 && valid;
+		}
+		else if (option == "--tolerance" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], relative_tolerance) && relative_tolerance >= 0 && valid;
+		}
+		else if (option == "--seed" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], monte_carlo_settings.seed) && valid;
+		}
+		else if (option == "--threads" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], threads) && threads > 0 && valid;
+		}
+		else if (option == "--min" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], limit) && valid;
+			monte_carlo_settings.min_magnitude.assign(1, limit);
+		}
+		else if (option == "--max" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], limit) && valid;
+			monte_carlo_settings.max_magnitude.assign(1, limit);
+		}
+		else if (option == "--adaptive" && i + 2 < argc) {
+			valid = parse_argument(argv[i + 1], sweep_start) && parse_argument(argv[i + 2], sweep_stop) &&
+				sweep_start > 0 && sweep_stop > sweep_start && valid;
+			i += 2;
+			adaptive = true;
+		}
+		else if (option == "--sweep" && i + 3 < argc) {
+			valid = parse_argument(argv[i + 1], sweep_start) && parse_argument(argv[i + 2], sweep_stop) &&
+				parse_argument(argv[i + 3], sweep_points) && sweep_start > 0 && sweep_stop >= sweep_start && sweep_points > 0 && valid;
+			i += 3;
+		}
+		else if (option == "--sweep-tolerance" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], adaptive_settings.magnitude_tolerance_db) &&
+				adaptive_settings.magnitude_tolerance_db > 0 && valid;
+		}
+		else if (option == "--format" && i + 1 < argc) {
+			format = argv[++i];
+		}
+		else if (option == "--serve") {
+			serve = true;
+		}
+		else if (option == "--max-batch" && i + 1 < argc) {
+			valid = parse_argument(argv[++i], server_settings.max_batch) && server_settings.max_batch > 0 && valid;
+		}
+		else if (option == "--cache-dir" && i + 1 < argc) {
+			server_settings.cache_directory = argv[++i];
+		}
+		else if (option == "--profile") {
+			profile = true;
+		}
+		else if (option == "--trace" && i + 1 < argc) {
+			trace_file = argv[++i];
+		}
+		else if (option == "--components") {
+			show_components = true;
+		}
+		else if (option == "--diagram") {
+			show_diagram = true;
+		}
+		else {
+			valid = false;
+		}
 	}
-	double get_frequency() const override {
-		return 0.0;
+	const int modes = (monte_carlo_settings.samples > 0) + adaptive + (sweep_points > 0);
+	if (!valid || input.empty() == !serve || modes > (serve ? 0 : 1)) {
+		std::cerr << "Usage: " << argv[0] << " --batch <file>|- [--format csv|jsonl|binary|text] [--components] [--diagram]\n"
+			<< "       " << argv[0] << " --batch <file>|- --monte-carlo <samples> [--tolerance <fraction>] [--seed <n>]"
+			<< " [--threads <n>] [--min <ohms>] [--max <ohms>] [--format csv|jsonl]\n"
+			<< "       " << argv[0] << " --batch <file>|- --adaptive <start Hz> <stop Hz> [--sweep-tolerance <dB>] [--format ...]\n"
+			<< "       " << argv[0] << " --batch <file>|- --sweep <start Hz> <stop Hz> <points> [--format ...]\n"
+			<< "       " << argv[0] << " --serve [--threads <n>] [--max-batch <requests>] [--cache-dir <directory>]\n"
+			<< "Any of these can add --profile for a timing summary on stderr and --trace <file> for a Chrome trace" << std::endl;
+		return 2;
+	}
+	std::ios::sync_with_stdio(false);
+	if (profile || !trace_file.empty()) {
+		if (!instrumentation::is_built_in()) {
+			std::cerr << "Error: This build has no instrumentation; configure with ACS_INSTRUMENTATION=ON" << std::endl;
+			return 2;
+		}
+		instrumentation::enable(!trace_file.empty());
+	}
+	if (serve) {
+		server_settings.threads = threads;
+		simulation_server server(server_settings);
+		server.run(std::cin, std::cout);
+		server.write_summary(std::clog);
+		return finish_instrumentation(profile, trace_file);
+	}
+	std::unique_ptr<output_sink> sink;
+	if (format == "csv") {
+		sink = std::make_unique<csv_sink>(std::cout);
+	}
+	else if (format == "jsonl") {
+		sink = std::make_unique<jsonl_sink>(std::cout);
+	}
+	else if (format == "binary") {
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		sink = std::make_unique<binary_sink>(std::cout);
+	}
+	else if (format == "text") {
+		sink = std::make_unique<text_sink>(std::cout, show_components, show_diagram);
+	}
+	else {
+		std::cerr << "Error: Unknown output format " << format << std::endl;
+		return 2;
+	}
+	if (monte_carlo_settings.samples > 0 && !sink->has_statistics()) {
+		std::cerr << "Error: Monte Carlo results can only be written as csv or jsonl" << std::endl;
+		return 2;
+	}
+	std::ifstream file;
+	if (input != "-") {
+		file.open(input, std::ios::binary);
+		if (!file) {
+			std::cerr << "Error: Cannot open " << input << std::endl;
+			return 1;
+		}
 	}
-	std::complex<double> get_impedance() const override {
-		return impedance;
+	std::istream& in = input == "-" ? std::cin : file;
+	std::size_t errors = 0;
+	if (monte_carlo_settings.samples > 0) {
+		thread_pool pool(threads);
+		errors = run_monte_carlo_batch(in, *sink, monte_carlo_settings, relative_tolerance, pool);
 	}
-	double get_impedance_magnitude() const override {
-		return std::abs(impedance);
+	else if (sweep_points > 0) {
+		errors = run_sweep_batch(in, *sink, frequency_grid(sweep_start, sweep_stop, sweep_points));
 	}
-	double get_phase_difference() const override {
-		return 0.0;
+	else if (adaptive) {
+		errors = run_adaptive_batch(in, *sink, sweep_start, sweep_stop, adaptive_settings);
 	}
-	std::string get_type() const override {
-		return "Transistor";
+	else {
+		errors = run_batch(in, *sink);
 	}
-};
+	const int status = finish_instrumentation(profile, trace_file);
+	return status != 0 ? status : errors == 0 ? 0 : 1;
+}
 
-// Generic circuit class which stores total impedance and phase difference of the whole circuit
-class circuit 
+int main(int argc, char* argv[])
 {
-private:
-	std::vector<components*> component_list; 
-	std::complex<double> total_impedance; 
-	double frequency;
-public:
-	circuit() : total_impedance(0.0), frequency(0.0) {}
-	~circuit() {}
-	void add_component_in_series(components* component) {
-		component_list.push_back(component);
-		update_impedance_series();
-	}
-	void add_component_in_parallel(components* component) {
-		component_list.push_back(component);
-		update_impedance_parallel();
-	}
-	void set_frequency(double f) { 
-		frequency = f;
-		update_impedance_series(); // Recalculate total impedance for components in series
-		update_impedance_parallel(); // Recalculate total impedance for components in parallel
-	}
-	void update_impedance_series() {
-		total_impedance = 0;
-		for (const auto& component : component_list) {
-			total_impedance += component->get_impedance();
-		}
-	}
-	void update_impedance_parallel() {
-		total_impedance = 0;
-		for (const auto& component : component_list) {
-			total_impedance += 1.0 / component->get_impedance();
-		}
-		total_impedance = 1.0 / total_impedance;
-	}
-	std::complex<double> get_circuit_impedance() const {
-		return total_impedance;
-	}
-	double get_total_impedance_magntiude() const {
-		return std::abs(total_impedance);
-	}
-	double get_phase_difference() const {
-		return std::arg(total_impedance);
+	if (argc > 1) {
+		return run_command_line(argc, argv);
 	}
-};
 
-int main()
-{
 	std::vector<std::unique_ptr<components>> component_library;
 
 	int circuit_type;
@@ -252,21 +232,21 @@ int main()
 	double r_value, c_value, l_value;
 
 	try {
-		std::cout << "Choose circuit type: " << std::endl;
-		std::cout << "1. Parallel RLC circuit" << std::endl;
-		std::cout << "2. Series RLC circuit" << std::endl;
-		std::cout << "3. RL in Series" << std::endl;
-		std::cout << "4. RL in Parallel" << std::endl;
-		std::cout << "5. RC in Series" << std::endl;
-		std::cout << "6. RC in Parallel" << std::endl;
-		std::cout << "7. LC in Series" << std::endl;
-		std::cout << "8. LC in Parallel" << std::endl;
+		std::cout << "Choose circuit type: \n";
+		std::cout << "1. Parallel RLC circuit\n";
+		std::cout << "2. Series RLC circuit\n";
+		std::cout << "3. RL in Series\n";
+		std::cout << "4. RL in Parallel\n";
+		std::cout << "5. RC in Series\n";
+		std::cout << "6. RC in Parallel\n";
+		std::cout << "7. LC in Series\n";
+		std::cout << "8. LC in Parallel\n";
 		
 		// Validate input for circuit type
 		while (!(std::cin >> circuit_type) || circuit_type < 1 || circuit_type > 8 || std::cin.peek() != '\n') {
 			std::cin.clear();  // Clear error flags
 			std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');  // Discard invalid input
-			std::cout << "Error: Invalid circuit type. Please enter an integer between 1 and 8." << std::endl;
+			std::cout << "Error: Invalid circuit type. Please enter an integer between 1 and 8.\n";
 		}
  
 		std::cout << "Frequency (Hz): ";
@@ -274,7 +254,7 @@ int main()
 		while (!(std::cin >> freq) || freq == 0 || freq < 0 || std::cin.peek() != '\n') {
 			std::cin.clear();
 			std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-			std::cout << "Error: Invalid frequency. Please enter a valid number." << std::endl;
+			std::cout << "Error: Invalid frequency. Please enter a valid number.\n";
 		}
 
 		if (circuit_type == 1) {
@@ -285,7 +265,7 @@ int main()
 			while (!(std::cin >> r_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid resistance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid resistance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter capacitance value (Farads): ";
@@ -293,7 +273,7 @@ int main()
 			while (!(std::cin >> c_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid capacitance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid capacitance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter inductance value (Henry): ";
@@ -301,44 +281,32 @@ int main()
 			while (!(std::cin >> l_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid inductance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid inductance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
-
-			resistor r(r_value);
-			capacitor c(c_value);
-			inductor l(l_value);
+			std::cout << '\n';
 
-			example_circuit.add_component_in_parallel(&r);
-			example_circuit.add_component_in_parallel(&c);
-			example_circuit.add_component_in_parallel(&l);
+			component_library.push_back(std::make_unique<resistor>(r_value));
+			component_library.push_back(std::make_unique<capacitor>(c_value));
+			component_library.push_back(std::make_unique<inductor>(l_value));
 
-			r.set_frequency(freq);
-			c.set_frequency(freq);
-			l.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit.add_component_in_parallel(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<resistor>(r));
-			component_library.push_back(std::make_unique<capacitor>(c));
-			component_library.push_back(std::make_unique<inductor>(l));
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
-
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
-			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----R-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----C-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----L-----+" << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
+			}
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 		else if (circuit_type == 2) {
 			circuit example_circuit2;
@@ -347,58 +315,46 @@ int main()
 			while (!(std::cin >> r_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid resistance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid resistance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter capacitance value (Farads): ";
 			while (!(std::cin >> c_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid capacitance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid capacitance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter inductance value (Henry): ";
 			while (!(std::cin >> l_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid inductance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid inductance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
+			std::cout << '\n';
 
-			resistor r(r_value);
-			capacitor c(c_value);
-			inductor l(l_value);
+			component_library.push_back(std::make_unique<resistor>(r_value));
+			component_library.push_back(std::make_unique<capacitor>(c_value));
+			component_library.push_back(std::make_unique<inductor>(l_value));
 
-			example_circuit2.add_component_in_series(&r);
-			example_circuit2.add_component_in_series(&c);
-			example_circuit2.add_component_in_series(&l);
-
-			r.set_frequency(freq);
-			c.set_frequency(freq);
-			l.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit2.add_component_in_series(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit2.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<resistor>(r));
-			component_library.push_back(std::make_unique<capacitor>(c));;
-			component_library.push_back(std::make_unique<inductor>(l));
-
-			example_circuit2.update_impedance_series();
-
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit2.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit2.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit2.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit2.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
 			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----R-----C-----L-----+" << std::endl;
-			std::cout << "|                       |" << std::endl;
-			std::cout << "+-----------------------+" << std::endl;
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 		else if (circuit_type == 3) {
 			circuit example_circuit3;
@@ -407,47 +363,38 @@ int main()
 			while (!(std::cin >> r_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid resistance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid resistance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter inductance value (Henry): ";
 			while (!(std::cin >> l_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid inductance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid inductance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
+			std::cout << '\n';
 
-			resistor r(r_value);
-			inductor l(l_value);
+			component_library.push_back(std::make_unique<resistor>(r_value));
+			component_library.push_back(std::make_unique<inductor>(l_value));
 
-			example_circuit3.add_component_in_series(&r);
-			example_circuit3.add_component_in_series(&l);
-
-			r.set_frequency(freq);
-			l.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit3.add_component_in_series(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit3.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<resistor>(r));
-			component_library.push_back(std::make_unique<inductor>(l));
-
-			example_circuit3.update_impedance_series();
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit3.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit3.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit3.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit3.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
-
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
 			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----R-----L-----+" << std::endl;
-			std::cout << "|                 |" << std::endl;
-			std::cout << "+-----------------+" << std::endl;
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 		else if (circuit_type == 4) {
 			circuit example_circuit4;
@@ -456,47 +403,38 @@ int main()
 			while (!(std::cin >> r_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid resistance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid resistance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter inductance value (Henry): ";
 			while (!(std::cin >> l_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid inductance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid inductance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
-
-			resistor r(r_value);
-			inductor l(l_value);
+			std::cout << '\n';
 
-			example_circuit4.add_component_in_parallel(&r);
-			example_circuit4.add_component_in_parallel(&l);
+			component_library.push_back(std::make_unique<resistor>(r_value));
+			component_library.push_back(std::make_unique<inductor>(l_value));
 
-			r.set_frequency(freq);
-			l.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit4.add_component_in_parallel(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit4.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<resistor>(r));
-			component_library.push_back(std::make_unique<inductor>(l));
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit4.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit4.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit4.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit4.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
-
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
-			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----R-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----L-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----------+" << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
+			}
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 		else if (circuit_type == 5) {
 			circuit example_circuit5;
@@ -505,47 +443,38 @@ int main()
 			while (!(std::cin >> r_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid resistance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid resistance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter capacitance value (Farads): ";
 			while (!(std::cin >> c_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid capacitance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid capacitance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
+			std::cout << '\n';
 
-			resistor r(r_value);
-			capacitor c(c_value);
+			component_library.push_back(std::make_unique<resistor>(r_value));
+			component_library.push_back(std::make_unique<capacitor>(c_value));
 
-			example_circuit5.add_component_in_series(&r);
-			example_circuit5.add_component_in_series(&c);
-
-			r.set_frequency(freq);
-			c.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit5.add_component_in_series(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit5.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<resistor>(r));
-			component_library.push_back(std::make_unique<capacitor>(c));
-
-			example_circuit5.update_impedance_series();
-
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit5.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit5.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit5.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit5.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
 			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----R-----C-----+" << std::endl;
-			std::cout << "|                 |" << std::endl;
-			std::cout << "+-----------------+" << std::endl;
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 		else if (circuit_type == 6) {
 			circuit example_circuit6;
@@ -554,47 +483,38 @@ int main()
 			while (!(std::cin >> r_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid resistance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid resistance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter capacitance value (Farads): ";
 			while (!(std::cin >> c_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid capacitance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid capacitance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
+			std::cout << '\n';
 
-			resistor r(r_value);
-			capacitor c(c_value);
+			component_library.push_back(std::make_unique<resistor>(r_value));
+			component_library.push_back(std::make_unique<capacitor>(c_value));
 
-			example_circuit6.add_component_in_parallel(&r);
-			example_circuit6.add_component_in_parallel(&c);
-
-			r.set_frequency(freq);
-			c.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit6.add_component_in_parallel(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit6.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<resistor>(r));
-			component_library.push_back(std::make_unique<capacitor>(c));
-
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit6.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit6.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit6.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit6.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
-			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----R-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----C-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----------+" << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
+			}
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 		else if (circuit_type == 7) {
 			circuit example_circuit7;
@@ -603,47 +523,38 @@ int main()
 			while (!(std::cin >> c_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid capacitance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid capacitance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter inductance value (Henry): ";
 			while (!(std::cin >> l_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid inductance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid inductance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
-
-			capacitor c(c_value);
-			inductor l(l_value);
+			std::cout << '\n';
 
-			example_circuit7.add_component_in_series(&l);
-			example_circuit7.add_component_in_series(&c);
+			component_library.push_back(std::make_unique<inductor>(l_value));
+			component_library.push_back(std::make_unique<capacitor>(c_value));
 
-			l.set_frequency(freq);
-			c.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit7.add_component_in_series(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit7.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<inductor>(l));
-			component_library.push_back(std::make_unique<capacitor>(c));
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit7.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit7.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			example_circuit7.update_impedance_series();
-
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit7.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit7.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
-
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
 			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----L-----C-----+" << std::endl;
-			std::cout << "|                 |" << std::endl;
-			std::cout << "+-----------------+" << std::endl;
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 		else if (circuit_type == 8) {
 			circuit example_circuit8;
@@ -652,47 +563,38 @@ int main()
 			while (!(std::cin >> c_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid capacitance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid capacitance value. Please enter a valid number.\n";
 			}
 
 			std::cout << "Enter inductance value (Henry): ";
 			while (!(std::cin >> l_value) || std::cin.peek() != '\n') {
 				std::cin.clear();
 				std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-				std::cout << "Error: Invalid inductance value. Please enter a valid number." << std::endl;
+				std::cout << "Error: Invalid inductance value. Please enter a valid number.\n";
 			}
-			std::cout << std::endl;
+			std::cout << '\n';
 
-			capacitor c(c_value);
-			inductor l(l_value);
+			component_library.push_back(std::make_unique<inductor>(l_value));
+			component_library.push_back(std::make_unique<capacitor>(c_value));
 
-			example_circuit8.add_component_in_parallel(&l);
-			example_circuit8.add_component_in_parallel(&c);
-
-			l.set_frequency(freq);
-			c.set_frequency(freq);
+			for (auto& component : component_library) {
+				example_circuit8.add_component_in_parallel(component.get());
+				component->set_frequency(freq);
+			}
 			example_circuit8.set_frequency(freq);
 
-			component_library.push_back(std::make_unique<inductor>(l));
-			component_library.push_back(std::make_unique<capacitor>(c));
-
-			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit8.get_total_impedance_magntiude() << " Ohms" << std::endl;
-			std::cout << "Total Phase Difference: " << example_circuit8.get_phase_difference() << " rad" << std::endl;
-			std::cout << std::endl;
+			std::cout << "Total Impedance Magnitude at " << freq << "Hz: " << example_circuit8.get_total_impedance_magntiude() << " Ohms\n";
+			std::cout << "Total Phase Difference: " << example_circuit8.get_phase_difference() << " rad\n";
+			std::cout << '\n';
 
-			std::cout << "Component Impedances and Phase Shifts:" << std::endl;
+			std::cout << "Component Impedances and Phase Shifts:\n";
 			for (auto& component : component_library) {
-				std::cout << "Type: " << component->get_type() << std::endl;
-				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms" << std::endl;
-				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad" << std::endl;
-				std::cout << std::endl;
-			}
-			std::cout << "Circuit Diagram: " << std::endl;
-			std::cout << "+-----L-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----C-----+" << std::endl;
-			std::cout << "|           |" << std::endl;
-			std::cout << "+-----------+" << std::endl;
+				std::cout << "Type: " << component->get_type() << '\n';
+				std::cout << "Impedance Magnitude: " << component->get_impedance_magnitude() << " Ohms\n";
+				std::cout << "Phase Shift: " << component->get_phase_difference() << " rad\n";
+				std::cout << '\n';
+			}
+			std::cout << "Circuit Diagram: \n" << menu_circuit_diagram(circuit_type);
 		}
 	}
 	catch (const std::exception& ex) {
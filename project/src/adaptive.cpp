@@ -0,0 +1,23 @@
+﻿#include "acs/adaptive.h"
+
+adaptive_result adaptive_sweep(const circuit& c, double f_start, double f_stop, const adaptive_options& options) {
+	std::vector<double> magnitude;
+	std::vector<double> phase;
+	return adaptive_sweep(f_start, f_stop, options, [&](const double* f, std::size_t n, std::complex<double>* z) {
+		magnitude.resize(n);
+		phase.resize(n);
+		c.sweep(f, n, magnitude.data(), phase.data());
+		for (std::size_t i = 0; i < n; ++i) {
+			z[i] = std::polar(magnitude[i], phase[i]);
+		}
+	});
+}
+
+adaptive_result adaptive_sweep_port(prepared_netlist& prepared, std::size_t plus, std::size_t minus,
+	double f_start, double f_stop, const adaptive_options& options) {
+	return adaptive_sweep(f_start, f_stop, options, [&](const double* f, std::size_t n, std::complex<double>* z) {
+		for (std::size_t i = 0; i < n; ++i) {
+			z[i] = prepared.port_impedance(plus, minus, f[i]);
+		}
+	});
+}
@@ -0,0 +1,301 @@
+﻿#include "acs/batch.h"
+
+#include <cmath>
+#include <iostream>
+
+circuit* build_menu_circuit(int type, const double* values, arena& pool) {
+	ACS_TIMED(build);
+	if (type < 1 || type > 8) {
+		throw std::invalid_argument("Error: Invalid circuit type.");
+	}
+	const bool series = type == 2 || type == 3 || type == 5 || type == 7;
+	circuit* c = pool.create<circuit>(series ? connection::series : connection::parallel, pool.get_resource());
+	components* parts[3];
+	int count = 0;
+	switch (type) {
+	case 1:
+	case 2:
+		parts[count++] = pool.create<resistor>(values[0]);
+		parts[count++] = pool.create<capacitor>(values[1]);
+		parts[count++] = pool.create<inductor>(values[2]);
+		break;
+	case 3:
+	case 4:
+		parts[count++] = pool.create<resistor>(values[0]);
+		parts[count++] = pool.create<inductor>(values[1]);
+		break;
+	case 5:
+	case 6:
+		parts[count++] = pool.create<resistor>(values[0]);
+		parts[count++] = pool.create<capacitor>(values[1]);
+		break;
+	default:
+		parts[count++] = pool.create<inductor>(values[1]);
+		parts[count++] = pool.create<capacitor>(values[0]);
+		break;
+	}
+	for (int i = 0; i < count; ++i) {
+		if (series) {
+			c->add_component_in_series(parts[i]);
+		}
+		else {
+			c->add_component_in_parallel(parts[i]);
+		}
+	}
+	return c;
+}
+
+std::complex<double> menu_circuit_impedance(int type, const double* values, double f) {
+	const double omega = 2 * pi * f;
+	switch (type) {
+	case 1:
+		return parallel_rlc::impedance_of(omega, values);
+	case 2:
+		return series_rlc::impedance_of(omega, values);
+	case 3:
+		return series_rl::impedance_of(omega, values);
+	case 4:
+		return parallel_rl::impedance_of(omega, values);
+	case 5:
+		return series_rc::impedance_of(omega, values);
+	case 6:
+		return parallel_rc::impedance_of(omega, values);
+	case 7:
+		return series_lc::impedance_of(omega, values);
+	case 8:
+		return parallel_lc::impedance_of(omega, values);
+	default:
+		throw std::invalid_argument("Error: Invalid circuit type.");
+	}
+}
+
+const char* skip_blanks(const char* p, const char* last) {
+	while (p != last && (*p == ' ' || *p == '\t' || *p == '\r' || *p == ',')) {
+		++p;
+	}
+	return p;
+}
+
+bool parse_record(const char* p, const char* last, circuit_record& record) {
+	ACS_TIMED(parse);
+	p = skip_blanks(p, last);
+	if (p == last || *p == '#') {
+		return false;
+	}
+	std::from_chars_result r = std::from_chars(p, last, record.type);
+	if (r.ec != std::errc() || record.type < 1 || record.type > 8) {
+		throw std::invalid_argument("Error: Invalid circuit type. Please enter an integer between 1 and 8.");
+	}
+	p = skip_blanks(r.ptr, last);
+	r = std::from_chars(p, last, record.frequency);
+	if (r.ec != std::errc() || !(record.frequency > 0)) {
+		throw std::invalid_argument("Error: Invalid frequency. Please enter a valid number.");
+	}
+	for (int i = 0; i < menu_value_counts[record.type]; ++i) {
+		p = skip_blanks(r.ptr, last);
+		r = std::from_chars(p, last, record.values[i]);
+		if (r.ec != std::errc()) {
+			throw std::invalid_argument("Error: Invalid component value. Please enter a valid number.");
+		}
+	}
+	if (skip_blanks(r.ptr, last) != last) {
+		throw std::invalid_argument("Error: Too many values for this circuit type.");
+	}
+	ACS_COUNT(records, 1);
+	return true;
+}
+
+const char* menu_circuit_diagram(int type) {
+	static const char* const diagrams[9] = {
+		"",
+		"+-----R-----+\n|           |\n+-----C-----+\n|           |\n+-----L-----+\n",
+		"+-----R-----C-----L-----+\n|                       |\n+-----------------------+\n",
+		"+-----R-----L-----+\n|                 |\n+-----------------+\n",
+		"+-----R-----+\n|           |\n+-----L-----+\n|           |\n+-----------+\n",
+		"+-----R-----C-----+\n|                 |\n+-----------------+\n",
+		"+-----R-----+\n|           |\n+-----C-----+\n|           |\n+-----------+\n",
+		"+-----L-----C-----+\n|                 |\n+-----------------+\n",
+		"+-----L-----+\n|           |\n+-----C-----+\n|           |\n+-----------+\n",
+	};
+	return type >= 1 && type <= 8 ? diagrams[type] : "";
+}
+
+std::size_t run_batch(std::istream& in, output_sink& sink) {
+	const std::size_t batch_size = 1024;
+	line_reader reader(in);
+	arena pool(1 << 20);
+	std::vector<result_record> batch;
+	batch.reserve(batch_size);
+	std::size_t errors = 0;
+	const char* first;
+	const char* last;
+	bool more = true;
+	sink.begin();
+	while (more) {
+		batch.clear();
+		while (batch.size() < batch_size && (more = reader.next(first, last))) {
+			try {
+				result_record result;
+				if (!parse_record(first, last, result.input)) {
+					continue;
+				}
+				circuit* c = build_menu_circuit(result.input.type, result.input.values, pool);
+				{
+					ACS_TIMED(update);
+					c->set_frequency(result.input.frequency);
+				}
+				std::complex<double> z;
+				{
+					ACS_TIMED(evaluate);
+					ACS_COUNT(evaluations, 1);
+					z = c->get_circuit_impedance();
+				}
+				result.magnitude = std::abs(z);
+				result.phase = std::arg(z);
+				batch.push_back(result);
+			}
+			catch (const std::invalid_argument& ex) {
+				std::cerr << "Line " << reader.get_line_number() << ": " << ex.what() << '\n';
+				++errors;
+			}
+		}
+		{
+			ACS_TIMED(output);
+			for (const result_record& result : batch) {
+				sink.write(result);
+			}
+		}
+		pool.release();
+	}
+	sink.flush();
+	return errors;
+}
+
+std::size_t run_monte_carlo_batch(std::istream& in, output_sink& sink, const monte_carlo_options& options,
+	double relative, thread_pool& pool) {
+	line_reader reader(in);
+	circuit_record record;
+	std::vector<tolerance> parameters;
+	std::size_t errors = 0;
+	const char* first;
+	const char* last;
+	sink.begin_statistics();
+	while (reader.next(first, last)) {
+		try {
+			if (!parse_record(first, last, record)) {
+				continue;
+			}
+			parameters.clear();
+			for (int i = 0; i < menu_value_counts[record.type]; ++i) {
+				parameters.push_back({ record.values[i], relative });
+			}
+			const int type = record.type;
+			monte_carlo_result result;
+			{
+				ACS_TIMED(evaluate);
+				result = monte_carlo(parameters, { record.frequency }, options, pool,
+					[type](const double* values, const double* f, std::size_t n, double* magnitude, double* phase) {
+						ACS_COUNT(evaluations, n);
+						for (std::size_t i = 0; i < n; ++i) {
+							const std::complex<double> z = menu_circuit_impedance(type, values, f[i]);
+							magnitude[i] = std::abs(z);
+							phase[i] = std::arg(z);
+						}
+					});
+			}
+			ACS_TIMED(output);
+			sink.write_statistics(record, result);
+		}
+		catch (const std::invalid_argument& ex) {
+			std::cerr << "Line " << reader.get_line_number() << ": " << ex.what() << '\n';
+			++errors;
+		}
+	}
+	sink.flush();
+	return errors;
+}
+
+std::size_t run_adaptive_batch(std::istream& in, output_sink& sink, double f_start, double f_stop,
+	const adaptive_options& options) {
+	line_reader reader(in);
+	result_record result;
+	std::size_t errors = 0;
+	const char* first;
+	const char* last;
+	sink.begin();
+	while (reader.next(first, last)) {
+		try {
+			if (!parse_record(first, last, result.input)) {
+				continue;
+			}
+			const circuit_record& record = result.input;
+			const adaptive_result sweep = adaptive_sweep(f_start, f_stop, options,
+				[&record](const double* f, std::size_t n, std::complex<double>* z) {
+					ACS_TIMED(sweep);
+					ACS_COUNT(evaluations, n);
+					for (std::size_t i = 0; i < n; ++i) {
+						z[i] = menu_circuit_impedance(record.type, record.values, f[i]);
+					}
+				});
+			ACS_TIMED(output);
+			for (std::size_t i = 0; i < sweep.curve.frequency.size(); ++i) {
+				result.input.frequency = sweep.curve.frequency[i];
+				result.magnitude = sweep.curve.magnitude[i];
+				result.phase = sweep.curve.phase[i];
+				sink.write(result);
+			}
+			for (const resonance& r : sweep.resonances) {
+				std::clog << "Line " << reader.get_line_number() << ": " << (r.peak ? "Parallel" : "Series")
+					<< " resonance at " << r.frequency << " Hz, |Z| = " << r.magnitude << " Ohms, Q = " << r.quality_factor << '\n';
+			}
+		}
+		catch (const std::invalid_argument& ex) {
+			std::cerr << "Line " << reader.get_line_number() << ": " << ex.what() << '\n';
+			++errors;
+		}
+	}
+	sink.flush();
+	return errors;
+}
+
+std::size_t run_sweep_batch(std::istream& in, output_sink& sink, const frequency_grid& grid, std::size_t chunk) {
+	line_reader reader(in);
+	result_record result;
+	std::size_t errors = 0;
+	const char* first;
+	const char* last;
+	sink.begin();
+	while (reader.next(first, last)) {
+		try {
+			if (!parse_record(first, last, result.input)) {
+				continue;
+			}
+			const circuit_record record = result.input;
+			pipelined_sweep sweep(sweep_stream([&record](const double* f, std::size_t n, double* magnitude, double* phase) {
+				ACS_TIMED(sweep);
+				ACS_COUNT(evaluations, n);
+				for (std::size_t i = 0; i < n; ++i) {
+					const std::complex<double> z = menu_circuit_impedance(record.type, record.values, f[i]);
+					magnitude[i] = std::abs(z);
+					phase[i] = std::arg(z);
+				}
+			}, grid), chunk);
+			sweep_chunk points;
+			while (sweep.next(points)) {
+				ACS_TIMED(output);
+				for (std::size_t i = 0; i < points.size; ++i) {
+					result.input.frequency = points.frequency[i];
+					result.magnitude = points.magnitude[i];
+					result.phase = points.phase[i];
+					sink.write(result);
+				}
+			}
+		}
+		catch (const std::invalid_argument& ex) {
+			std::cerr << "Line " << reader.get_line_number() << ": " << ex.what() << '\n';
+			++errors;
+		}
+	}
+	sink.flush();
+	return errors;
+}
@@ -0,0 +1,14 @@
+﻿#include "acs/cache.h"
+
+std::uint64_t hash_bytes(const std::string& bytes) {
+	std::uint64_t h = mix64(bytes.size());
+	std::size_t i = 0;
+	for (; i + 8 <= bytes.size(); i += 8) {
+		std::uint64_t word;
+		std::memcpy(&word, bytes.data() + i, 8);
+		h = mix64(h ^ word);
+	}
+	std::uint64_t tail = 0;
+	std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+	return mix64(h ^ tail);
+}
@@ -0,0 +1,333 @@
+﻿#include "acs/columnar.h"
+
+#include <cstring>
+#include <limits>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file(const std::string& path) : address(nullptr), length(0), writable(false) {
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Error: Cannot open " + path);
+	}
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(handle, &size) && size.QuadPart > 0) {
+		mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	if (mapping != nullptr) {
+		address = static_cast<unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		CloseHandle(mapping);
+	}
+	CloseHandle(handle);
+	if (address == nullptr) {
+		throw std::runtime_error("Error: Cannot map " + path);
+	}
+	length = static_cast<std::size_t>(size.QuadPart);
+#else
+	const int descriptor = ::open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		throw std::runtime_error("Error: Cannot open " + path);
+	}
+	struct stat status;
+	void* mapping = MAP_FAILED;
+	if (fstat(descriptor, &status) == 0 && status.st_size > 0) {
+		mapping = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+	}
+	::close(descriptor);
+	if (mapping == MAP_FAILED) {
+		throw std::runtime_error("Error: Cannot map " + path);
+	}
+	address = static_cast<unsigned char*>(mapping);
+	length = static_cast<std::size_t>(status.st_size);
+#endif
+}
+
+mapped_file::mapped_file(const std::string& path, std::size_t size) : address(nullptr), length(0), writable(true) {
+	if (size == 0) {
+		throw std::invalid_argument("Error: Mapped file must not be empty.");
+	}
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Error: Cannot create " + path);
+	}
+	const unsigned long long wide = size;
+	HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, static_cast<DWORD>(wide >> 32),
+		static_cast<DWORD>(wide & 0xffffffffu), nullptr);
+	if (mapping != nullptr) {
+		address = static_cast<unsigned char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+		CloseHandle(mapping);
+	}
+	CloseHandle(handle);
+	if (address == nullptr) {
+		throw std::runtime_error("Error: Cannot map " + path);
+	}
+#else
+	const int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (descriptor < 0) {
+		throw std::runtime_error("Error: Cannot create " + path);
+	}
+	void* mapping = MAP_FAILED;
+	if (ftruncate(descriptor, static_cast<off_t>(size)) == 0) {
+		mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	}
+	::close(descriptor);
+	if (mapping == MAP_FAILED) {
+		throw std::runtime_error("Error: Cannot map " + path);
+	}
+	address = static_cast<unsigned char*>(mapping);
+#endif
+	length = size;
+}
+
+void mapped_file::release() {
+	if (address != nullptr) {
+#ifdef _WIN32
+		UnmapViewOfFile(address);
+#else
+		munmap(address, length);
+#endif
+		address = nullptr;
+		length = 0;
+	}
+}
+
+void mapped_file::flush() {
+	if (address != nullptr && writable) {
+#ifdef _WIN32
+		FlushViewOfFile(address, 0);
+#else
+		msync(address, length, MS_SYNC);
+#endif
+	}
+}
+
+namespace {
+
+const std::uint32_t columnar_version = 1;
+const std::uint32_t byte_order_mark = 0x01020304u;
+
+// Column offsets of a netlist file with b branches and s sources
+struct netlist_layout
+{
+	std::size_t kinds, values, from, to, source_from, source_to, source_currents, size;
+	netlist_layout(std::size_t b, std::size_t s) {
+		kinds = sizeof(columnar_header);
+		values = align_column(kinds + b);
+		from = align_column(values + b * sizeof(double));
+		to = align_column(from + b * sizeof(std::uint32_t));
+		source_from = align_column(to + b * sizeof(std::uint32_t));
+		source_to = align_column(source_from + s * sizeof(std::uint32_t));
+		source_currents = align_column(source_to + s * sizeof(std::uint32_t));
+		size = source_currents + 2 * s * sizeof(double);
+	}
+};
+
+// Column offsets of a sweep file with the given rows and points
+struct sweep_layout
+{
+	std::size_t frequency, magnitude, phase, size;
+	sweep_layout(std::size_t rows, std::size_t points) {
+		frequency = sizeof(columnar_header);
+		magnitude = align_column(frequency + points * sizeof(double));
+		phase = align_column(magnitude + rows * points * sizeof(double));
+		size = phase + rows * points * sizeof(double);
+	}
+};
+
+void write_header(unsigned char* data, const char* magic, const std::uint64_t* counts, std::size_t count) {
+	columnar_header header = {};
+	std::memcpy(header.magic, magic, 4);
+	header.version = columnar_version;
+	header.byte_order = byte_order_mark;
+	header.header_size = sizeof(columnar_header);
+	std::copy(counts, counts + count, header.counts);
+	std::memcpy(data, &header, sizeof(header));
+}
+
+// Header of a mapped file, checked against the expected magic
+columnar_header read_header(const mapped_file& file, const char* magic, const std::string& path) {
+	columnar_header header;
+	if (file.size() < sizeof(header)) {
+		throw std::runtime_error("Error: " + path + " is too short for a header.");
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (std::memcmp(header.magic, magic, 4) != 0) {
+		throw std::runtime_error("Error: " + path + " is not an " + std::string(magic, 4) + " file.");
+	}
+	if (header.byte_order != byte_order_mark) {
+		throw std::runtime_error("Error: " + path + " was written with the other byte order.");
+	}
+	if (header.version != columnar_version || header.header_size != sizeof(columnar_header)) {
+		throw std::runtime_error("Error: " + path + " has an unsupported version.");
+	}
+	return header;
+}
+
+// Counts that would overflow the layout arithmetic are as bad as a short file
+void check_size(std::uint64_t count, std::uint64_t limit, const std::string& path) {
+	if (count > limit) {
+		throw std::runtime_error("Error: " + path + " is shorter than its header says.");
+	}
+}
+
+}
+
+void write_netlist_file(const netlist& net, const std::string& path) {
+	if (!net.get_devices().empty()) {
+		throw std::invalid_argument("Error: Transistors cannot be written to a netlist file.");
+	}
+	if (net.get_node_count() > std::numeric_limits<std::uint32_t>::max()) {
+		throw std::invalid_argument("Error: Netlist has too many nodes for a netlist file.");
+	}
+	const std::vector<netlist::branch>& branches = net.get_branches();
+	const std::vector<netlist::source>& sources = net.get_sources();
+	const netlist_layout layout(branches.size(), sources.size());
+	// Read every value before creating the file, so a bad part leaves no file behind
+	std::vector<std::uint8_t> kinds(branches.size());
+	std::vector<double> values(branches.size());
+	for (std::size_t k = 0; k < branches.size(); ++k) {
+		const component_kind kind = branches[k].part->get_kind();
+		if (kind != component_kind::resistor && kind != component_kind::capacitor && kind != component_kind::inductor) {
+			throw std::invalid_argument("Error: Only resistors, capacitors and inductors can be written to a netlist file.");
+		}
+		kinds[k] = static_cast<std::uint8_t>(kind);
+		values[k] = branches[k].part->get_value();
+	}
+	// The file holds fixed currents, so a voltage source must be behind a resistor
+	std::vector<std::complex<double>> currents(sources.size());
+	for (std::size_t k = 0; k < sources.size(); ++k) {
+		if (sources[k].internal != nullptr && sources[k].internal->get_kind() != component_kind::resistor) {
+			throw std::invalid_argument("Error: Only voltage sources behind a resistor can be written to a netlist file.");
+		}
+		currents[k] = sources[k].current_at(frequency_point::at(1.0));
+	}
+	mapped_file file(path, layout.size);
+	unsigned char* data = file.writable_data();
+	const std::uint64_t counts[3] = { net.get_node_count(), branches.size(), sources.size() };
+	write_header(data, "ACSN", counts, 3);
+	std::memcpy(data + layout.kinds, kinds.data(), kinds.size());
+	std::memcpy(data + layout.values, values.data(), values.size() * sizeof(double));
+	for (std::size_t k = 0; k < branches.size(); ++k) {
+		const std::uint32_t nodes[2] = { static_cast<std::uint32_t>(branches[k].from), static_cast<std::uint32_t>(branches[k].to) };
+		std::memcpy(data + layout.from + k * sizeof(std::uint32_t), &nodes[0], sizeof(std::uint32_t));
+		std::memcpy(data + layout.to + k * sizeof(std::uint32_t), &nodes[1], sizeof(std::uint32_t));
+	}
+	for (std::size_t k = 0; k < sources.size(); ++k) {
+		const std::uint32_t nodes[2] = { static_cast<std::uint32_t>(sources[k].from), static_cast<std::uint32_t>(sources[k].to) };
+		const double current[2] = { currents[k].real(), currents[k].imag() };
+		std::memcpy(data + layout.source_from + k * sizeof(std::uint32_t), &nodes[0], sizeof(std::uint32_t));
+		std::memcpy(data + layout.source_to + k * sizeof(std::uint32_t), &nodes[1], sizeof(std::uint32_t));
+		std::memcpy(data + layout.source_currents + 2 * k * sizeof(double), current, sizeof(current));
+	}
+	file.flush();
+}
+
+mapped_netlist::mapped_netlist(const std::string& path) : file(path) {
+	const columnar_header header = read_header(file, "ACSN", path);
+	// Bounds that keep the layout arithmetic from overflowing before the size check
+	const std::uint64_t limit = file.size();
+	check_size(header.counts[1], limit, path);
+	check_size(header.counts[2], limit, path);
+	node_count = static_cast<std::size_t>(header.counts[0]);
+	branch_count = static_cast<std::size_t>(header.counts[1]);
+	source_count = static_cast<std::size_t>(header.counts[2]);
+	const netlist_layout layout(branch_count, source_count);
+	if (layout.size > file.size()) {
+		throw std::runtime_error("Error: " + path + " is shorter than its header says.");
+	}
+	if (node_count == 0 || node_count > std::numeric_limits<std::uint32_t>::max()) {
+		throw std::runtime_error("Error: " + path + " has an invalid node count.");
+	}
+	const unsigned char* data = file.data();
+	kinds = data + layout.kinds;
+	values = reinterpret_cast<const double*>(data + layout.values);
+	from = reinterpret_cast<const std::uint32_t*>(data + layout.from);
+	to = reinterpret_cast<const std::uint32_t*>(data + layout.to);
+	source_from = reinterpret_cast<const std::uint32_t*>(data + layout.source_from);
+	source_to = reinterpret_cast<const std::uint32_t*>(data + layout.source_to);
+	source_currents = reinterpret_cast<const double*>(data + layout.source_currents);
+	for (std::size_t k = 0; k < branch_count; ++k) {
+		if (kinds[k] > static_cast<std::uint8_t>(component_kind::inductor)) {
+			throw std::runtime_error("Error: " + path + " has a branch of unknown kind.");
+		}
+		if (from[k] >= node_count || to[k] >= node_count || from[k] == to[k]) {
+			throw std::runtime_error("Error: " + path + " has a branch with invalid nodes.");
+		}
+	}
+	for (std::size_t k = 0; k < source_count; ++k) {
+		if (source_from[k] >= node_count || source_to[k] >= node_count) {
+			throw std::runtime_error("Error: " + path + " has a source with invalid nodes.");
+		}
+	}
+	np = build_nodal_pattern(node_count, from, to, branch_count);
+	symbolic = analyse_lu(np.pattern, minimum_degree_order(np.pattern));
+	own_workspace = make_workspace();
+}
+
+netlist mapped_netlist::make_netlist(std::vector<std::unique_ptr<components>>& parts) const {
+	netlist net;
+	for (std::size_t i = 1; i < node_count; ++i) {
+		net.add_node();
+	}
+	for (std::size_t k = 0; k < branch_count; ++k) {
+		switch (static_cast<component_kind>(kinds[k])) {
+		case component_kind::resistor:
+			parts.push_back(std::make_unique<resistor>(values[k]));
+			break;
+		case component_kind::capacitor:
+			parts.push_back(std::make_unique<capacitor>(values[k]));
+			break;
+		default:
+			parts.push_back(std::make_unique<inductor>(values[k]));
+			break;
+		}
+		net.add_component(parts.back().get(), from[k], to[k]);
+	}
+	for (std::size_t k = 0; k < source_count; ++k) {
+		net.add_current_source(source_from[k], source_to[k], { source_currents[2 * k], source_currents[2 * k + 1] });
+	}
+	return net;
+}
+
+mapped_sweep::mapped_sweep(const std::string& path) : file(path) {
+	const columnar_header header = read_header(file, "ACSS", path);
+	const std::uint64_t limit = file.size();
+	check_size(header.counts[0], limit, path);
+	check_size(header.counts[1], limit, path);
+	if (header.counts[0] != 0 && header.counts[1] > limit / header.counts[0]) {
+		throw std::runtime_error("Error: " + path + " is shorter than its header says.");
+	}
+	rows = static_cast<std::size_t>(header.counts[0]);
+	points = static_cast<std::size_t>(header.counts[1]);
+	const sweep_layout layout(rows, points);
+	if (layout.size > file.size()) {
+		throw std::runtime_error("Error: " + path + " is shorter than its header says.");
+	}
+	frequency = reinterpret_cast<const double*>(file.data() + layout.frequency);
+	magnitude = reinterpret_cast<const double*>(file.data() + layout.magnitude);
+	phase = reinterpret_cast<const double*>(file.data() + layout.phase);
+}
+
+mapped_sweep::mapped_sweep(const std::string& path, const std::vector<double>& freqs, std::size_t row_count) :
+	file(path, sweep_layout(row_count, freqs.size()).size), rows(row_count), points(freqs.size()) {
+	const sweep_layout layout(rows, points);
+	unsigned char* data = file.writable_data();
+	const std::uint64_t counts[2] = { rows, points };
+	write_header(data, "ACSS", counts, 2);
+	std::memcpy(data + layout.frequency, freqs.data(), points * sizeof(double));
+	frequency = reinterpret_cast<const double*>(data + layout.frequency);
+	magnitude = reinterpret_cast<const double*>(data + layout.magnitude);
+	phase = reinterpret_cast<const double*>(data + layout.phase);
+}
@@ -0,0 +1,200 @@
+﻿#include "acs/instrument.h"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> instrumentation::enabled(false);
+std::atomic<bool> instrumentation::tracing(false);
+
+namespace {
+
+// Trace events kept per thread are capped, so a long run cannot use up memory;
+// the totals carry on regardless
+const std::size_t max_trace_events = 1 << 20;
+
+struct trace_event
+{
+	timed_stage stage;
+	std::uint64_t start;
+	std::uint64_t duration;
+};
+
+// Totals of one thread. Only the owning thread writes them, a load and a store
+// at a time, so the atomics are only there to let the report read them safely.
+struct thread_profile
+{
+	std::atomic<std::uint64_t> calls[timed_stage_count] = {};
+	std::atomic<std::uint64_t> nanoseconds[timed_stage_count] = {};
+	std::atomic<std::uint64_t> counts[counted_event_count] = {};
+	std::mutex events_lock;
+	std::vector<trace_event> events;
+	std::uint64_t dropped_events = 0;
+	std::size_t thread_index = 0;
+};
+
+void add(std::atomic<std::uint64_t>& total, std::uint64_t n) {
+	total.store(total.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Every thread that has recorded anything. Profiles are never removed, so the
+// totals of threads that have finished still count.
+std::mutex registry_lock;
+std::vector<std::unique_ptr<thread_profile>> profiles;
+std::uint64_t enabled_at = 0;
+std::uint64_t disabled_at = 0;
+
+thread_profile& local_profile() {
+	thread_local thread_profile* profile = nullptr;
+	if (profile == nullptr) {
+		std::lock_guard<std::mutex> guard(registry_lock);
+		profiles.push_back(std::make_unique<thread_profile>());
+		profile = profiles.back().get();
+		profile->thread_index = profiles.size();
+	}
+	return *profile;
+}
+
+const char* const stage_names[timed_stage_count] = {
+	"read", "parse", "build", "update", "evaluate", "sweep", "assemble", "factor", "solve", "output", "write"
+};
+const char* const event_names[counted_event_count] = {
+	"records", "evaluations", "factorizations", "solves", "refinements", "precision fallbacks",
+	"cache hits", "cache misses", "allocations"
+};
+
+}
+
+void instrumentation::enable(bool trace) {
+	std::lock_guard<std::mutex> guard(registry_lock);
+	for (const std::unique_ptr<thread_profile>& p : profiles) {
+		for (std::size_t i = 0; i < timed_stage_count; ++i) {
+			p->calls[i].store(0, std::memory_order_relaxed);
+			p->nanoseconds[i].store(0, std::memory_order_relaxed);
+		}
+		for (std::size_t i = 0; i < counted_event_count; ++i) {
+			p->counts[i].store(0, std::memory_order_relaxed);
+		}
+		std::lock_guard<std::mutex> events_guard(p->events_lock);
+		p->events.clear();
+		p->dropped_events = 0;
+	}
+	enabled_at = now();
+	disabled_at = 0;
+	tracing.store(trace, std::memory_order_relaxed);
+	enabled.store(true, std::memory_order_release);
+}
+
+void instrumentation::disable() {
+	enabled.store(false, std::memory_order_release);
+	tracing.store(false, std::memory_order_relaxed);
+	std::lock_guard<std::mutex> guard(registry_lock);
+	disabled_at = now();
+}
+
+void instrumentation::add_time(timed_stage stage, std::uint64_t start, std::uint64_t end) {
+	thread_profile& p = local_profile();
+	const std::size_t i = static_cast<std::size_t>(stage);
+	add(p.calls[i], 1);
+	add(p.nanoseconds[i], end - start);
+	if (is_tracing()) {
+		std::lock_guard<std::mutex> guard(p.events_lock);
+		if (p.events.size() < max_trace_events) {
+			p.events.push_back({ stage, start, end - start });
+		}
+		else {
+			++p.dropped_events;
+		}
+	}
+}
+
+void instrumentation::add_count(counted_event event, std::uint64_t n) {
+	add(local_profile().counts[static_cast<std::size_t>(event)], n);
+}
+
+stage_totals instrumentation::get_totals(timed_stage stage) {
+	const std::size_t i = static_cast<std::size_t>(stage);
+	stage_totals totals;
+	std::lock_guard<std::mutex> guard(registry_lock);
+	for (const std::unique_ptr<thread_profile>& p : profiles) {
+		totals.calls += p->calls[i].load(std::memory_order_relaxed);
+		totals.nanoseconds += p->nanoseconds[i].load(std::memory_order_relaxed);
+	}
+	return totals;
+}
+
+std::uint64_t instrumentation::get_count(counted_event event) {
+	const std::size_t i = static_cast<std::size_t>(event);
+	std::uint64_t total = 0;
+	std::lock_guard<std::mutex> guard(registry_lock);
+	for (const std::unique_ptr<thread_profile>& p : profiles) {
+		total += p->counts[i].load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+const char* instrumentation::get_name(timed_stage stage) {
+	return stage_names[static_cast<std::size_t>(stage)];
+}
+
+const char* instrumentation::get_name(counted_event event) {
+	return event_names[static_cast<std::size_t>(event)];
+}
+
+void instrumentation::write_summary(std::ostream& out) {
+	std::uint64_t wall;
+	{
+		std::lock_guard<std::mutex> guard(registry_lock);
+		wall = (disabled_at != 0 ? disabled_at : now()) - enabled_at;
+	}
+	char line[128];
+	std::snprintf(line, sizeof(line), "Wall time %.3f ms\n", wall * 1e-6);
+	out << line;
+	std::snprintf(line, sizeof(line), "%-12s %12s %14s %12s %8s\n", "Stage", "Calls", "Total (ms)", "Mean (us)", "Share");
+	out << line;
+	for (std::size_t i = 0; i < timed_stage_count; ++i) {
+		const stage_totals t = get_totals(static_cast<timed_stage>(i));
+		if (t.calls == 0) {
+			continue;
+		}
+		std::snprintf(line, sizeof(line), "%-12s %12llu %14.3f %12.3f %7.1f%%\n", stage_names[i],
+			static_cast<unsigned long long>(t.calls), t.nanoseconds * 1e-6, t.nanoseconds * 1e-3 / t.calls,
+			wall > 0 ? 100.0 * t.nanoseconds / wall : 0.0);
+		out << line;
+	}
+	std::snprintf(line, sizeof(line), "%-20s %16s\n", "Counter", "Value");
+	out << line;
+	for (std::size_t i = 0; i < counted_event_count; ++i) {
+		const std::uint64_t n = get_count(static_cast<counted_event>(i));
+		if (n == 0) {
+			continue;
+		}
+		std::snprintf(line, sizeof(line), "%-20s %16llu\n", event_names[i], static_cast<unsigned long long>(n));
+		out << line;
+	}
+}
+
+void instrumentation::write_trace(std::ostream& out) {
+	std::lock_guard<std::mutex> guard(registry_lock);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	char line[160];
+	std::uint64_t dropped = 0;
+	for (const std::unique_ptr<thread_profile>& p : profiles) {
+		std::lock_guard<std::mutex> events_guard(p->events_lock);
+		dropped += p->dropped_events;
+		std::snprintf(line, sizeof(line), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"thread %zu\"}}",
+			first ? "" : ",", p->thread_index, p->thread_index);
+		out << line;
+		first = false;
+		for (const trace_event& e : p->events) {
+			// Timestamps are microseconds from enable()
+			std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"acs\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+				stage_names[static_cast<std::size_t>(e.stage)], p->thread_index,
+				(e.start - enabled_at) * 1e-3, e.duration * 1e-3);
+			out << line;
+		}
+	}
+	out << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+}
@@ -0,0 +1,805 @@
+﻿#include "acs/kernels.h"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ACS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define ACS_TARGET(isa)
+#endif
+
+namespace {
+
+template <typename T>
+void add_reactance_scalar(const T* f, std::size_t n, T a, T b, T* im) {
+	for (std::size_t i = 0; i < n; ++i) {
+		im[i] += a * f[i] + b / f[i];
+	}
+}
+template <typename T>
+void add_scaled_scalar(const T* x, std::size_t n, T a, T* y) {
+	for (std::size_t i = 0; i < n; ++i) {
+		y[i] += a * x[i];
+	}
+}
+template <typename T>
+void add_linear_scalar(const T* x, const T* y, std::size_t n, T a, T b, T* out) {
+	for (std::size_t i = 0; i < n; ++i) {
+		out[i] += a * x[i] + b * y[i];
+	}
+}
+template <typename T>
+void add_reciprocal_scalar(const T* zr, const T* zi, std::size_t n, T* re, T* im) {
+	for (std::size_t i = 0; i < n; ++i) {
+		const T inv = T(1) / (zr[i] * zr[i] + zi[i] * zi[i]);
+		re[i] += zr[i] * inv;
+		im[i] -= zi[i] * inv;
+	}
+}
+template <typename T>
+void invert_scalar(T* re, T* im, std::size_t n) {
+	for (std::size_t i = 0; i < n; ++i) {
+		const T inv = T(1) / (re[i] * re[i] + im[i] * im[i]);
+		re[i] *= inv;
+		im[i] *= -inv;
+	}
+}
+template <typename T>
+void magnitude_scalar(const T* re, const T* im, std::size_t n, T* mag) {
+	for (std::size_t i = 0; i < n; ++i) {
+		mag[i] = std::sqrt(re[i] * re[i] + im[i] * im[i]);
+	}
+}
+template <typename T>
+void phase_scalar(const T* re, const T* im, std::size_t n, T* phase) {
+	for (std::size_t i = 0; i < n; ++i) {
+		phase[i] = std::atan2(im[i], re[i]);
+	}
+}
+
+// The vector phase kernels take atan2 apart as atan(t) for t = min/max of |re| and
+// |im| in [0, 1], then fix up the octant. Above 0.66, atan(t) = pi/4 + atan(u) with
+// u = (t - 1) / (t + 1); atan(u) = u + u z P(z) / Q(z) in z = u^2 is the Cephes
+// approximation, good to an ulp. Each constant of pi comes with the part
+// lost in rounding it to a double. Blocks with an infinite or NaN part are left
+// to std::atan2.
+const double atan_p[5] = {
+	-8.750608600031904122785e-1, -1.615753718733365076637e1, -7.500855792314704667340e1,
+	-1.228866684490136173410e2, -6.485021904942025371773e1
+};
+const double atan_q[5] = {
+	2.485846490142306297962e1, 1.650270098316988542046e2, 4.328810604912902668951e2,
+	4.853903996359136964868e2, 1.945506571482613964425e2
+};
+const double quarter_pi = 7.85398163397448309616e-1;
+const double quarter_pi_tail = 3.061616997868382943065e-17;
+const double half_pi = 1.57079632679489661923;
+const double half_pi_tail = 6.123233995736765886130e-17;
+const double full_pi = 3.14159265358979323846;
+const double full_pi_tail = 1.224646799147353177226e-16;
+
+// The float phase kernels reduce the same way, at tan(pi/8) instead, and use the
+// Cephes atanf polynomial atan(u) = u + u z P(z), good to about two ulps in float
+const float atanf_p[4] = { 8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f, -3.33329491539e-1f };
+const float atanf_reduce = 0.414213562373095f;
+const float quarter_pi_float = 0.785398163397448f;
+const float half_pi_float = 1.57079632679490f;
+const float full_pi_float = 3.14159265358979f;
+
+#if defined(__x86_64__) || defined(_M_X64)
+ACS_TARGET("avx2,fma") void add_reactance_avx2(const double* f, std::size_t n, double a, double b, double* im) {
+	const __m256d va = _mm256_set1_pd(a);
+	const __m256d vb = _mm256_set1_pd(b);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d vf = _mm256_loadu_pd(f + i);
+		__m256d acc = _mm256_loadu_pd(im + i);
+		acc = _mm256_fmadd_pd(va, vf, _mm256_add_pd(acc, _mm256_div_pd(vb, vf)));
+		_mm256_storeu_pd(im + i, acc);
+	}
+	add_reactance_scalar(f + i, n - i, a, b, im + i);
+}
+ACS_TARGET("avx2,fma") void add_scaled_avx2(const double* x, std::size_t n, double a, double* y) {
+	const __m256d va = _mm256_set1_pd(a);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+	}
+	add_scaled_scalar(x + i, n - i, a, y + i);
+}
+ACS_TARGET("avx2,fma") void add_linear_avx2(const double* x, const double* y, std::size_t n, double a, double b, double* out) {
+	const __m256d va = _mm256_set1_pd(a);
+	const __m256d vb = _mm256_set1_pd(b);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d acc = _mm256_fmadd_pd(vb, _mm256_loadu_pd(y + i), _mm256_loadu_pd(out + i));
+		_mm256_storeu_pd(out + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), acc));
+	}
+	add_linear_scalar(x + i, y + i, n - i, a, b, out + i);
+}
+ACS_TARGET("avx2,fma") void add_reciprocal_avx2(const double* zr, const double* zi, std::size_t n, double* re, double* im) {
+	const __m256d one = _mm256_set1_pd(1.0);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d vr = _mm256_loadu_pd(zr + i);
+		const __m256d vi = _mm256_loadu_pd(zi + i);
+		const __m256d inv = _mm256_div_pd(one, _mm256_fmadd_pd(vr, vr, _mm256_mul_pd(vi, vi)));
+		_mm256_storeu_pd(re + i, _mm256_fmadd_pd(vr, inv, _mm256_loadu_pd(re + i)));
+		_mm256_storeu_pd(im + i, _mm256_fnmadd_pd(vi, inv, _mm256_loadu_pd(im + i)));
+	}
+	add_reciprocal_scalar(zr + i, zi + i, n - i, re + i, im + i);
+}
+ACS_TARGET("avx2,fma") void invert_avx2(double* re, double* im, std::size_t n) {
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d minus_one = _mm256_set1_pd(-1.0);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d vr = _mm256_loadu_pd(re + i);
+		const __m256d vi = _mm256_loadu_pd(im + i);
+		const __m256d inv = _mm256_div_pd(one, _mm256_fmadd_pd(vr, vr, _mm256_mul_pd(vi, vi)));
+		_mm256_storeu_pd(re + i, _mm256_mul_pd(vr, inv));
+		_mm256_storeu_pd(im + i, _mm256_mul_pd(vi, _mm256_mul_pd(inv, minus_one)));
+	}
+	invert_scalar(re + i, im + i, n - i);
+}
+ACS_TARGET("avx2,fma") void magnitude_avx2(const double* re, const double* im, std::size_t n, double* mag) {
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d vr = _mm256_loadu_pd(re + i);
+		const __m256d vi = _mm256_loadu_pd(im + i);
+		_mm256_storeu_pd(mag + i, _mm256_sqrt_pd(_mm256_fmadd_pd(vr, vr, _mm256_mul_pd(vi, vi))));
+	}
+	magnitude_scalar(re + i, im + i, n - i, mag + i);
+}
+ACS_TARGET("avx2,fma") void phase_avx2(const double* re, const double* im, std::size_t n, double* phase) {
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const __m256d x = _mm256_loadu_pd(re + i);
+		const __m256d y = _mm256_loadu_pd(im + i);
+		const __m256d ax = _mm256_andnot_pd(sign, x);
+		const __m256d ay = _mm256_andnot_pd(sign, y);
+		const __m256d hi = _mm256_max_pd(ax, ay);
+		const __m256d finite = _mm256_and_pd(_mm256_cmp_pd(ax, infinity, _CMP_LT_OQ), _mm256_cmp_pd(ay, infinity, _CMP_LT_OQ));
+		if (_mm256_movemask_pd(finite) != 0xf) {
+			phase_scalar(re + i, im + i, 4, phase + i);
+			continue;
+		}
+		__m256d t = _mm256_div_pd(_mm256_min_pd(ax, ay), hi);
+		t = _mm256_blendv_pd(t, zero, _mm256_cmp_pd(hi, zero, _CMP_EQ_OQ));
+		const __m256d reduce = _mm256_cmp_pd(t, _mm256_set1_pd(0.66), _CMP_GT_OQ);
+		const __m256d u = _mm256_blendv_pd(t, _mm256_div_pd(_mm256_sub_pd(t, one), _mm256_add_pd(t, one)), reduce);
+		const __m256d z = _mm256_mul_pd(u, u);
+		__m256d p = _mm256_set1_pd(atan_p[0]);
+		__m256d q = _mm256_add_pd(z, _mm256_set1_pd(atan_q[0]));
+		for (int k = 1; k < 5; ++k) {
+			p = _mm256_fmadd_pd(p, z, _mm256_set1_pd(atan_p[k]));
+			q = _mm256_fmadd_pd(q, z, _mm256_set1_pd(atan_q[k]));
+		}
+		__m256d r = _mm256_fmadd_pd(u, _mm256_div_pd(_mm256_mul_pd(z, p), q), u);
+		r = _mm256_blendv_pd(r, _mm256_add_pd(_mm256_set1_pd(quarter_pi), _mm256_add_pd(r, _mm256_set1_pd(quarter_pi_tail))), reduce);
+		r = _mm256_blendv_pd(r, _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(half_pi), r), _mm256_set1_pd(half_pi_tail)),
+			_mm256_cmp_pd(ay, ax, _CMP_GT_OQ));
+		// Blending on x itself picks by its sign bit, so -0 counts as negative as in atan2
+		r = _mm256_blendv_pd(r, _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(full_pi), r), _mm256_set1_pd(full_pi_tail)), x);
+		_mm256_storeu_pd(phase + i, _mm256_or_pd(r, _mm256_and_pd(y, sign)));
+	}
+	phase_scalar(re + i, im + i, n - i, phase + i);
+}
+
+ACS_TARGET("avx2,fma") void add_reactance_avx2_float(const float* f, std::size_t n, float a, float b, float* im) {
+	const __m256 va = _mm256_set1_ps(a);
+	const __m256 vb = _mm256_set1_ps(b);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 vf = _mm256_loadu_ps(f + i);
+		__m256 acc = _mm256_loadu_ps(im + i);
+		acc = _mm256_fmadd_ps(va, vf, _mm256_add_ps(acc, _mm256_div_ps(vb, vf)));
+		_mm256_storeu_ps(im + i, acc);
+	}
+	add_reactance_scalar(f + i, n - i, a, b, im + i);
+}
+ACS_TARGET("avx2,fma") void add_scaled_avx2_float(const float* x, std::size_t n, float a, float* y) {
+	const __m256 va = _mm256_set1_ps(a);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+	}
+	add_scaled_scalar(x + i, n - i, a, y + i);
+}
+ACS_TARGET("avx2,fma") void add_linear_avx2_float(const float* x, const float* y, std::size_t n, float a, float b, float* out) {
+	const __m256 va = _mm256_set1_ps(a);
+	const __m256 vb = _mm256_set1_ps(b);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 acc = _mm256_fmadd_ps(vb, _mm256_loadu_ps(y + i), _mm256_loadu_ps(out + i));
+		_mm256_storeu_ps(out + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), acc));
+	}
+	add_linear_scalar(x + i, y + i, n - i, a, b, out + i);
+}
+ACS_TARGET("avx2,fma") void add_reciprocal_avx2_float(const float* zr, const float* zi, std::size_t n, float* re, float* im) {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 vr = _mm256_loadu_ps(zr + i);
+		const __m256 vi = _mm256_loadu_ps(zi + i);
+		const __m256 inv = _mm256_div_ps(one, _mm256_fmadd_ps(vr, vr, _mm256_mul_ps(vi, vi)));
+		_mm256_storeu_ps(re + i, _mm256_fmadd_ps(vr, inv, _mm256_loadu_ps(re + i)));
+		_mm256_storeu_ps(im + i, _mm256_fnmadd_ps(vi, inv, _mm256_loadu_ps(im + i)));
+	}
+	add_reciprocal_scalar(zr + i, zi + i, n - i, re + i, im + i);
+}
+ACS_TARGET("avx2,fma") void invert_avx2_float(float* re, float* im, std::size_t n) {
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 minus_one = _mm256_set1_ps(-1.0f);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 vr = _mm256_loadu_ps(re + i);
+		const __m256 vi = _mm256_loadu_ps(im + i);
+		const __m256 inv = _mm256_div_ps(one, _mm256_fmadd_ps(vr, vr, _mm256_mul_ps(vi, vi)));
+		_mm256_storeu_ps(re + i, _mm256_mul_ps(vr, inv));
+		_mm256_storeu_ps(im + i, _mm256_mul_ps(vi, _mm256_mul_ps(inv, minus_one)));
+	}
+	invert_scalar(re + i, im + i, n - i);
+}
+ACS_TARGET("avx2,fma") void magnitude_avx2_float(const float* re, const float* im, std::size_t n, float* mag) {
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 vr = _mm256_loadu_ps(re + i);
+		const __m256 vi = _mm256_loadu_ps(im + i);
+		_mm256_storeu_ps(mag + i, _mm256_sqrt_ps(_mm256_fmadd_ps(vr, vr, _mm256_mul_ps(vi, vi))));
+	}
+	magnitude_scalar(re + i, im + i, n - i, mag + i);
+}
+ACS_TARGET("avx2,fma") void phase_avx2_float(const float* re, const float* im, std::size_t n, float* phase) {
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m256 x = _mm256_loadu_ps(re + i);
+		const __m256 y = _mm256_loadu_ps(im + i);
+		const __m256 ax = _mm256_andnot_ps(sign, x);
+		const __m256 ay = _mm256_andnot_ps(sign, y);
+		const __m256 hi = _mm256_max_ps(ax, ay);
+		const __m256 finite = _mm256_and_ps(_mm256_cmp_ps(ax, infinity, _CMP_LT_OQ), _mm256_cmp_ps(ay, infinity, _CMP_LT_OQ));
+		if (_mm256_movemask_ps(finite) != 0xff) {
+			phase_scalar(re + i, im + i, 8, phase + i);
+			continue;
+		}
+		__m256 t = _mm256_div_ps(_mm256_min_ps(ax, ay), hi);
+		t = _mm256_blendv_ps(t, zero, _mm256_cmp_ps(hi, zero, _CMP_EQ_OQ));
+		const __m256 reduce = _mm256_cmp_ps(t, _mm256_set1_ps(atanf_reduce), _CMP_GT_OQ);
+		const __m256 u = _mm256_blendv_ps(t, _mm256_div_ps(_mm256_sub_ps(t, one), _mm256_add_ps(t, one)), reduce);
+		const __m256 z = _mm256_mul_ps(u, u);
+		__m256 p = _mm256_set1_ps(atanf_p[0]);
+		for (int k = 1; k < 4; ++k) {
+			p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(atanf_p[k]));
+		}
+		__m256 r = _mm256_fmadd_ps(_mm256_mul_ps(p, z), u, u);
+		r = _mm256_blendv_ps(r, _mm256_add_ps(r, _mm256_set1_ps(quarter_pi_float)), reduce);
+		r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(half_pi_float), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+		r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(full_pi_float), r), x);
+		_mm256_storeu_ps(phase + i, _mm256_or_ps(r, _mm256_and_ps(y, sign)));
+	}
+	phase_scalar(re + i, im + i, n - i, phase + i);
+}
+
+ACS_TARGET("avx512f") void add_reactance_avx512(const double* f, std::size_t n, double a, double b, double* im) {
+	const __m512d va = _mm512_set1_pd(a);
+	const __m512d vb = _mm512_set1_pd(b);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m512d vf = _mm512_loadu_pd(f + i);
+		__m512d acc = _mm512_loadu_pd(im + i);
+		acc = _mm512_fmadd_pd(va, vf, _mm512_add_pd(acc, _mm512_div_pd(vb, vf)));
+		_mm512_storeu_pd(im + i, acc);
+	}
+	add_reactance_scalar(f + i, n - i, a, b, im + i);
+}
+ACS_TARGET("avx512f") void add_scaled_avx512(const double* x, std::size_t n, double a, double* y) {
+	const __m512d va = _mm512_set1_pd(a);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+	}
+	add_scaled_scalar(x + i, n - i, a, y + i);
+}
+ACS_TARGET("avx512f") void add_linear_avx512(const double* x, const double* y, std::size_t n, double a, double b, double* out) {
+	const __m512d va = _mm512_set1_pd(a);
+	const __m512d vb = _mm512_set1_pd(b);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m512d acc = _mm512_fmadd_pd(vb, _mm512_loadu_pd(y + i), _mm512_loadu_pd(out + i));
+		_mm512_storeu_pd(out + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), acc));
+	}
+	add_linear_scalar(x + i, y + i, n - i, a, b, out + i);
+}
+ACS_TARGET("avx512f") void add_reciprocal_avx512(const double* zr, const double* zi, std::size_t n, double* re, double* im) {
+	const __m512d one = _mm512_set1_pd(1.0);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m512d vr = _mm512_loadu_pd(zr + i);
+		const __m512d vi = _mm512_loadu_pd(zi + i);
+		const __m512d inv = _mm512_div_pd(one, _mm512_fmadd_pd(vr, vr, _mm512_mul_pd(vi, vi)));
+		_mm512_storeu_pd(re + i, _mm512_fmadd_pd(vr, inv, _mm512_loadu_pd(re + i)));
+		_mm512_storeu_pd(im + i, _mm512_fnmadd_pd(vi, inv, _mm512_loadu_pd(im + i)));
+	}
+	add_reciprocal_scalar(zr + i, zi + i, n - i, re + i, im + i);
+}
+ACS_TARGET("avx512f") void invert_avx512(double* re, double* im, std::size_t n) {
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d minus_one = _mm512_set1_pd(-1.0);
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m512d vr = _mm512_loadu_pd(re + i);
+		const __m512d vi = _mm512_loadu_pd(im + i);
+		const __m512d inv = _mm512_div_pd(one, _mm512_fmadd_pd(vr, vr, _mm512_mul_pd(vi, vi)));
+		_mm512_storeu_pd(re + i, _mm512_mul_pd(vr, inv));
+		_mm512_storeu_pd(im + i, _mm512_mul_pd(vi, _mm512_mul_pd(inv, minus_one)));
+	}
+	invert_scalar(re + i, im + i, n - i);
+}
+ACS_TARGET("avx512f") void magnitude_avx512(const double* re, const double* im, std::size_t n, double* mag) {
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m512d vr = _mm512_loadu_pd(re + i);
+		const __m512d vi = _mm512_loadu_pd(im + i);
+		_mm512_storeu_pd(mag + i, _mm512_sqrt_pd(_mm512_fmadd_pd(vr, vr, _mm512_mul_pd(vi, vi))));
+	}
+	magnitude_scalar(re + i, im + i, n - i, mag + i);
+}
+ACS_TARGET("avx512f") void phase_avx512(const double* re, const double* im, std::size_t n, double* phase) {
+	const __m512i sign = _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ull));
+	const __m512d zero = _mm512_setzero_pd();
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d infinity = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+	std::size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const __m512d x = _mm512_loadu_pd(re + i);
+		const __m512d y = _mm512_loadu_pd(im + i);
+		const __m512d ax = _mm512_abs_pd(x);
+		const __m512d ay = _mm512_abs_pd(y);
+		const __m512d hi = _mm512_max_pd(ax, ay);
+		if ((_mm512_cmp_pd_mask(ax, infinity, _CMP_LT_OQ) & _mm512_cmp_pd_mask(ay, infinity, _CMP_LT_OQ)) != 0xff) {
+			phase_scalar(re + i, im + i, 8, phase + i);
+			continue;
+		}
+		__m512d t = _mm512_div_pd(_mm512_min_pd(ax, ay), hi);
+		t = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(hi, zero, _CMP_EQ_OQ), t, zero);
+		const __mmask8 reduce = _mm512_cmp_pd_mask(t, _mm512_set1_pd(0.66), _CMP_GT_OQ);
+		const __m512d u = _mm512_mask_blend_pd(reduce, t, _mm512_div_pd(_mm512_sub_pd(t, one), _mm512_add_pd(t, one)));
+		const __m512d z = _mm512_mul_pd(u, u);
+		__m512d p = _mm512_set1_pd(atan_p[0]);
+		__m512d q = _mm512_add_pd(z, _mm512_set1_pd(atan_q[0]));
+		for (int k = 1; k < 5; ++k) {
+			p = _mm512_fmadd_pd(p, z, _mm512_set1_pd(atan_p[k]));
+			q = _mm512_fmadd_pd(q, z, _mm512_set1_pd(atan_q[k]));
+		}
+		__m512d r = _mm512_fmadd_pd(u, _mm512_div_pd(_mm512_mul_pd(z, p), q), u);
+		r = _mm512_mask_blend_pd(reduce, r, _mm512_add_pd(_mm512_set1_pd(quarter_pi), _mm512_add_pd(r, _mm512_set1_pd(quarter_pi_tail))));
+		r = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(ay, ax, _CMP_GT_OQ), r,
+			_mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(half_pi), r), _mm512_set1_pd(half_pi_tail)));
+		r = _mm512_mask_blend_pd(_mm512_test_epi64_mask(_mm512_castpd_si512(x), sign), r,
+			_mm512_add_pd(_mm512_sub_pd(_mm512_set1_pd(full_pi), r), _mm512_set1_pd(full_pi_tail)));
+		const __m512i signed_r = _mm512_or_si512(_mm512_castpd_si512(r), _mm512_and_si512(_mm512_castpd_si512(y), sign));
+		_mm512_storeu_pd(phase + i, _mm512_castsi512_pd(signed_r));
+	}
+	phase_scalar(re + i, im + i, n - i, phase + i);
+}
+
+ACS_TARGET("avx512f") void add_reactance_avx512_float(const float* f, std::size_t n, float a, float b, float* im) {
+	const __m512 va = _mm512_set1_ps(a);
+	const __m512 vb = _mm512_set1_ps(b);
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m512 vf = _mm512_loadu_ps(f + i);
+		__m512 acc = _mm512_loadu_ps(im + i);
+		acc = _mm512_fmadd_ps(va, vf, _mm512_add_ps(acc, _mm512_div_ps(vb, vf)));
+		_mm512_storeu_ps(im + i, acc);
+	}
+	add_reactance_scalar(f + i, n - i, a, b, im + i);
+}
+ACS_TARGET("avx512f") void add_scaled_avx512_float(const float* x, std::size_t n, float a, float* y) {
+	const __m512 va = _mm512_set1_ps(a);
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+	}
+	add_scaled_scalar(x + i, n - i, a, y + i);
+}
+ACS_TARGET("avx512f") void add_linear_avx512_float(const float* x, const float* y, std::size_t n, float a, float b, float* out) {
+	const __m512 va = _mm512_set1_ps(a);
+	const __m512 vb = _mm512_set1_ps(b);
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m512 acc = _mm512_fmadd_ps(vb, _mm512_loadu_ps(y + i), _mm512_loadu_ps(out + i));
+		_mm512_storeu_ps(out + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), acc));
+	}
+	add_linear_scalar(x + i, y + i, n - i, a, b, out + i);
+}
+ACS_TARGET("avx512f") void add_reciprocal_avx512_float(const float* zr, const float* zi, std::size_t n, float* re, float* im) {
+	const __m512 one = _mm512_set1_ps(1.0f);
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m512 vr = _mm512_loadu_ps(zr + i);
+		const __m512 vi = _mm512_loadu_ps(zi + i);
+		const __m512 inv = _mm512_div_ps(one, _mm512_fmadd_ps(vr, vr, _mm512_mul_ps(vi, vi)));
+		_mm512_storeu_ps(re + i, _mm512_fmadd_ps(vr, inv, _mm512_loadu_ps(re + i)));
+		_mm512_storeu_ps(im + i, _mm512_fnmadd_ps(vi, inv, _mm512_loadu_ps(im + i)));
+	}
+	add_reciprocal_scalar(zr + i, zi + i, n - i, re + i, im + i);
+}
+ACS_TARGET("avx512f") void invert_avx512_float(float* re, float* im, std::size_t n) {
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 minus_one = _mm512_set1_ps(-1.0f);
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m512 vr = _mm512_loadu_ps(re + i);
+		const __m512 vi = _mm512_loadu_ps(im + i);
+		const __m512 inv = _mm512_div_ps(one, _mm512_fmadd_ps(vr, vr, _mm512_mul_ps(vi, vi)));
+		_mm512_storeu_ps(re + i, _mm512_mul_ps(vr, inv));
+		_mm512_storeu_ps(im + i, _mm512_mul_ps(vi, _mm512_mul_ps(inv, minus_one)));
+	}
+	invert_scalar(re + i, im + i, n - i);
+}
+ACS_TARGET("avx512f") void magnitude_avx512_float(const float* re, const float* im, std::size_t n, float* mag) {
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m512 vr = _mm512_loadu_ps(re + i);
+		const __m512 vi = _mm512_loadu_ps(im + i);
+		_mm512_storeu_ps(mag + i, _mm512_sqrt_ps(_mm512_fmadd_ps(vr, vr, _mm512_mul_ps(vi, vi))));
+	}
+	magnitude_scalar(re + i, im + i, n - i, mag + i);
+}
+ACS_TARGET("avx512f") void phase_avx512_float(const float* re, const float* im, std::size_t n, float* phase) {
+	const __m512i sign = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 infinity = _mm512_set1_ps(std::numeric_limits<float>::infinity());
+	std::size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		const __m512 x = _mm512_loadu_ps(re + i);
+		const __m512 y = _mm512_loadu_ps(im + i);
+		const __m512 ax = _mm512_abs_ps(x);
+		const __m512 ay = _mm512_abs_ps(y);
+		const __m512 hi = _mm512_max_ps(ax, ay);
+		if ((_mm512_cmp_ps_mask(ax, infinity, _CMP_LT_OQ) & _mm512_cmp_ps_mask(ay, infinity, _CMP_LT_OQ)) != 0xffff) {
+			phase_scalar(re + i, im + i, 16, phase + i);
+			continue;
+		}
+		__m512 t = _mm512_div_ps(_mm512_min_ps(ax, ay), hi);
+		t = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(hi, zero, _CMP_EQ_OQ), t, zero);
+		const __mmask16 reduce = _mm512_cmp_ps_mask(t, _mm512_set1_ps(atanf_reduce), _CMP_GT_OQ);
+		const __m512 u = _mm512_mask_blend_ps(reduce, t, _mm512_div_ps(_mm512_sub_ps(t, one), _mm512_add_ps(t, one)));
+		const __m512 z = _mm512_mul_ps(u, u);
+		__m512 p = _mm512_set1_ps(atanf_p[0]);
+		for (int k = 1; k < 4; ++k) {
+			p = _mm512_fmadd_ps(p, z, _mm512_set1_ps(atanf_p[k]));
+		}
+		__m512 r = _mm512_fmadd_ps(_mm512_mul_ps(p, z), u, u);
+		r = _mm512_mask_blend_ps(reduce, r, _mm512_add_ps(r, _mm512_set1_ps(quarter_pi_float)));
+		r = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(ay, ax, _CMP_GT_OQ), r, _mm512_sub_ps(_mm512_set1_ps(half_pi_float), r));
+		r = _mm512_mask_blend_ps(_mm512_test_epi32_mask(_mm512_castps_si512(x), sign), r,
+			_mm512_sub_ps(_mm512_set1_ps(full_pi_float), r));
+		const __m512i signed_r = _mm512_or_si512(_mm512_castps_si512(r), _mm512_and_si512(_mm512_castps_si512(y), sign));
+		_mm512_storeu_ps(phase + i, _mm512_castsi512_ps(signed_r));
+	}
+	phase_scalar(re + i, im + i, n - i, phase + i);
+}
+
+// Runtime check for AVX2/FMA and AVX-512F, including OS support for the wider registers
+void detect_x86_features(bool& avx2, bool& avx512) {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int max_leaf = info[0];
+	__cpuid(info, 1);
+	const bool fma = (info[2] & (1 << 12)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	avx2 = false;
+	avx512 = false;
+	if (!osxsave || max_leaf < 7) {
+		return;
+	}
+	const unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	avx2 = fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+	avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+#else
+	__builtin_cpu_init();
+	avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	avx512 = __builtin_cpu_supports("avx512f");
+#endif
+}
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+void add_reactance_neon(const double* f, std::size_t n, double a, double b, double* im) {
+	const float64x2_t va = vdupq_n_f64(a);
+	const float64x2_t vb = vdupq_n_f64(b);
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const float64x2_t vf = vld1q_f64(f + i);
+		float64x2_t acc = vaddq_f64(vld1q_f64(im + i), vdivq_f64(vb, vf));
+		vst1q_f64(im + i, vfmaq_f64(acc, va, vf));
+	}
+	add_reactance_scalar(f + i, n - i, a, b, im + i);
+}
+void add_scaled_neon(const double* x, std::size_t n, double a, double* y) {
+	const float64x2_t va = vdupq_n_f64(a);
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		vst1q_f64(y + i, vfmaq_f64(vld1q_f64(y + i), va, vld1q_f64(x + i)));
+	}
+	add_scaled_scalar(x + i, n - i, a, y + i);
+}
+void add_linear_neon(const double* x, const double* y, std::size_t n, double a, double b, double* out) {
+	const float64x2_t va = vdupq_n_f64(a);
+	const float64x2_t vb = vdupq_n_f64(b);
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const float64x2_t acc = vfmaq_f64(vld1q_f64(out + i), vb, vld1q_f64(y + i));
+		vst1q_f64(out + i, vfmaq_f64(acc, va, vld1q_f64(x + i)));
+	}
+	add_linear_scalar(x + i, y + i, n - i, a, b, out + i);
+}
+void add_reciprocal_neon(const double* zr, const double* zi, std::size_t n, double* re, double* im) {
+	const float64x2_t one = vdupq_n_f64(1.0);
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const float64x2_t vr = vld1q_f64(zr + i);
+		const float64x2_t vi = vld1q_f64(zi + i);
+		const float64x2_t inv = vdivq_f64(one, vfmaq_f64(vmulq_f64(vi, vi), vr, vr));
+		vst1q_f64(re + i, vfmaq_f64(vld1q_f64(re + i), vr, inv));
+		vst1q_f64(im + i, vfmsq_f64(vld1q_f64(im + i), vi, inv));
+	}
+	add_reciprocal_scalar(zr + i, zi + i, n - i, re + i, im + i);
+}
+void invert_neon(double* re, double* im, std::size_t n) {
+	const float64x2_t one = vdupq_n_f64(1.0);
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const float64x2_t vr = vld1q_f64(re + i);
+		const float64x2_t vi = vld1q_f64(im + i);
+		const float64x2_t inv = vdivq_f64(one, vfmaq_f64(vmulq_f64(vi, vi), vr, vr));
+		vst1q_f64(re + i, vmulq_f64(vr, inv));
+		vst1q_f64(im + i, vnegq_f64(vmulq_f64(vi, inv)));
+	}
+	invert_scalar(re + i, im + i, n - i);
+}
+void magnitude_neon(const double* re, const double* im, std::size_t n, double* mag) {
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const float64x2_t vr = vld1q_f64(re + i);
+		const float64x2_t vi = vld1q_f64(im + i);
+		vst1q_f64(mag + i, vsqrtq_f64(vfmaq_f64(vmulq_f64(vi, vi), vr, vr)));
+	}
+	magnitude_scalar(re + i, im + i, n - i, mag + i);
+}
+void phase_neon(const double* re, const double* im, std::size_t n, double* phase) {
+	const uint64x2_t sign = vdupq_n_u64(0x8000000000000000ull);
+	const float64x2_t zero = vdupq_n_f64(0.0);
+	const float64x2_t one = vdupq_n_f64(1.0);
+	const float64x2_t infinity = vdupq_n_f64(std::numeric_limits<double>::infinity());
+	std::size_t i = 0;
+	for (; i + 2 <= n; i += 2) {
+		const float64x2_t x = vld1q_f64(re + i);
+		const float64x2_t y = vld1q_f64(im + i);
+		const float64x2_t ax = vabsq_f64(x);
+		const float64x2_t ay = vabsq_f64(y);
+		const float64x2_t hi = vmaxq_f64(ax, ay);
+		const uint64x2_t finite = vandq_u64(vcltq_f64(ax, infinity), vcltq_f64(ay, infinity));
+		if ((vgetq_lane_u64(finite, 0) & vgetq_lane_u64(finite, 1)) == 0) {
+			phase_scalar(re + i, im + i, 2, phase + i);
+			continue;
+		}
+		float64x2_t t = vdivq_f64(vminq_f64(ax, ay), hi);
+		t = vbslq_f64(vceqq_f64(hi, zero), zero, t);
+		const uint64x2_t reduce = vcgtq_f64(t, vdupq_n_f64(0.66));
+		const float64x2_t u = vbslq_f64(reduce, vdivq_f64(vsubq_f64(t, one), vaddq_f64(t, one)), t);
+		const float64x2_t z = vmulq_f64(u, u);
+		float64x2_t p = vdupq_n_f64(atan_p[0]);
+		float64x2_t q = vaddq_f64(z, vdupq_n_f64(atan_q[0]));
+		for (int k = 1; k < 5; ++k) {
+			p = vfmaq_f64(vdupq_n_f64(atan_p[k]), p, z);
+			q = vfmaq_f64(vdupq_n_f64(atan_q[k]), q, z);
+		}
+		float64x2_t r = vfmaq_f64(u, u, vdivq_f64(vmulq_f64(z, p), q));
+		r = vbslq_f64(reduce, vaddq_f64(vdupq_n_f64(quarter_pi), vaddq_f64(r, vdupq_n_f64(quarter_pi_tail))), r);
+		r = vbslq_f64(vcgtq_f64(ay, ax), vaddq_f64(vsubq_f64(vdupq_n_f64(half_pi), r), vdupq_n_f64(half_pi_tail)), r);
+		r = vbslq_f64(vtstq_u64(vreinterpretq_u64_f64(x), sign),
+			vaddq_f64(vsubq_f64(vdupq_n_f64(full_pi), r), vdupq_n_f64(full_pi_tail)), r);
+		vst1q_f64(phase + i, vreinterpretq_f64_u64(vorrq_u64(vreinterpretq_u64_f64(r), vandq_u64(vreinterpretq_u64_f64(y), sign))));
+	}
+	phase_scalar(re + i, im + i, n - i, phase + i);
+}
+
+void add_reactance_neon_float(const float* f, std::size_t n, float a, float b, float* im) {
+	const float32x4_t va = vdupq_n_f32(a);
+	const float32x4_t vb = vdupq_n_f32(b);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t vf = vld1q_f32(f + i);
+		float32x4_t acc = vaddq_f32(vld1q_f32(im + i), vdivq_f32(vb, vf));
+		vst1q_f32(im + i, vfmaq_f32(acc, va, vf));
+	}
+	add_reactance_scalar(f + i, n - i, a, b, im + i);
+}
+void add_scaled_neon_float(const float* x, std::size_t n, float a, float* y) {
+	const float32x4_t va = vdupq_n_f32(a);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(y + i, vfmaq_f32(vld1q_f32(y + i), va, vld1q_f32(x + i)));
+	}
+	add_scaled_scalar(x + i, n - i, a, y + i);
+}
+void add_linear_neon_float(const float* x, const float* y, std::size_t n, float a, float b, float* out) {
+	const float32x4_t va = vdupq_n_f32(a);
+	const float32x4_t vb = vdupq_n_f32(b);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t acc = vfmaq_f32(vld1q_f32(out + i), vb, vld1q_f32(y + i));
+		vst1q_f32(out + i, vfmaq_f32(acc, va, vld1q_f32(x + i)));
+	}
+	add_linear_scalar(x + i, y + i, n - i, a, b, out + i);
+}
+void add_reciprocal_neon_float(const float* zr, const float* zi, std::size_t n, float* re, float* im) {
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t vr = vld1q_f32(zr + i);
+		const float32x4_t vi = vld1q_f32(zi + i);
+		const float32x4_t inv = vdivq_f32(one, vfmaq_f32(vmulq_f32(vi, vi), vr, vr));
+		vst1q_f32(re + i, vfmaq_f32(vld1q_f32(re + i), vr, inv));
+		vst1q_f32(im + i, vfmsq_f32(vld1q_f32(im + i), vi, inv));
+	}
+	add_reciprocal_scalar(zr + i, zi + i, n - i, re + i, im + i);
+}
+void invert_neon_float(float* re, float* im, std::size_t n) {
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t vr = vld1q_f32(re + i);
+		const float32x4_t vi = vld1q_f32(im + i);
+		const float32x4_t inv = vdivq_f32(one, vfmaq_f32(vmulq_f32(vi, vi), vr, vr));
+		vst1q_f32(re + i, vmulq_f32(vr, inv));
+		vst1q_f32(im + i, vnegq_f32(vmulq_f32(vi, inv)));
+	}
+	invert_scalar(re + i, im + i, n - i);
+}
+void magnitude_neon_float(const float* re, const float* im, std::size_t n, float* mag) {
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t vr = vld1q_f32(re + i);
+		const float32x4_t vi = vld1q_f32(im + i);
+		vst1q_f32(mag + i, vsqrtq_f32(vfmaq_f32(vmulq_f32(vi, vi), vr, vr)));
+	}
+	magnitude_scalar(re + i, im + i, n - i, mag + i);
+}
+void phase_neon_float(const float* re, const float* im, std::size_t n, float* phase) {
+	const uint32x4_t sign = vdupq_n_u32(0x80000000u);
+	const float32x4_t zero = vdupq_n_f32(0.0f);
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	const float32x4_t infinity = vdupq_n_f32(std::numeric_limits<float>::infinity());
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t x = vld1q_f32(re + i);
+		const float32x4_t y = vld1q_f32(im + i);
+		const float32x4_t ax = vabsq_f32(x);
+		const float32x4_t ay = vabsq_f32(y);
+		const float32x4_t hi = vmaxq_f32(ax, ay);
+		const uint32x4_t finite = vandq_u32(vcltq_f32(ax, infinity), vcltq_f32(ay, infinity));
+		if (vminvq_u32(finite) == 0) {
+			phase_scalar(re + i, im + i, 4, phase + i);
+			continue;
+		}
+		float32x4_t t = vdivq_f32(vminq_f32(ax, ay), hi);
+		t = vbslq_f32(vceqq_f32(hi, zero), zero, t);
+		const uint32x4_t reduce = vcgtq_f32(t, vdupq_n_f32(atanf_reduce));
+		const float32x4_t u = vbslq_f32(reduce, vdivq_f32(vsubq_f32(t, one), vaddq_f32(t, one)), t);
+		const float32x4_t z = vmulq_f32(u, u);
+		float32x4_t p = vdupq_n_f32(atanf_p[0]);
+		for (int k = 1; k < 4; ++k) {
+			p = vfmaq_f32(vdupq_n_f32(atanf_p[k]), p, z);
+		}
+		float32x4_t r = vfmaq_f32(u, u, vmulq_f32(p, z));
+		r = vbslq_f32(reduce, vaddq_f32(r, vdupq_n_f32(quarter_pi_float)), r);
+		r = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(half_pi_float), r), r);
+		r = vbslq_f32(vtstq_u32(vreinterpretq_u32_f32(x), sign), vsubq_f32(vdupq_n_f32(full_pi_float), r), r);
+		vst1q_f32(phase + i, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(r), vandq_u32(vreinterpretq_u32_f32(y), sign))));
+	}
+	phase_scalar(re + i, im + i, n - i, phase + i);
+}
+#endif
+
+}
+
+template <>
+const std::vector<basic_sweep_kernels<double>>& get_available_sweep_kernels<double>() {
+	static const std::vector<sweep_kernels> available = [] {
+		std::vector<sweep_kernels> k;
+		k.push_back({ add_reactance_scalar, add_scaled_scalar, add_linear_scalar, add_reciprocal_scalar, invert_scalar, magnitude_scalar, phase_scalar, "scalar" });
+#if defined(__x86_64__) || defined(_M_X64)
+		bool avx2 = false;
+		bool avx512 = false;
+		detect_x86_features(avx2, avx512);
+		if (avx2) {
+			k.push_back({ add_reactance_avx2, add_scaled_avx2, add_linear_avx2, add_reciprocal_avx2, invert_avx2, magnitude_avx2, phase_avx2, "avx2" });
+		}
+		if (avx512) {
+			k.push_back({ add_reactance_avx512, add_scaled_avx512, add_linear_avx512, add_reciprocal_avx512, invert_avx512, magnitude_avx512, phase_avx512, "avx512" });
+		}
+#elif defined(__aarch64__) || defined(_M_ARM64)
+		k.push_back({ add_reactance_neon, add_scaled_neon, add_linear_neon, add_reciprocal_neon, invert_neon, magnitude_neon, phase_neon, "neon" });
+#endif
+		return k;
+	}();
+	return available;
+}
+
+template <>
+const std::vector<basic_sweep_kernels<float>>& get_available_sweep_kernels<float>() {
+	static const std::vector<basic_sweep_kernels<float>> available = [] {
+		std::vector<basic_sweep_kernels<float>> k;
+		k.push_back({ add_reactance_scalar, add_scaled_scalar, add_linear_scalar, add_reciprocal_scalar, invert_scalar, magnitude_scalar, phase_scalar, "scalar" });
+#if defined(__x86_64__) || defined(_M_X64)
+		bool avx2 = false;
+		bool avx512 = false;
+		detect_x86_features(avx2, avx512);
+		if (avx2) {
+			k.push_back({ add_reactance_avx2_float, add_scaled_avx2_float, add_linear_avx2_float, add_reciprocal_avx2_float,
+				invert_avx2_float, magnitude_avx2_float, phase_avx2_float, "avx2" });
+		}
+		if (avx512) {
+			k.push_back({ add_reactance_avx512_float, add_scaled_avx512_float, add_linear_avx512_float, add_reciprocal_avx512_float,
+				invert_avx512_float, magnitude_avx512_float, phase_avx512_float, "avx512" });
+		}
+#elif defined(__aarch64__) || defined(_M_ARM64)
+		k.push_back({ add_reactance_neon_float, add_scaled_neon_float, add_linear_neon_float, add_reciprocal_neon_float,
+			invert_neon_float, magnitude_neon_float, phase_neon_float, "neon" });
+#endif
+		return k;
+	}();
+	return available;
+}
+
+// The widest set is the last one available
+template <>
+const basic_sweep_kernels<double>& get_sweep_kernels<double>() {
+	static const sweep_kernels kernels = get_available_sweep_kernels<double>().back();
+	return kernels;
+}
+
+template <>
+const basic_sweep_kernels<float>& get_sweep_kernels<float>() {
+	static const basic_sweep_kernels<float> kernels = get_available_sweep_kernels<float>().back();
+	return kernels;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// MXCSR flush-to-zero (bit 15) and denormals-are-zero (bit 6)
+scoped_flush_denormals::scoped_flush_denormals() : saved(_mm_getcsr()) {
+	_mm_setcsr(saved | 0x8040u);
+}
+scoped_flush_denormals::~scoped_flush_denormals() {
+	_mm_setcsr(saved);
+}
+#else
+scoped_flush_denormals::scoped_flush_denormals() : saved(0) {}
+scoped_flush_denormals::~scoped_flush_denormals() {}
+#endif
@@ -0,0 +1,18 @@
+﻿#include "acs/monte_carlo.h"
+
+void draw_sample(const std::vector<tolerance>& parameters, std::uint64_t seed, std::uint64_t sample, double* values) {
+	for (std::size_t j = 0; j < parameters.size(); ++j) {
+		const tolerance& t = parameters[j];
+		double deviation;
+		if (t.distribution == tolerance_distribution::uniform) {
+			deviation = 2.0 * counter_uniform(seed, sample, 2 * j) - 1.0;
+		}
+		else {
+			// Box-Muller, keeping the first uniform away from zero
+			const double u = 1.0 - counter_uniform(seed, sample, 2 * j);
+			const double v = counter_uniform(seed, sample, 2 * j + 1);
+			deviation = std::sqrt(-2.0 * std::log(u)) * std::cos(2 * pi * v) / 3.0;
+		}
+		values[j] = t.nominal * (1.0 + t.relative * deviation);
+	}
+}
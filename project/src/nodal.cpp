@@ -0,0 +1,320 @@
+﻿#include "acs/nodal.h"
+
+#include <queue>
+#include <type_traits>
+#include <utility>
+
+std::vector<std::size_t> minimum_degree_order(const sparse_pattern& pattern) {
+	const std::size_t n = pattern.n;
+	std::vector<std::vector<std::size_t>> vars(n);
+	std::vector<std::vector<std::size_t>> elems(n);
+	std::vector<std::vector<std::size_t>> members(n);
+	std::vector<char> eliminated(n, 0);
+	std::vector<char> absorbed(n, 0);
+	std::vector<std::size_t> degree(n);
+	std::vector<std::size_t> mark(n, 0);
+	std::size_t tag = 0;
+	using entry = std::pair<std::size_t, std::size_t>;
+	std::priority_queue<entry, std::vector<entry>, std::greater<entry>> heap;
+	for (std::size_t i = 0; i < n; ++i) {
+		for (std::size_t k = pattern.col_start[i]; k < pattern.col_start[i + 1]; ++k) {
+			if (pattern.row_index[k] != i) {
+				vars[i].push_back(pattern.row_index[k]);
+			}
+		}
+		degree[i] = vars[i].size();
+		heap.push({ degree[i], i });
+	}
+	std::vector<std::size_t> order;
+	order.reserve(n);
+	std::vector<std::size_t> boundary;
+	while (!heap.empty()) {
+		const entry top = heap.top();
+		heap.pop();
+		const std::size_t p = top.second;
+		if (eliminated[p] || top.first != degree[p]) {
+			continue;
+		}
+		// Variables adjacent to p directly or through the elements it touches
+		++tag;
+		mark[p] = tag;
+		boundary.clear();
+		for (std::size_t v : vars[p]) {
+			if (!eliminated[v] && mark[v] != tag) {
+				mark[v] = tag;
+				boundary.push_back(v);
+			}
+		}
+		for (std::size_t e : elems[p]) {
+			if (absorbed[e]) {
+				continue;
+			}
+			for (std::size_t v : members[e]) {
+				if (!eliminated[v] && mark[v] != tag) {
+					mark[v] = tag;
+					boundary.push_back(v);
+				}
+			}
+			// Element e is covered by the new element p
+			absorbed[e] = 1;
+			std::vector<std::size_t>().swap(members[e]);
+		}
+		eliminated[p] = 1;
+		order.push_back(p);
+		members[p] = boundary;
+		std::vector<std::size_t>().swap(vars[p]);
+		std::vector<std::size_t>().swap(elems[p]);
+		for (std::size_t i : boundary) {
+			elems[i].erase(std::remove_if(elems[i].begin(), elems[i].end(),
+				[&](std::size_t e) { return absorbed[e] != 0; }), elems[i].end());
+			elems[i].push_back(p);
+			// Edges between members of p are now implied by the element
+			vars[i].erase(std::remove_if(vars[i].begin(), vars[i].end(),
+				[&](std::size_t v) { return eliminated[v] || mark[v] == tag; }), vars[i].end());
+		}
+		for (std::size_t i : boundary) {
+			++tag;
+			mark[i] = tag;
+			std::size_t count = 0;
+			for (std::size_t v : vars[i]) {
+				if (mark[v] != tag) {
+					mark[v] = tag;
+					++count;
+				}
+			}
+			for (std::size_t e : elems[i]) {
+				std::vector<std::size_t>& m = members[e];
+				m.erase(std::remove_if(m.begin(), m.end(),
+					[&](std::size_t v) { return eliminated[v] != 0; }), m.end());
+				for (std::size_t v : m) {
+					if (mark[v] != tag) {
+						mark[v] = tag;
+						++count;
+					}
+				}
+			}
+			degree[i] = count;
+			heap.push({ count, i });
+		}
+	}
+	return order;
+}
+
+lu_symbolic analyse_lu(const sparse_pattern& pattern, const std::vector<std::size_t>& order) {
+	const std::size_t n = pattern.n;
+	const std::size_t none = std::numeric_limits<std::size_t>::max();
+	lu_symbolic s;
+	s.n = n;
+	s.perm = order;
+	s.inverse.assign(n, 0);
+	for (std::size_t k = 0; k < n; ++k) {
+		s.inverse[order[k]] = k;
+	}
+	// Elimination tree of the permuted matrix
+	std::vector<std::size_t> parent(n, none);
+	std::vector<std::size_t> ancestor(n, none);
+	for (std::size_t k = 0; k < n; ++k) {
+		const std::size_t col = order[k];
+		for (std::size_t p = pattern.col_start[col]; p < pattern.col_start[col + 1]; ++p) {
+			std::size_t i = s.inverse[pattern.row_index[p]];
+			while (i != none && i < k) {
+				const std::size_t next = ancestor[i];
+				ancestor[i] = k;
+				if (next == none) {
+					parent[i] = k;
+				}
+				i = next;
+			}
+		}
+	}
+	// Row k of L is the set of etree paths from the nonzeros left of the diagonal up to k
+	std::vector<std::size_t> mark(n, none);
+	s.l_start.assign(n + 1, 0);
+	std::vector<std::size_t> row;
+	for (std::size_t k = 0; k < n; ++k) {
+		row.clear();
+		mark[k] = k;
+		const std::size_t col = order[k];
+		for (std::size_t p = pattern.col_start[col]; p < pattern.col_start[col + 1]; ++p) {
+			std::size_t i = s.inverse[pattern.row_index[p]];
+			if (i > k) {
+				continue;
+			}
+			while (mark[i] != k) {
+				row.push_back(i);
+				mark[i] = k;
+				i = parent[i];
+			}
+		}
+		std::sort(row.begin(), row.end());
+		s.l_index.insert(s.l_index.end(), row.begin(), row.end());
+		s.l_start[k + 1] = s.l_index.size();
+	}
+	// Rows of U are the columns of L
+	std::vector<std::size_t> count(n, 1);
+	for (std::size_t i : s.l_index) {
+		++count[i];
+	}
+	s.u_start.assign(n + 1, 0);
+	for (std::size_t k = 0; k < n; ++k) {
+		s.u_start[k + 1] = s.u_start[k] + count[k];
+	}
+	s.u_index.assign(s.u_start[n], 0);
+	std::vector<std::size_t> fill(s.u_start.begin(), s.u_start.end() - 1);
+	for (std::size_t k = 0; k < n; ++k) {
+		s.u_index[fill[k]++] = k;
+	}
+	for (std::size_t j = 0; j < n; ++j) {
+		for (std::size_t p = s.l_start[j]; p < s.l_start[j + 1]; ++p) {
+			s.u_index[fill[s.l_index[p]]++] = j;
+		}
+	}
+	return s;
+}
+
+namespace {
+
+// Pattern of branches between pairs of nodes, where nodes_of(k) gives the
+// (from, to) nodes of branch k, plus the three-terminal devices
+template <typename NodesOf>
+nodal_pattern build_pattern(std::size_t node_count, std::size_t branch_count, NodesOf nodes_of,
+	const std::vector<netlist::device>& devices) {
+	const std::size_t none = std::numeric_limits<std::size_t>::max();
+	const std::size_t n = node_count - 1;
+	std::vector<std::vector<std::size_t>> columns(n);
+	for (std::size_t i = 0; i < n; ++i) {
+		columns[i].push_back(i);
+	}
+	for (std::size_t k = 0; k < branch_count; ++k) {
+		const std::pair<std::size_t, std::size_t> b = nodes_of(k);
+		if (b.first != netlist::ground && b.second != netlist::ground) {
+			columns[b.first - 1].push_back(b.second - 1);
+			columns[b.second - 1].push_back(b.first - 1);
+		}
+	}
+	for (const netlist::device& d : devices) {
+		const std::size_t terminals[3] = { d.collector, d.base, d.emitter };
+		for (std::size_t i : terminals) {
+			for (std::size_t j : terminals) {
+				if (i != netlist::ground && j != netlist::ground) {
+					columns[j - 1].push_back(i - 1);
+				}
+			}
+		}
+	}
+	nodal_pattern result;
+	sparse_pattern& p = result.pattern;
+	p.n = n;
+	p.col_start.assign(n + 1, 0);
+	for (std::size_t j = 0; j < n; ++j) {
+		std::vector<std::size_t>& c = columns[j];
+		std::sort(c.begin(), c.end());
+		c.erase(std::unique(c.begin(), c.end()), c.end());
+		p.row_index.insert(p.row_index.end(), c.begin(), c.end());
+		p.col_start[j + 1] = p.row_index.size();
+		std::vector<std::size_t>().swap(c);
+	}
+	p.build_transpose();
+	result.stamps.reserve(branch_count);
+	for (std::size_t k = 0; k < branch_count; ++k) {
+		const std::pair<std::size_t, std::size_t> b = nodes_of(k);
+		nodal_pattern::stamp s = { none, none, none, none };
+		if (b.first != netlist::ground) {
+			s.ff = p.find(b.first - 1, b.first - 1);
+		}
+		if (b.second != netlist::ground) {
+			s.tt = p.find(b.second - 1, b.second - 1);
+		}
+		if (b.first != netlist::ground && b.second != netlist::ground) {
+			s.ft = p.find(b.first - 1, b.second - 1);
+			s.tf = p.find(b.second - 1, b.first - 1);
+		}
+		result.stamps.push_back(s);
+	}
+	for (const netlist::device& d : devices) {
+		const std::size_t terminals[3] = { d.collector, d.base, d.emitter };
+		nodal_pattern::device_stamp s;
+		for (std::size_t i = 0; i < 3; ++i) {
+			for (std::size_t j = 0; j < 3; ++j) {
+				s.entry[i][j] = terminals[i] != netlist::ground && terminals[j] != netlist::ground ?
+					p.find(terminals[i] - 1, terminals[j] - 1) : none;
+			}
+		}
+		result.device_stamps.push_back(s);
+	}
+	return result;
+}
+
+}
+
+nodal_pattern build_nodal_pattern(const netlist& net) {
+	const std::vector<netlist::branch>& branches = net.get_branches();
+	return build_pattern(net.get_node_count(), branches.size(), [&](std::size_t k) {
+		return std::pair<std::size_t, std::size_t>(branches[k].from, branches[k].to);
+	}, net.get_devices());
+}
+
+nodal_pattern build_nodal_pattern(std::size_t node_count, const std::uint32_t* from, const std::uint32_t* to, std::size_t branch_count) {
+	return build_pattern(node_count, branch_count, [&](std::size_t k) {
+		return std::pair<std::size_t, std::size_t>(from[k], to[k]);
+	}, std::vector<netlist::device>());
+}
+
+void stamp_admittances(const netlist& net, const nodal_pattern& np, double f, std::vector<std::complex<double>>& values) {
+	ACS_TIMED(assemble);
+	values.assign(np.pattern.row_index.size(), 0.0);
+	const frequency_point point = frequency_point::at(f);
+	const std::vector<netlist::branch>& branches = net.get_branches();
+	for (std::size_t k = 0; k < branches.size(); ++k) {
+		stamp_branch(np.stamps[k], branches[k].part->admittance_at(point), values);
+	}
+	const std::vector<netlist::device>& devices = net.get_devices();
+	for (std::size_t k = 0; k < devices.size(); ++k) {
+		std::complex<double> y[3][3];
+		devices[k].part->admittance_matrix(point, y);
+		const nodal_pattern::device_stamp& s = np.device_stamps[k];
+		for (std::size_t i = 0; i < 3; ++i) {
+			for (std::size_t j = 0; j < 3; ++j) {
+				if (s.entry[i][j] != std::numeric_limits<std::size_t>::max()) {
+					values[s.entry[i][j]] += y[i][j];
+				}
+			}
+		}
+	}
+}
+
+std::vector<std::complex<double>> source_currents(const netlist& net, double f) {
+	std::vector<std::complex<double>> rhs(net.get_node_count() - 1, 0.0);
+	const frequency_point point = frequency_point::at(f);
+	for (const netlist::source& s : net.get_sources()) {
+		const std::complex<double> current = s.current_at(point);
+		if (s.to != netlist::ground) {
+			rhs[s.to - 1] += current;
+		}
+		if (s.from != netlist::ground) {
+			rhs[s.from - 1] -= current;
+		}
+	}
+	return rhs;
+}
+
+ac_solution make_ac_solution(const netlist& net, double f, const std::vector<std::complex<double>>& x) {
+	ac_solution result;
+	result.frequency = f;
+	result.node_voltages.assign(net.get_node_count(), 0.0);
+	std::copy(x.begin(), x.end(), result.node_voltages.begin() + 1);
+	const frequency_point point = frequency_point::at(f);
+	for (const netlist::branch& b : net.get_branches()) {
+		const std::complex<double> v = result.node_voltages[b.from] - result.node_voltages[b.to];
+		result.branch_currents.push_back(v * b.part->admittance_at(point));
+	}
+	return result;
+}
+
+ac_solution solve_ac(const netlist& net, double f) {
+	return prepared_netlist(net).solve(f);
+}
+
+std::complex<double> port_impedance(const netlist& net, std::size_t plus, std::size_t minus, double f) {
+	return prepared_netlist(net).port_impedance(plus, minus, f);
+}
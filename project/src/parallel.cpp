@@ -0,0 +1,35 @@
+﻿#include "acs/parallel.h"
+
+#include <cmath>
+#include <complex>
+
+sweep_result parallel_sweep(const circuit& c, const std::vector<double>& freqs, thread_pool& pool) {
+	sweep_result result;
+	result.frequency = freqs;
+	result.magnitude.resize(freqs.size());
+	result.phase.resize(freqs.size());
+	pool.parallel_for(freqs.size(), 4096, [&](std::size_t begin, std::size_t end, std::size_t) {
+		c.sweep(freqs.data() + begin, end - begin, result.magnitude.data() + begin, result.phase.data() + begin);
+	});
+	return result;
+}
+
+sweep_result parallel_sweep_port(const prepared_netlist& prepared, std::size_t plus, std::size_t minus,
+	const std::vector<double>& freqs, thread_pool& pool) {
+	sweep_result result;
+	result.frequency = freqs;
+	result.magnitude.resize(freqs.size());
+	result.phase.resize(freqs.size());
+	std::vector<nodal_workspace> workspaces(pool.size());
+	for (nodal_workspace& ws : workspaces) {
+		ws = prepared.make_workspace();
+	}
+	pool.parallel_for(freqs.size(), 1, [&](std::size_t begin, std::size_t end, std::size_t worker) {
+		for (std::size_t i = begin; i < end; ++i) {
+			const std::complex<double> z = prepared.port_impedance(plus, minus, freqs[i], workspaces[worker]);
+			result.magnitude[i] = std::abs(z);
+			result.phase[i] = std::arg(z);
+		}
+	});
+	return result;
+}
@@ -0,0 +1,628 @@
+﻿#include "acs/reduction.h"
+#include "acs/stream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace {
+
+// Dense LU with partial pivoting of a row-major n x n matrix, in place
+struct dense_lu
+{
+	std::size_t n;
+	std::vector<double> a;
+	std::vector<std::size_t> pivot;
+
+	dense_lu(std::vector<double> values, std::size_t size) : n(size), a(std::move(values)), pivot(size) {
+		for (std::size_t k = 0; k < n; ++k) {
+			std::size_t p = k;
+			for (std::size_t i = k + 1; i < n; ++i) {
+				if (std::abs(a[i * n + k]) > std::abs(a[p * n + k])) {
+					p = i;
+				}
+			}
+			pivot[k] = p;
+			if (a[p * n + k] == 0.0) {
+				throw std::runtime_error("Error: Reduced model is singular at the expansion point.");
+			}
+			// The multipliers stay where they were made, so solve() can apply the swaps
+			// and the eliminations in the same order
+			if (p != k) {
+				std::swap_ranges(a.begin() + k * n + k, a.begin() + (k + 1) * n, a.begin() + p * n + k);
+			}
+			for (std::size_t i = k + 1; i < n; ++i) {
+				const double m = a[i * n + k] / a[k * n + k];
+				a[i * n + k] = m;
+				for (std::size_t j = k + 1; j < n; ++j) {
+					a[i * n + j] -= m * a[k * n + j];
+				}
+			}
+		}
+	}
+	// Solve in place for the columns of a row-major n x m matrix
+	void solve(std::vector<double>& x, std::size_t m) const {
+		for (std::size_t k = 0; k < n; ++k) {
+			if (pivot[k] != k) {
+				std::swap_ranges(x.begin() + k * m, x.begin() + (k + 1) * m, x.begin() + pivot[k] * m);
+			}
+			for (std::size_t i = k + 1; i < n; ++i) {
+				for (std::size_t j = 0; j < m; ++j) {
+					x[i * m + j] -= a[i * n + k] * x[k * m + j];
+				}
+			}
+		}
+		for (std::size_t k = n; k-- > 0;) {
+			for (std::size_t j = 0; j < m; ++j) {
+				double sum = x[k * m + j];
+				for (std::size_t i = k + 1; i < n; ++i) {
+					sum -= a[k * n + i] * x[i * m + j];
+				}
+				x[k * m + j] = sum / a[k * n + k];
+			}
+		}
+	}
+};
+
+// Householder reduction of a row-major n x n matrix to upper Hessenberg form
+// h = Q^T a Q, in place, with the orthogonal Q returned
+std::vector<double> reduce_to_hessenberg(std::vector<double>& a, std::size_t n) {
+	std::vector<double> q(n * n, 0.0);
+	for (std::size_t i = 0; i < n; ++i) {
+		q[i * n + i] = 1.0;
+	}
+	std::vector<double> v(n);
+	for (std::size_t k = 0; k + 2 < n; ++k) {
+		double alpha = 0.0;
+		for (std::size_t i = k + 1; i < n; ++i) {
+			alpha += a[i * n + k] * a[i * n + k];
+		}
+		alpha = std::sqrt(alpha);
+		if (alpha == 0.0) {
+			continue;
+		}
+		if (a[(k + 1) * n + k] > 0) {
+			alpha = -alpha;
+		}
+		double scale = 0.0;
+		for (std::size_t i = k + 1; i < n; ++i) {
+			v[i] = a[i * n + k] - (i == k + 1 ? alpha : 0.0);
+			scale += v[i] * v[i];
+		}
+		scale = 2.0 / scale;
+		// a = P a P and Q = Q P, with P = I - scale v v^T on rows and columns k + 1 ..
+		for (std::size_t j = k; j < n; ++j) {
+			double s = 0.0;
+			for (std::size_t i = k + 1; i < n; ++i) {
+				s += v[i] * a[i * n + j];
+			}
+			s *= scale;
+			for (std::size_t i = k + 1; i < n; ++i) {
+				a[i * n + j] -= s * v[i];
+			}
+		}
+		for (std::vector<double>* m : { &a, &q }) {
+			for (std::size_t i = 0; i < n; ++i) {
+				double* row = m->data() + i * n;
+				double s = 0.0;
+				for (std::size_t j = k + 1; j < n; ++j) {
+					s += row[j] * v[j];
+				}
+				s *= scale;
+				for (std::size_t j = k + 1; j < n; ++j) {
+					row[j] -= s * v[j];
+				}
+			}
+		}
+		for (std::size_t i = k + 2; i < n; ++i) {
+			a[i * n + k] = 0.0;
+		}
+	}
+	return q;
+}
+
+double dot(const std::vector<double>& x, const std::vector<double>& y) {
+	double sum = 0.0;
+	for (std::size_t i = 0; i < x.size(); ++i) {
+		sum += x[i] * y[i];
+	}
+	return sum;
+}
+
+// Resistor, capacitor or inductor between two nodes
+struct rlc_branch
+{
+	std::uint32_t from;
+	std::uint32_t to;
+	double value;
+};
+
+// The network as (G + sC) x = B u: the non-ground node voltages followed by one
+// current per inductor. Solving with G + s C for a real s eliminates the inductor
+// currents, which leaves the nodal admittance matrix at s with every inductor as
+// a conductance 1 / (s L), a real symmetric matrix whose pattern is the nodal one.
+// That matrix is factored once for each expansion point.
+class mna_system
+{
+private:
+	std::size_t nodes;
+	std::vector<rlc_branch> resistors;
+	std::vector<rlc_branch> capacitors;
+	std::vector<rlc_branch> inductors;
+	// Stamp of every resistor, capacitor and inductor, in the same order
+	std::vector<const nodal_pattern::stamp*> resistor_stamps;
+	std::vector<const nodal_pattern::stamp*> capacitor_stamps;
+	std::vector<const nodal_pattern::stamp*> inductor_stamps;
+	nodal_pattern np;
+	lu_symbolic symbolic;
+	std::vector<double> expansions;
+	// G + s C and its factors at each expansion point
+	std::vector<std::vector<double>> matrices;
+	std::vector<lu_numeric<double>> factors;
+	std::vector<double> rhs;
+
+	// Add y's value at the branch's two nodes: +d at 'from' and -d at 'to'
+	static void scatter(const rlc_branch& b, double d, double* y) {
+		if (b.from != netlist::ground) {
+			y[b.from - 1] += d;
+		}
+		if (b.to != netlist::ground) {
+			y[b.to - 1] -= d;
+		}
+	}
+	static double across(const rlc_branch& b, const double* x) {
+		return (b.from != netlist::ground ? x[b.from - 1] : 0.0) - (b.to != netlist::ground ? x[b.to - 1] : 0.0);
+	}
+public:
+	mna_system(std::size_t node_count, std::size_t branch_count, const std::uint8_t* kinds, const double* values,
+		const std::uint32_t* from, const std::uint32_t* to) :
+		nodes(node_count - 1), np(build_nodal_pattern(node_count, from, to, branch_count)) {
+		for (std::size_t k = 0; k < branch_count; ++k) {
+			const rlc_branch b = { from[k], to[k], values[k] };
+			switch (static_cast<component_kind>(kinds[k])) {
+			case component_kind::resistor:
+				resistors.push_back(b);
+				resistor_stamps.push_back(&np.stamps[k]);
+				break;
+			case component_kind::capacitor:
+				capacitors.push_back(b);
+				capacitor_stamps.push_back(&np.stamps[k]);
+				break;
+			case component_kind::inductor:
+				inductors.push_back(b);
+				inductor_stamps.push_back(&np.stamps[k]);
+				break;
+			default:
+				throw std::invalid_argument("Error: Only resistors, capacitors and inductors can be reduced.");
+			}
+		}
+		symbolic = analyse_lu(np.pattern, minimum_degree_order(np.pattern));
+	}
+	std::size_t size() const {
+		return nodes + inductors.size();
+	}
+	// Factor G + s C for another expansion point, returning its index
+	std::size_t add_expansion(double s) {
+		matrices.emplace_back(np.pattern.row_index.size(), 0.0);
+		std::vector<double>& y = matrices.back();
+		for (std::size_t k = 0; k < resistors.size(); ++k) {
+			stamp_branch(*resistor_stamps[k], 1.0 / resistors[k].value, y);
+		}
+		for (std::size_t k = 0; k < capacitors.size(); ++k) {
+			stamp_branch(*capacitor_stamps[k], s * capacitors[k].value, y);
+		}
+		for (std::size_t k = 0; k < inductors.size(); ++k) {
+			stamp_branch(*inductor_stamps[k], 1.0 / (s * inductors[k].value), y);
+		}
+		expansions.push_back(s);
+		factors.emplace_back();
+		factor_lu(np.pattern, y, symbolic, factors.back());
+		return factors.size() - 1;
+	}
+	// x = (G + s C)^-1 x at one of the expansion points
+	void solve(std::size_t point, std::vector<double>& x) {
+		const double s = expansions[point];
+		rhs.assign(x.begin(), x.begin() + nodes);
+		const double* currents = x.data() + nodes;
+		for (std::size_t j = 0; j < inductors.size(); ++j) {
+			scatter(inductors[j], -currents[j] / (s * inductors[j].value), rhs.data());
+		}
+		solve_lu_refined(np.pattern, matrices[point], symbolic, factors[point], rhs);
+		for (std::size_t j = 0; j < inductors.size(); ++j) {
+			x[nodes + j] = (currents[j] + across(inductors[j], rhs.data())) / (s * inductors[j].value);
+		}
+		std::copy(rhs.begin(), rhs.end(), x.begin());
+	}
+	// G x: the resistor conductances, the inductor currents leaving 'from' and
+	// each inductor's equation -(v_from - v_to) + sL i = 0
+	std::vector<double> apply_g(const std::vector<double>& x) const {
+		std::vector<double> y(size(), 0.0);
+		for (const rlc_branch& b : resistors) {
+			scatter(b, across(b, x.data()) / b.value, y.data());
+		}
+		for (std::size_t j = 0; j < inductors.size(); ++j) {
+			scatter(inductors[j], x[nodes + j], y.data());
+			y[nodes + j] = -across(inductors[j], x.data());
+		}
+		return y;
+	}
+	// G^T x, which is G with the signs of the inductor rows and columns changed
+	std::vector<double> apply_g_transpose(const std::vector<double>& x) const {
+		std::vector<double> y(size(), 0.0);
+		for (const rlc_branch& b : resistors) {
+			scatter(b, across(b, x.data()) / b.value, y.data());
+		}
+		for (std::size_t j = 0; j < inductors.size(); ++j) {
+			scatter(inductors[j], -x[nodes + j], y.data());
+			y[nodes + j] = across(inductors[j], x.data());
+		}
+		return y;
+	}
+	// C x: the capacitances, then L times each inductor current
+	std::vector<double> apply_c(const std::vector<double>& x) const {
+		std::vector<double> y(size(), 0.0);
+		for (const rlc_branch& b : capacitors) {
+			scatter(b, b.value * across(b, x.data()), y.data());
+		}
+		for (std::size_t j = 0; j < inductors.size(); ++j) {
+			y[nodes + j] = inductors[j].value * x[nodes + j];
+		}
+		return y;
+	}
+	// Column of B for a port: 1 A into 'plus' and out of 'minus'
+	std::vector<double> port_vector(const netlist_port& p) const {
+		std::vector<double> x(size(), 0.0);
+		if (p.plus != netlist::ground) {
+			x[p.plus - 1] += 1.0;
+		}
+		if (p.minus != netlist::ground) {
+			x[p.minus - 1] -= 1.0;
+		}
+		return x;
+	}
+	// Port voltage b^T x
+	static double port_voltage(const netlist_port& p, const std::vector<double>& x) {
+		return (p.plus != netlist::ground ? x[p.plus - 1] : 0.0) - (p.minus != netlist::ground ? x[p.minus - 1] : 0.0);
+	}
+};
+
+// Largest change of the port impedances between two models over the check points,
+// relative to the largest impedance at each point
+double relative_change(const reduced_model& a, const reduced_model& b, const std::vector<double>& freqs) {
+	double change = 0.0;
+	for (double f : freqs) {
+		const std::vector<std::complex<double>> za = a.impedance_matrix(f);
+		const std::vector<std::complex<double>> zb = b.impedance_matrix(f);
+		double difference = 0.0;
+		double scale = 0.0;
+		for (std::size_t i = 0; i < za.size(); ++i) {
+			difference = std::max(difference, std::abs(za[i] - zb[i]));
+			scale = std::max(scale, std::abs(za[i]));
+		}
+		if (scale > 0) {
+			change = std::max(change, difference / scale);
+		}
+	}
+	return change;
+}
+
+// Block Arnoldi on (G + s C)^-1 C from (G + s C)^-1 B, taking a block of moments
+// about each expansion point in turn into one basis and projecting G, C and B onto
+// it as it grows. Columns that are (nearly) in the span of the basis already are
+// dropped; a point is finished when a whole block of it is, and the model is
+// exact when every point is.
+reduced_model reduce_branches(std::size_t node_count, std::size_t branch_count, const std::uint8_t* kinds,
+	const double* values, const std::uint32_t* from, const std::uint32_t* to,
+	const std::vector<netlist_port>& ports, const reduction_options& options) {
+	if (!(options.f_min > 0) || !(options.f_max >= options.f_min) || !std::isfinite(options.f_max)) {
+		throw std::invalid_argument("Error: Reduction band must be positive and in increasing order.");
+	}
+	if (!(options.tolerance > 0) || (options.order == 0 && options.max_order == 0)) {
+		throw std::invalid_argument("Error: Reduction needs a positive tolerance and order.");
+	}
+	if (ports.empty()) {
+		throw std::invalid_argument("Error: Reduction needs at least one port.");
+	}
+	for (const netlist_port& p : ports) {
+		if (p.plus >= node_count || p.minus >= node_count || p.plus == p.minus) {
+			throw std::out_of_range("Error: Port nodes must be two different nodes of the netlist.");
+		}
+	}
+	mna_system system(node_count, branch_count, kinds, values, from, to);
+	const double decades = std::log10(options.f_max / options.f_min);
+	const std::size_t point_count = options.expansion_points > 0 ? options.expansion_points
+		: std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(decades - 1e-9)));
+	// Points at the middles of equal log-spaced parts of the band
+	for (std::size_t i = 0; i < point_count; ++i) {
+		const double f = options.f_min * std::pow(10.0, decades * (i + 0.5) / point_count);
+		system.add_expansion(2 * pi * f);
+	}
+	const double f0 = std::sqrt(options.f_min * options.f_max);
+	const std::size_t limit = std::min(options.order > 0 ? options.order : options.max_order, system.size());
+	const std::size_t p = ports.size();
+	std::vector<double> check(16);
+	frequency_grid(options.f_min, options.f_max, check.size()).fill(0, check.size(), check.data());
+
+	std::vector<std::vector<double>> basis;
+	std::vector<std::vector<double>> c_basis;
+	// Projections, grown a row and column per basis vector
+	std::vector<std::vector<double>> gr;
+	std::vector<std::vector<double>> cr;
+	std::vector<std::vector<double>> br;
+	auto add_column = [&](std::vector<double> w) {
+		const double before = std::sqrt(dot(w, w));
+		// Modified Gram-Schmidt, repeated once if it cancelled most of the column, keeps
+		// the basis orthogonal to working precision
+		double after = before;
+		for (int pass = 0; pass < 2; ++pass) {
+			const double start = after;
+			for (const std::vector<double>& v : basis) {
+				const double r = dot(v, w);
+				for (std::size_t i = 0; i < w.size(); ++i) {
+					w[i] -= r * v[i];
+				}
+			}
+			after = std::sqrt(dot(w, w));
+			if (after > 0.5 * start) {
+				break;
+			}
+		}
+		if (!(after > 1e-10 * before)) {
+			return false;
+		}
+		for (double& x : w) {
+			x /= after;
+		}
+		const std::vector<double> gw = system.apply_g(w);
+		const std::vector<double> gtw = system.apply_g_transpose(w);
+		c_basis.push_back(system.apply_c(w));
+		basis.push_back(std::move(w));
+		const std::size_t k = basis.size() - 1;
+		gr.emplace_back(k + 1);
+		cr.emplace_back(k + 1);
+		for (std::size_t i = 0; i <= k; ++i) {
+			gr[i].resize(k + 1);
+			cr[i].resize(k + 1);
+			gr[i][k] = dot(basis[i], gw);
+			gr[k][i] = dot(gtw, basis[i]);
+			cr[i][k] = dot(basis[i], c_basis[k]);
+			cr[k][i] = cr[i][k];
+		}
+		br.emplace_back(p);
+		for (std::size_t j = 0; j < p; ++j) {
+			br[k][j] = mna_system::port_voltage(ports[j], basis[k]);
+		}
+		return true;
+	};
+	// Model from the leading states of the basis, itself a PRIMA model
+	auto make_model = [&](std::size_t r, double error) {
+		std::vector<double> g(r * r);
+		std::vector<double> c(r * r);
+		std::vector<double> b(r * p);
+		for (std::size_t i = 0; i < r; ++i) {
+			std::copy(gr[i].begin(), gr[i].begin() + r, g.begin() + i * r);
+			std::copy(cr[i].begin(), cr[i].begin() + r, c.begin() + i * r);
+			std::copy(br[i].begin(), br[i].end(), b.begin() + i * p);
+		}
+		return reduced_model(p, f0, std::move(g), std::move(c), std::move(b), error);
+	};
+
+	// Next block of each point, empty once the point is finished
+	std::vector<std::vector<std::vector<double>>> blocks(point_count);
+	for (std::size_t i = 0; i < point_count; ++i) {
+		for (const netlist_port& port : ports) {
+			blocks[i].push_back(system.port_vector(port));
+			system.solve(i, blocks[i].back());
+		}
+	}
+	// The model is checked against the last one each time the basis grows by a
+	// quarter, so building models costs a few times the final one
+	reduced_model checked;
+	reduced_model model;
+	bool exhausted = false;
+	for (;;) {
+		bool added = false;
+		for (std::size_t i = 0; i < point_count && basis.size() < limit; ++i) {
+			const std::size_t block_start = basis.size();
+			for (std::vector<double>& w : blocks[i]) {
+				if (basis.size() == limit) {
+					break;
+				}
+				add_column(std::move(w));
+			}
+			blocks[i].clear();
+			for (std::size_t k = block_start; k < basis.size(); ++k) {
+				blocks[i].push_back(c_basis[k]);
+				system.solve(i, blocks[i].back());
+			}
+			added = added || basis.size() > block_start;
+		}
+		exhausted = !added && basis.size() < limit;
+		const std::size_t r = basis.size();
+		if (r == 0) {
+			throw std::runtime_error("Error: The ports see no part of the netlist.");
+		}
+		const bool last = exhausted || r == limit;
+		if (checked.get_order() > 0 && 4 * r < 5 * checked.get_order() && !last) {
+			continue;
+		}
+		if (exhausted) {
+			// The Krylov spaces are exhausted, so the model is exact
+			model = make_model(r, 0.0);
+			break;
+		}
+		model = make_model(r, std::numeric_limits<double>::infinity());
+		if (checked.get_order() > 0) {
+			model = make_model(r, relative_change(model, checked, check));
+		}
+		if (last || (options.order == 0 && model.get_estimated_error() < options.tolerance)) {
+			break;
+		}
+		checked = model;
+	}
+	return model;
+}
+}
+
+reduced_model::reduced_model(std::size_t port_count, double expansion_frequency, std::vector<double> g_values,
+	std::vector<double> c_values, std::vector<double> b_values, double error) :
+	ports(port_count), states(b_values.size() / std::max<std::size_t>(port_count, 1)), s0(2 * pi * expansion_frequency),
+	g(std::move(g_values)), c(std::move(c_values)), b(std::move(b_values)), estimated_error(error) {
+	if (g.size() != states * states || c.size() != states * states || b.size() != states * ports) {
+		throw std::invalid_argument("Error: Reduced model matrices do not match in size.");
+	}
+	std::vector<double> m(states * states);
+	for (std::size_t i = 0; i < m.size(); ++i) {
+		m[i] = g[i] + s0 * c[i];
+	}
+	const dense_lu lu(std::move(m), states);
+	h = c;
+	lu.solve(h, states);
+	std::vector<double> mb = b;
+	lu.solve(mb, ports);
+	const std::vector<double> q = reduce_to_hessenberg(h, states);
+	left.assign(states * ports, 0.0);
+	right.assign(states * ports, 0.0);
+	for (std::size_t k = 0; k < states; ++k) {
+		for (std::size_t i = 0; i < states; ++i) {
+			for (std::size_t j = 0; j < ports; ++j) {
+				left[k * ports + j] += q[i * states + k] * b[i * ports + j];
+				right[k * ports + j] += q[i * states + k] * mb[i * ports + j];
+			}
+		}
+	}
+}
+
+// Gaussian elimination down the subdiagonal, swapping with the next row when that
+// gives the larger pivot
+void reduced_model::factor(std::complex<double> sigma, std::vector<std::complex<double>>& t, std::vector<char>& swapped) const {
+	const std::size_t n = states;
+	t.assign(n * n, 0.0);
+	swapped.assign(n, 0);
+	for (std::size_t i = 0; i < n; ++i) {
+		for (std::size_t j = i > 0 ? i - 1 : 0; j < n; ++j) {
+			t[i * n + j] = sigma * h[i * n + j];
+		}
+		t[i * n + i] += 1.0;
+	}
+	for (std::size_t k = 0; k + 1 < n; ++k) {
+		std::complex<double>* row = t.data() + k * n;
+		std::complex<double>* below = row + n;
+		if (std::abs(below[k]) > std::abs(row[k])) {
+			std::swap_ranges(row + k, row + n, below + k);
+			swapped[k] = 1;
+		}
+		if (row[k] == 0.0) {
+			throw std::runtime_error("Error: Reduced model is singular at this frequency.");
+		}
+		const std::complex<double> m = below[k] / row[k];
+		below[k] = m;
+		for (std::size_t j = k + 1; j < n; ++j) {
+			below[j] -= m * row[j];
+		}
+	}
+	if (n > 0 && t[n * n - 1] == 0.0) {
+		throw std::runtime_error("Error: Reduced model is singular at this frequency.");
+	}
+}
+
+std::complex<double> reduced_model::solve(std::size_t plus, std::size_t into, const std::vector<std::complex<double>>& t,
+	const std::vector<char>& swapped, std::vector<std::complex<double>>& y) const {
+	const std::size_t n = states;
+	y.resize(n);
+	for (std::size_t k = 0; k < n; ++k) {
+		y[k] = right[k * ports + into];
+	}
+	for (std::size_t k = 0; k + 1 < n; ++k) {
+		if (swapped[k]) {
+			std::swap(y[k], y[k + 1]);
+		}
+		y[k + 1] -= t[(k + 1) * n + k] * y[k];
+	}
+	for (std::size_t k = n; k-- > 0;) {
+		std::complex<double> sum = y[k];
+		for (std::size_t j = k + 1; j < n; ++j) {
+			sum -= t[k * n + j] * y[j];
+		}
+		y[k] = sum / t[k * n + k];
+	}
+	std::complex<double> z = 0.0;
+	for (std::size_t k = 0; k < n; ++k) {
+		z += left[k * ports + plus] * y[k];
+	}
+	return z;
+}
+
+std::complex<double> reduced_model::impedance(double f, std::size_t plus, std::size_t into) const {
+	check_port(plus);
+	check_port(into);
+	std::vector<std::complex<double>> t;
+	std::vector<char> swapped;
+	std::vector<std::complex<double>> y;
+	factor(std::complex<double>(-s0, 2 * pi * f), t, swapped);
+	return solve(plus, into, t, swapped, y);
+}
+
+std::vector<std::complex<double>> reduced_model::impedance_matrix(double f) const {
+	std::vector<std::complex<double>> t;
+	std::vector<char> swapped;
+	std::vector<std::complex<double>> y;
+	factor(std::complex<double>(-s0, 2 * pi * f), t, swapped);
+	std::vector<std::complex<double>> z(ports * ports);
+	for (std::size_t j = 0; j < ports; ++j) {
+		for (std::size_t i = 0; i < ports; ++i) {
+			z[i * ports + j] = solve(i, j, t, swapped, y);
+		}
+	}
+	return z;
+}
+
+sweep_result reduced_model::sweep_port(const std::vector<double>& freqs, std::size_t port) const {
+	check_port(port);
+	sweep_result result;
+	result.frequency = freqs;
+	result.magnitude.resize(freqs.size());
+	result.phase.resize(freqs.size());
+	std::vector<std::complex<double>> t;
+	std::vector<char> swapped;
+	std::vector<std::complex<double>> y;
+	for (std::size_t i = 0; i < freqs.size(); ++i) {
+		factor(std::complex<double>(-s0, 2 * pi * freqs[i]), t, swapped);
+		const std::complex<double> z = solve(port, port, t, swapped, y);
+		result.magnitude[i] = std::abs(z);
+		result.phase[i] = std::arg(z);
+	}
+	return result;
+}
+
+reduced_model reduce_netlist(const netlist& net, const std::vector<netlist_port>& ports, const reduction_options& options) {
+	if (!net.get_devices().empty()) {
+		throw std::invalid_argument("Error: Only resistors, capacitors and inductors can be reduced.");
+	}
+	if (net.get_node_count() > std::numeric_limits<std::uint32_t>::max()) {
+		throw std::invalid_argument("Error: Netlist has too many nodes to reduce.");
+	}
+	const std::vector<netlist::branch>& branches = net.get_branches();
+	std::vector<std::uint8_t> kinds(branches.size());
+	std::vector<double> values(branches.size());
+	std::vector<std::uint32_t> from(branches.size());
+	std::vector<std::uint32_t> to(branches.size());
+	for (std::size_t k = 0; k < branches.size(); ++k) {
+		const component_kind kind = branches[k].part->get_kind();
+		if (kind != component_kind::resistor && kind != component_kind::capacitor && kind != component_kind::inductor) {
+			throw std::invalid_argument("Error: Only resistors, capacitors and inductors can be reduced.");
+		}
+		kinds[k] = static_cast<std::uint8_t>(kind);
+		values[k] = branches[k].part->get_value();
+		from[k] = static_cast<std::uint32_t>(branches[k].from);
+		to[k] = static_cast<std::uint32_t>(branches[k].to);
+	}
+	return reduce_branches(net.get_node_count(), branches.size(), kinds.data(), values.data(), from.data(), to.data(),
+		ports, options);
+}
+
+reduced_model reduce_netlist(const mapped_netlist& net, const std::vector<netlist_port>& ports, const reduction_options& options) {
+	return reduce_branches(net.get_node_count(), net.get_branch_count(), net.get_kinds(), net.get_values(),
+		net.get_from(), net.get_to(), ports, options);
+}
@@ -0,0 +1,602 @@
+﻿#include "acs/server.h"
+#include "acs/lanes.h"
+#include "acs/stream.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+const char* const kind_names[request_kind_count] = { "evaluate", "sweep", "stats", "invalid" };
+
+// Text of a JSON string between its quotes, with any escapes left as written
+struct json_text
+{
+	const char* first;
+	const char* last;
+
+	bool operator==(const char* s) const {
+		const std::size_t n = std::strlen(s);
+		return static_cast<std::size_t>(last - first) == n && std::memcmp(first, s, n) == 0;
+	}
+};
+
+// Just enough JSON for flat request objects: strings, numbers and arrays of numbers
+struct json_reader
+{
+	const char* p;
+	const char* last;
+
+	static void malformed() {
+		throw std::invalid_argument("Error: Malformed request.");
+	}
+	void skip() {
+		while (p != last && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+			++p;
+		}
+	}
+	bool accept(char c) {
+		skip();
+		if (p != last && *p == c) {
+			++p;
+			return true;
+		}
+		return false;
+	}
+	void expect(char c) {
+		if (!accept(c)) {
+			malformed();
+		}
+	}
+	bool at(char c) {
+		skip();
+		return p != last && *p == c;
+	}
+	json_text string() {
+		expect('"');
+		const char* first = p;
+		while (p != last && *p != '"') {
+			if (*p == '\\' && ++p == last) {
+				break;
+			}
+			++p;
+		}
+		if (p == last) {
+			malformed();
+		}
+		return { first, p++ };
+	}
+	double number() {
+		skip();
+		double x = 0.0;
+		const std::from_chars_result r = std::from_chars(p, last, x);
+		if (r.ec != std::errc()) {
+			throw std::invalid_argument("Error: Expected a number in the request.");
+		}
+		p = r.ptr;
+		return x;
+	}
+};
+
+// Call f with a null pointer to the fixed topology of menu circuit 'type'
+template<typename F>
+void with_menu_topology(int type, F&& f) {
+	switch (type) {
+	case 1:
+		f(static_cast<parallel_rlc*>(nullptr));
+		break;
+	case 2:
+		f(static_cast<series_rlc*>(nullptr));
+		break;
+	case 3:
+		f(static_cast<series_rl*>(nullptr));
+		break;
+	case 4:
+		f(static_cast<parallel_rl*>(nullptr));
+		break;
+	case 5:
+		f(static_cast<series_rc*>(nullptr));
+		break;
+	case 6:
+		f(static_cast<parallel_rc*>(nullptr));
+		break;
+	case 7:
+		f(static_cast<series_lc*>(nullptr));
+		break;
+	case 8:
+		f(static_cast<parallel_lc*>(nullptr));
+		break;
+	default:
+		throw std::invalid_argument("Error: Invalid circuit type.");
+	}
+}
+
+// Lanes holding the values of the given requests, one circuit each
+template<typename Topology>
+circuit_lanes<Topology> make_lanes(const std::vector<server_request>& batch, const std::vector<std::size_t>& members) {
+	circuit_lanes<Topology> lanes(members.size());
+	for (std::size_t p = 0; p < circuit_lanes<Topology>::parameter_count; ++p) {
+		double* column = lanes.get_column(p);
+		for (std::size_t k = 0; k < members.size(); ++k) {
+			column[k] = batch[members[k]].record.values[p];
+		}
+	}
+	return lanes;
+}
+
+// Mark the given requests as failed with the same error
+void set_error(std::vector<server_request>& batch, const std::vector<std::size_t>& members, const std::exception& ex) {
+	for (std::size_t i : members) {
+		batch[i].error = ex.what();
+	}
+}
+
+// Responses as JSON lines, buffered until the whole batch is written
+class response_sink : public jsonl_sink
+{
+private:
+	// JSON has no infinity or NaN, so those are written as null
+	void write_value(double x) {
+		if (std::isfinite(x)) {
+			write_number(x);
+		}
+		else {
+			write_text("null");
+		}
+	}
+	void write_field(const char* name, double x) {
+		write_char('"');
+		write_text(name);
+		write_text("\":");
+		write_value(x);
+	}
+	// JSON string with its quotes, backslashes and control characters escaped
+	void write_string(const std::string& text) {
+		write_char('"');
+		for (const char c : text) {
+			if (c == '"' || c == '\\') {
+				write_char('\\');
+				write_char(c);
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+				write_text(escaped);
+			}
+			else {
+				write_char(c);
+			}
+		}
+		write_char('"');
+	}
+	void write_array(const char* name, const std::vector<double>& x) {
+		write_char('"');
+		write_text(name);
+		write_text("\":[");
+		for (std::size_t i = 0; i < x.size(); ++i) {
+			if (i > 0) {
+				write_char(',');
+			}
+			write_value(x[i]);
+		}
+		write_char(']');
+	}
+	void write_statistics(const simulation_server& server) {
+		for (std::size_t k = 0; k < request_kind_count; ++k) {
+			const latency_summary s = server.get_latency(static_cast<request_kind>(k));
+			write_char('"');
+			write_text(kind_names[k]);
+			write_text("\":{");
+			write_field("count", static_cast<double>(s.count));
+			write_char(',');
+			write_field("p50_us", s.p50);
+			write_char(',');
+			write_field("p99_us", s.p99);
+			write_char(',');
+			write_field("max_us", s.max);
+			write_text("},");
+		}
+		write_field("batches", static_cast<double>(server.get_batches()));
+		write_char(',');
+		write_field("largest_batch", static_cast<double>(server.get_largest_batch()));
+		const cache_statistics c = server.get_cache_statistics();
+		write_text(",\"cache\":{");
+		write_field("hits", static_cast<double>(c.hits));
+		write_char(',');
+		write_field("disk_hits", static_cast<double>(c.disk_hits));
+		write_char(',');
+		write_field("misses", static_cast<double>(c.misses));
+		write_char(',');
+		write_field("entries", static_cast<double>(c.entries));
+		write_char('}');
+	}
+public:
+	explicit response_sink(std::ostream& stream) : jsonl_sink(stream) {}
+	~response_sink() {}
+	void write_response(const server_request& request, const simulation_server& server) {
+		write_char('{');
+		if (!request.id.empty()) {
+			write_text("\"id\":");
+			write_bytes(request.id.data(), request.id.size());
+			write_char(',');
+		}
+		if (!request.error.empty()) {
+			write_text("\"error\":");
+			write_string(request.error);
+		}
+		else if (request.kind == request_kind::evaluate) {
+			write_field("magnitude", request.magnitude);
+			write_char(',');
+			write_field("phase", request.phase);
+		}
+		else if (request.kind == request_kind::sweep) {
+			write_array("frequency", request.curve->frequency);
+			write_char(',');
+			write_array("magnitude", request.curve->magnitude);
+			write_char(',');
+			write_array("phase", request.curve->phase);
+		}
+		else {
+			write_statistics(server);
+		}
+		write_text("}\n");
+	}
+};
+
+}
+
+bool parse_request(const char* p, const char* last, server_request& request) {
+	ACS_TIMED(parse);
+	json_reader json = { p, last };
+	json.skip();
+	if (json.p == last) {
+		return false;
+	}
+	request_kind kind = request_kind::invalid;
+	double type = 0.0;
+	int value_count = -1;
+	json.expect('{');
+	if (!json.accept('}')) {
+		do {
+			const json_text key = json.string();
+			json.expect(':');
+			if (key == "id") {
+				json.skip();
+				const char* first = json.p;
+				if (json.at('"')) {
+					json.string();
+				}
+				else {
+					// Echoed back as written, so only a finite JSON number will do;
+					// from_chars alone would also take "nan" and "inf"
+					if (first == last || (*first != '-' && !(*first >= '0' && *first <= '9'))) {
+						json_reader::malformed();
+					}
+					if (!std::isfinite(json.number())) {
+						json_reader::malformed();
+					}
+				}
+				request.id.assign(first, json.p);
+			}
+			else if (key == "op") {
+				const json_text op = json.string();
+				if (op == "evaluate") {
+					kind = request_kind::evaluate;
+				}
+				else if (op == "sweep") {
+					kind = request_kind::sweep;
+				}
+				else if (op == "stats") {
+					kind = request_kind::stats;
+				}
+				else {
+					throw std::invalid_argument("Error: Unknown request op.");
+				}
+			}
+			else if (key == "type") {
+				type = json.number();
+			}
+			else if (key == "frequency") {
+				request.record.frequency = json.number();
+			}
+			else if (key == "start") {
+				request.start = json.number();
+			}
+			else if (key == "stop") {
+				request.stop = json.number();
+			}
+			else if (key == "points") {
+				const double points = json.number();
+				if (!(points >= 1 && points <= max_request_points) || points != std::floor(points)) {
+					throw std::invalid_argument("Error: Sweep points must be a whole number from 1 to 1048576.");
+				}
+				request.points = static_cast<std::size_t>(points);
+			}
+			else if (key == "values") {
+				json.expect('[');
+				value_count = 0;
+				if (!json.accept(']')) {
+					do {
+						if (value_count == 3) {
+							throw std::invalid_argument("Error: Too many values for this circuit type.");
+						}
+						request.record.values[value_count++] = json.number();
+					} while (json.accept(','));
+					json.expect(']');
+				}
+			}
+			else {
+				throw std::invalid_argument("Error: Unknown request field.");
+			}
+		} while (json.accept(','));
+		json.expect('}');
+	}
+	json.skip();
+	if (json.p != last) {
+		json_reader::malformed();
+	}
+	if (kind == request_kind::invalid) {
+		throw std::invalid_argument("Error: Request has no op.");
+	}
+	if (kind != request_kind::stats) {
+		if (!(type >= 1 && type <= 8) || type != std::floor(type)) {
+			throw std::invalid_argument("Error: Invalid circuit type. Please enter an integer between 1 and 8.");
+		}
+		request.record.type = static_cast<int>(type);
+		if (value_count != menu_value_counts[request.record.type]) {
+			throw std::invalid_argument("Error: Wrong number of values for this circuit type.");
+		}
+	}
+	if (kind == request_kind::evaluate && !(request.record.frequency > 0 && std::isfinite(request.record.frequency))) {
+		throw std::invalid_argument("Error: Invalid frequency. Please enter a valid number.");
+	}
+	if (kind == request_kind::sweep) {
+		if (request.points == 0) {
+			throw std::invalid_argument("Error: Sweep needs at least one point.");
+		}
+		// Checks the range
+		frequency_grid(request.start, request.stop, request.points);
+	}
+	request.kind = kind;
+	ACS_COUNT(records, 1);
+	return true;
+}
+
+simulation_server::simulation_server(const server_options& settings) :
+	options(settings), pool(settings.threads), cache(settings.cache_bytes, settings.cache_directory), circuits(1 << 20),
+	latency(request_kind_count, quantile_sketch(0.01)), worst(request_kind_count, 0.0), batches(0), largest_batch(0) {
+	if (options.max_batch == 0) {
+		throw std::invalid_argument("Error: A server batch must hold at least one request.");
+	}
+}
+
+// Every evaluation of one circuit type goes through one set of lanes, each lane at
+// its own frequency
+void simulation_server::evaluate_all(std::vector<server_request>& batch) {
+	std::vector<std::size_t> members[9];
+	for (std::size_t i = 0; i < batch.size(); ++i) {
+		if (batch[i].kind == request_kind::evaluate && batch[i].error.empty()) {
+			members[batch[i].record.type].push_back(i);
+		}
+	}
+	std::vector<double> freqs;
+	std::vector<double> magnitude;
+	std::vector<double> phase;
+	for (int type = 1; type <= 8; ++type) {
+		const std::vector<std::size_t>& group = members[type];
+		if (group.empty()) {
+			continue;
+		}
+		freqs.resize(group.size());
+		magnitude.resize(group.size());
+		phase.resize(group.size());
+		for (std::size_t k = 0; k < group.size(); ++k) {
+			freqs[k] = batch[group[k]].record.frequency;
+		}
+		try {
+			with_menu_topology(type, [&](auto* tag) {
+				using topology = std::remove_pointer_t<decltype(tag)>;
+				make_lanes<topology>(batch, group).evaluate(freqs.data(), magnitude.data(), phase.data(), pool);
+			});
+		}
+		catch (const std::exception& ex) {
+			// Only the requests that shared these lanes fail
+			set_error(batch, group, ex);
+			continue;
+		}
+		for (std::size_t k = 0; k < group.size(); ++k) {
+			batch[group[k]].magnitude = magnitude[k];
+			batch[group[k]].phase = phase[k];
+		}
+	}
+}
+
+// Sweeps are looked up in the cache first; the misses of one circuit type over one
+// grid are then swept together in lanes and added to the cache
+void simulation_server::sweep_all(std::vector<server_request>& batch) {
+	struct sweep_group
+	{
+		int type;
+		double start;
+		double stop;
+		std::size_t points;
+		std::vector<std::size_t> members;
+	};
+	std::vector<sweep_group> groups;
+	for (std::size_t i = 0; i < batch.size(); ++i) {
+		const server_request& r = batch[i];
+		if (r.kind != request_kind::sweep || !r.error.empty()) {
+			continue;
+		}
+		auto found = std::find_if(groups.begin(), groups.end(), [&](const sweep_group& g) {
+			return g.type == r.record.type && g.start == r.start && g.stop == r.stop && g.points == r.points;
+		});
+		if (found == groups.end()) {
+			groups.push_back({ r.record.type, r.start, r.stop, r.points, {} });
+			found = groups.end() - 1;
+		}
+		found->members.push_back(i);
+	}
+	std::vector<double> freqs;
+	std::vector<std::size_t> misses;
+	std::vector<const circuit*> missed_circuits;
+	for (const sweep_group& g : groups) {
+		freqs.resize(g.points);
+		frequency_grid(g.start, g.stop, g.points).fill(0, g.points, freqs.data());
+		misses.clear();
+		missed_circuits.clear();
+		for (std::size_t i : g.members) {
+			try {
+				const circuit* c = build_menu_circuit(g.type, batch[i].record.values, circuits);
+				batch[i].curve = cache.find(*c, freqs);
+				if (batch[i].curve == nullptr) {
+					misses.push_back(i);
+					missed_circuits.push_back(c);
+				}
+			}
+			catch (const std::exception& ex) {
+				batch[i].error = ex.what();
+			}
+		}
+		if (misses.empty()) {
+			continue;
+		}
+		lane_sweep_result swept;
+		try {
+			with_menu_topology(g.type, [&](auto* tag) {
+				using topology = std::remove_pointer_t<decltype(tag)>;
+				swept = make_lanes<topology>(batch, misses).sweep(freqs, pool);
+			});
+		}
+		catch (const std::exception& ex) {
+			set_error(batch, misses, ex);
+			continue;
+		}
+		for (std::size_t k = 0; k < misses.size(); ++k) {
+			auto curve = std::make_shared<sweep_result>();
+			curve->frequency = freqs;
+			curve->magnitude.resize(g.points);
+			curve->phase.resize(g.points);
+			for (std::size_t i = 0; i < g.points; ++i) {
+				curve->magnitude[i] = swept.get_magnitude(k, i);
+				curve->phase[i] = swept.get_phase(k, i);
+			}
+			cache.add(*missed_circuits[k], freqs, curve);
+			batch[misses[k]].curve = std::move(curve);
+		}
+	}
+}
+
+void simulation_server::serve(std::vector<server_request>& batch) {
+	++batches;
+	largest_batch = std::max(largest_batch, batch.size());
+	// Each group catches its own errors, so one bad circuit fails only its own requests
+	evaluate_all(batch);
+	sweep_all(batch);
+	circuits.release();
+}
+
+void simulation_server::run(std::istream& in, std::ostream& out) {
+	std::mutex mutex;
+	std::condition_variable arrived;
+	std::deque<server_request> queue;
+	bool finished = false;
+	// Lines are read one at a time, so a request is queued as soon as its line is
+	// complete rather than when a block of input has filled
+	std::thread reader([&] {
+		std::string line;
+		while (std::getline(in, line)) {
+			server_request request;
+			request.received = instrumentation::now();
+			try {
+				if (!parse_request(line.data(), line.data() + line.size(), request)) {
+					continue;
+				}
+			}
+			catch (const std::invalid_argument& ex) {
+				request.kind = request_kind::invalid;
+				request.error = ex.what();
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back(std::move(request));
+			}
+			arrived.notify_one();
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finished = true;
+		}
+		arrived.notify_one();
+	});
+	response_sink sink(out);
+	std::vector<server_request> batch;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			arrived.wait(lock, [&] { return finished || !queue.empty(); });
+			if (queue.empty()) {
+				break;
+			}
+			const std::size_t n = std::min(queue.size(), options.max_batch);
+			batch.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + n));
+			queue.erase(queue.begin(), queue.begin() + n);
+		}
+		serve(batch);
+		{
+			ACS_TIMED(output);
+			for (const server_request& r : batch) {
+				sink.write_response(r, *this);
+			}
+			sink.flush();
+		}
+		const std::uint64_t answered = instrumentation::now();
+		for (const server_request& r : batch) {
+			const std::size_t k = static_cast<std::size_t>(r.error.empty() ? r.kind : request_kind::invalid);
+			const double microseconds = (answered - r.received) * 1e-3;
+			latency[k].add(microseconds);
+			worst[k] = std::max(worst[k], microseconds);
+		}
+	}
+	reader.join();
+}
+
+latency_summary simulation_server::get_latency(request_kind kind) const {
+	const std::size_t k = static_cast<std::size_t>(kind);
+	latency_summary s;
+	s.count = latency[k].get_count();
+	if (s.count > 0) {
+		// The sketch is within 1% of a true value, which may put it just above the maximum
+		s.max = worst[k];
+		s.p50 = std::min(latency[k].quantile(0.5), s.max);
+		s.p99 = std::min(latency[k].quantile(0.99), s.max);
+	}
+	return s;
+}
+
+void simulation_server::write_summary(std::ostream& out) const {
+	char line[128];
+	std::snprintf(line, sizeof(line), "%-12s %12s %12s %12s %12s\n", "Request", "Count", "p50 (us)", "p99 (us)", "Max (us)");
+	out << line;
+	for (std::size_t k = 0; k < request_kind_count; ++k) {
+		const latency_summary s = get_latency(static_cast<request_kind>(k));
+		if (s.count == 0) {
+			continue;
+		}
+		std::snprintf(line, sizeof(line), "%-12s %12llu %12.1f %12.1f %12.1f\n", kind_names[k],
+			static_cast<unsigned long long>(s.count), s.p50, s.p99, s.max);
+		out << line;
+	}
+	std::snprintf(line, sizeof(line), "Batches %llu, largest %zu requests\n", static_cast<unsigned long long>(batches), largest_batch);
+	out << line;
+}
@@ -0,0 +1,55 @@
+﻿#include "acs/transient.h"
+
+waveform step_waveform(double amplitude, double delay) {
+	return waveform([=](double t) { return t < delay ? 0.0 : amplitude; },
+		[=](double t) { return t < delay ? delay : std::numeric_limits<double>::infinity(); });
+}
+
+waveform pulse_waveform(double low, double high, double delay, double rise, double fall, double width, double period) {
+	if (rise < 0 || fall < 0 || width < 0 || period < 0 || (period > 0 && period < rise + width + fall)) {
+		throw std::invalid_argument("Error: Invalid pulse timing.");
+	}
+	return waveform(
+		[=](double t) {
+			if (t < delay) {
+				return low;
+			}
+			double tau = t - delay;
+			if (period > 0) {
+				tau = std::fmod(tau, period);
+			}
+			if (tau < rise) {
+				return low + (high - low) * tau / rise;
+			}
+			if (tau < rise + width) {
+				return high;
+			}
+			if (tau < rise + width + fall) {
+				return high - (high - low) * (tau - rise - width) / fall;
+			}
+			return low;
+		},
+		[=](double t) {
+			if (t < delay) {
+				return delay;
+			}
+			// Look one period further in case rounding put t just past the start of this one
+			const double base = delay + (period > 0 ? std::floor((t - delay) / period) * period : 0.0);
+			for (double start : { base, base + period }) {
+				for (double offset : { 0.0, rise, rise + width, rise + width + fall }) {
+					if (start + offset > t) {
+						return start + offset;
+					}
+				}
+				if (period == 0) {
+					break;
+				}
+			}
+			return std::numeric_limits<double>::infinity();
+		});
+}
+
+waveform sine_waveform(double offset, double amplitude, double frequency, double delay) {
+	return waveform([=](double t) { return t < delay ? offset : offset + amplitude * std::sin(2 * pi * frequency * (t - delay)); },
+		[=](double t) { return t < delay ? delay : std::numeric_limits<double>::infinity(); });
+}
@@ -0,0 +1,158 @@
+﻿// Sweep cache: hits and misses, eviction under the byte budget, and the disk copy
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Series RC whose resistance tells the circuits apart
+struct rc_circuit
+{
+	resistor r;
+	capacitor c;
+	circuit whole;
+
+	explicit rc_circuit(double resistance) : r(resistance), c(1e-6) {
+		whole.add_component_in_series(&r);
+		whole.add_component_in_series(&c);
+	}
+};
+
+std::vector<double> grid() {
+	std::vector<double> freqs;
+	for (double f = 10.0; f < 1e6; f *= 1.5) {
+		freqs.push_back(f);
+	}
+	return freqs;
+}
+
+// Empty directory of its own under the system temporary directory
+std::filesystem::path scratch_directory(const char* name) {
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+	std::filesystem::remove_all(path);
+	return path;
+}
+
+std::filesystem::path only_file(const std::filesystem::path& directory) {
+	std::filesystem::path found;
+	for (const auto& item : std::filesystem::directory_iterator(directory)) {
+		found = item.path();
+	}
+	return found;
+}
+
+void test_hits_and_misses() {
+	const std::vector<double> freqs = grid();
+	rc_circuit a(100.0);
+	sweep_cache cache(1 << 20);
+	const auto first = cache.sweep(a.whole, freqs);
+	const auto second = cache.sweep(a.whole, freqs);
+	CHECK(first == second);
+	CHECK(cache.find(a.whole, std::vector<double>(freqs.begin(), freqs.end() - 1)) == nullptr);
+	const cache_statistics s = cache.get_statistics();
+	CHECK(s.hits == 1);
+	CHECK(s.misses == 1);
+	CHECK(s.entries == 1);
+	const sweep_result expected = a.whole.sweep(freqs);
+	CHECK(first->magnitude == expected.magnitude);
+	CHECK(first->phase == expected.phase);
+}
+
+// With room for two entries, the least recently used one goes
+void test_lru_eviction() {
+	const std::vector<double> freqs = grid();
+	rc_circuit a(100.0);
+	rc_circuit b(200.0);
+	rc_circuit c(300.0);
+	std::size_t entry_bytes = 0;
+	{
+		sweep_cache probe(1 << 20);
+		probe.sweep(a.whole, freqs);
+		entry_bytes = probe.get_statistics().bytes;
+	}
+	sweep_cache cache(2 * entry_bytes + entry_bytes / 2);
+	cache.sweep(a.whole, freqs);
+	cache.sweep(b.whole, freqs);
+	cache.sweep(a.whole, freqs);
+	cache.sweep(c.whole, freqs);
+	const cache_statistics s = cache.get_statistics();
+	CHECK(s.evictions == 1);
+	CHECK(s.entries == 2);
+	CHECK(s.bytes <= 2 * entry_bytes + entry_bytes / 2);
+	CHECK(cache.find(a.whole, freqs) != nullptr);
+	CHECK(cache.find(c.whole, freqs) != nullptr);
+	CHECK(cache.find(b.whole, freqs) == nullptr);
+}
+
+// A new cache on the same directory finds the earlier results on disk
+void test_reload_after_restart() {
+	const std::vector<double> freqs = grid();
+	const std::filesystem::path directory = scratch_directory("acs_cache_test_reload");
+	rc_circuit a(100.0);
+	sweep_result expected;
+	{
+		sweep_cache cache(1 << 20, directory.string());
+		expected = *cache.sweep(a.whole, freqs);
+	}
+	sweep_cache restarted(1 << 20, directory.string());
+	const auto reloaded = restarted.sweep(a.whole, freqs);
+	const cache_statistics s = restarted.get_statistics();
+	CHECK(s.disk_hits == 1);
+	CHECK(s.misses == 0);
+	CHECK(reloaded->frequency == expected.frequency);
+	CHECK(reloaded->magnitude == expected.magnitude);
+	CHECK(reloaded->phase == expected.phase);
+	std::filesystem::remove_all(directory);
+}
+
+// A damaged point count or a cut-off file is a miss, not an exception
+void test_corrupt_files_are_ignored() {
+	const std::vector<double> freqs = grid();
+	const std::filesystem::path directory = scratch_directory("acs_cache_test_corrupt");
+	rc_circuit a(100.0);
+	{
+		sweep_cache cache(1 << 20, directory.string());
+		cache.sweep(a.whole, freqs);
+	}
+	const std::filesystem::path file = only_file(directory);
+	std::uint64_t key_size = 0;
+	{
+		std::ifstream in(file, std::ios::binary);
+		in.seekg(8);
+		in.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+	}
+	{
+		std::fstream out(file, std::ios::binary | std::ios::in | std::ios::out);
+		out.seekp(static_cast<std::streamoff>(16 + key_size));
+		const std::uint64_t huge = std::uint64_t(1) << 60;
+		out.write(reinterpret_cast<const char*>(&huge), sizeof(huge));
+	}
+	{
+		sweep_cache cache(1 << 20, directory.string());
+		cache.sweep(a.whole, freqs);
+		CHECK(cache.get_statistics().disk_hits == 0);
+		CHECK(cache.get_statistics().misses == 1);
+	}
+	std::filesystem::resize_file(file, std::filesystem::file_size(file) - 8);
+	sweep_cache cache(1 << 20, directory.string());
+	cache.sweep(a.whole, freqs);
+	CHECK(cache.get_statistics().disk_hits == 0);
+	CHECK(cache.get_statistics().misses == 1);
+	std::filesystem::remove_all(directory);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_hits_and_misses);
+	RUN_TEST(test_lru_eviction);
+	RUN_TEST(test_reload_after_restart);
+	RUN_TEST(test_corrupt_files_are_ignored);
+	return check_failures();
+}
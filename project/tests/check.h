@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <exception>
+#include <iostream>
+
+// Minimal checks for the test programs. A failed check is reported with its line
+// and the program carries on, returning the number of failures from main.
+
+inline int& check_failures() {
+	static int failures = 0;
+	return failures;
+}
+
+inline void report_failure(const char* file, int line, const char* what) {
+	++check_failures();
+	std::cerr << file << ":" << line << ": check failed: " << what << "\n";
+}
+
+// Relative difference, measured against the larger of the two sizes
+inline double relative_error(std::complex<double> actual, std::complex<double> expected) {
+	const double scale = std::max(std::abs(actual), std::abs(expected));
+	return scale > 0 ? std::abs(actual - expected) / scale : 0.0;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			report_failure(__FILE__, __LINE__, #condition); \
+		} \
+	} while (false)
+
+// actual within a relative tolerance of expected
+#define CHECK_CLOSE(actual, expected, tolerance) \
+	do { \
+		const double check_error = relative_error((actual), (expected)); \
+		if (!(check_error <= (tolerance))) { \
+			std::cerr << "  relative error " << check_error << "\n"; \
+			report_failure(__FILE__, __LINE__, #actual " close to " #expected); \
+		} \
+	} while (false)
+
+// Runs a test function, reporting an exception as a failure
+#define RUN_TEST(test) \
+	do { \
+		try { \
+			test(); \
+		} \
+		catch (const std::exception& e) { \
+			std::cerr << #test << " threw: " << e.what() << "\n"; \
+			++check_failures(); \
+		} \
+	} while (false)
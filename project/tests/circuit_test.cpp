@@ -0,0 +1,69 @@
+﻿// Running sums of a circuit as parts are added, removed and replaced
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <cmath>
+#include <complex>
+
+namespace {
+
+// Removing a part far larger than the rest must not leave its rounding behind
+void test_remove_dominant_series_part() {
+	circuit c(connection::series);
+	resistor small(1.3);
+	resistor huge(1e17);
+	c.add_component_in_series(&small);
+	const component_id id = c.add_component_in_series(&huge);
+	c.set_frequency(1e3);
+	c.remove_component(id);
+	CHECK_CLOSE(c.get_circuit_impedance(), std::complex<double>(1.3), 1e-15);
+}
+
+// A 0 Ohm part in parallel has an infinite conductance, which cannot be subtracted
+void test_remove_short_in_parallel() {
+	circuit c(connection::parallel);
+	resistor load(1e3);
+	resistor short_circuit(0.0);
+	c.add_component_in_parallel(&load);
+	const component_id id = c.add_component_in_parallel(&short_circuit);
+	c.set_frequency(1e3);
+	CHECK(std::abs(c.get_circuit_impedance()) == 0.0);
+	c.remove_component(id);
+	CHECK_CLOSE(c.get_circuit_impedance(), std::complex<double>(1e3), 1e-15);
+}
+
+// Replacing parts one after another keeps the sums equal to a fresh circuit's
+void test_replace_matches_rebuilt() {
+	circuit c(connection::parallel);
+	resistor r1(50.0);
+	capacitor c1(1e-9);
+	inductor l1(1e-3);
+	c.add_component_in_parallel(&r1);
+	const component_id cid = c.add_component_in_parallel(&c1);
+	const component_id lid = c.add_component_in_parallel(&l1);
+	c.set_frequency(2e5);
+	capacitor c2(1e3);
+	inductor l2(0.0);
+	c.replace_component(cid, &c2);
+	c.replace_component(lid, &l2);
+	capacitor c3(2.2e-9);
+	inductor l3(4.7e-4);
+	c.replace_component(cid, &c3);
+	c.replace_component(lid, &l3);
+	circuit fresh(connection::parallel);
+	fresh.add_component_in_parallel(&r1);
+	fresh.add_component_in_parallel(&c3);
+	fresh.add_component_in_parallel(&l3);
+	fresh.set_frequency(2e5);
+	CHECK_CLOSE(c.get_circuit_impedance(), fresh.get_circuit_impedance(), 1e-14);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_remove_dominant_series_part);
+	RUN_TEST(test_remove_short_in_parallel);
+	RUN_TEST(test_replace_matches_rebuilt);
+	return check_failures();
+}
@@ -0,0 +1,170 @@
+﻿// Memory-mapped netlist and sweep files written, reopened and damaged
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <complex>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string scratch_file(const char* name) {
+	const std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+	std::filesystem::remove(path);
+	return path.string();
+}
+
+// Ladder of three sections with a current source into the far end
+struct ladder
+{
+	resistor r1;
+	capacitor c1;
+	inductor l2;
+	capacitor c2;
+	resistor r3;
+	netlist net;
+	std::size_t n1;
+	std::size_t n2;
+	std::size_t n3;
+
+	ladder() : r1(50.0), c1(1e-7), l2(1e-3), c2(2.2e-7), r3(1e3) {
+		n1 = net.add_node();
+		n2 = net.add_node();
+		n3 = net.add_node();
+		net.add_component(&r1, n1, n2);
+		net.add_component(&c1, n2, netlist::ground);
+		net.add_component(&l2, n2, n3);
+		net.add_component(&c2, n3, netlist::ground);
+		net.add_component(&r3, n3, netlist::ground);
+		net.add_current_source(netlist::ground, n3, std::complex<double>(1e-3, 0.0));
+	}
+};
+
+// Overwrite bytes of a file in place
+void patch(const std::string& path, std::size_t offset, const void* bytes, std::size_t count) {
+	std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+	file.seekp(static_cast<std::streamoff>(offset));
+	file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(count));
+}
+
+template <typename F>
+bool throws_runtime_error(F f) {
+	try {
+		f();
+	}
+	catch (const std::runtime_error&) {
+		return true;
+	}
+	return false;
+}
+
+void test_netlist_round_trip() {
+	ladder l;
+	const std::string path = scratch_file("acs_columnar_test_round_trip.acsn");
+	write_netlist_file(l.net, path);
+	{
+		mapped_netlist mapped(path);
+		prepared_netlist prepared(l.net);
+		CHECK(mapped.get_node_count() == 4);
+		CHECK(mapped.get_branch_count() == 5);
+		CHECK(mapped.get_source_count() == 1);
+		for (double f = 10.0; f < 1e7; f *= 3.0) {
+			CHECK_CLOSE(mapped.port_impedance(l.n1, netlist::ground, f), prepared.port_impedance(l.n1, netlist::ground, f), 1e-12);
+			CHECK_CLOSE(mapped.port_impedance(l.n3, l.n1, f), prepared.port_impedance(l.n3, l.n1, f), 1e-12);
+			// The only source drives node 3, so its voltage is the current times Z(n3)
+			const std::vector<std::complex<double>> voltages = mapped.node_voltages(f);
+			CHECK_CLOSE(voltages[l.n3], 1e-3 * prepared.port_impedance(l.n3, netlist::ground, f), 1e-12);
+		}
+	}
+	std::filesystem::remove(path);
+}
+
+void test_sweep_round_trip() {
+	resistor r(100.0);
+	capacitor c(1e-6);
+	circuit whole;
+	whole.add_component_in_series(&r);
+	whole.add_component_in_series(&c);
+	std::vector<double> freqs;
+	for (double f = 10.0; f < 1e6; f *= 2.0) {
+		freqs.push_back(f);
+	}
+	const std::string path = scratch_file("acs_columnar_test_sweep.acss");
+	{
+		mapped_sweep created(path, freqs, 2);
+		created.sweep(whole, 1);
+		created.flush();
+	}
+	{
+		const mapped_sweep opened(path);
+		CHECK(opened.get_rows() == 2);
+		CHECK(opened.get_points() == freqs.size());
+		const sweep_result expected = whole.sweep(freqs);
+		const sweep_result row = opened.read_row(1);
+		CHECK(row.frequency == freqs);
+		CHECK(row.magnitude == expected.magnitude);
+		CHECK(row.phase == expected.phase);
+		CHECK(opened.read_row(0).magnitude == std::vector<double>(freqs.size(), 0.0));
+		bool out_of_range = false;
+		try {
+			opened.get_magnitude(2);
+		}
+		catch (const std::out_of_range&) {
+			out_of_range = true;
+		}
+		CHECK(out_of_range);
+	}
+	std::filesystem::remove(path);
+}
+
+void test_truncated_netlist_throws() {
+	ladder l;
+	const std::string path = scratch_file("acs_columnar_test_truncated.acsn");
+	write_netlist_file(l.net, path);
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+	CHECK(throws_runtime_error([&] { mapped_netlist mapped(path); }));
+	std::filesystem::resize_file(path, 32);
+	CHECK(throws_runtime_error([&] { mapped_netlist mapped(path); }));
+	std::filesystem::remove(path);
+}
+
+void test_wrong_magic_throws() {
+	ladder l;
+	const std::string path = scratch_file("acs_columnar_test_magic.acsn");
+	write_netlist_file(l.net, path);
+	patch(path, 0, "ACSS", 4);
+	CHECK(throws_runtime_error([&] { mapped_netlist mapped(path); }));
+	CHECK(throws_runtime_error([&] { mapped_sweep mapped(path); }));
+	std::filesystem::remove(path);
+}
+
+void test_out_of_range_node_throws() {
+	ladder l;
+	const std::string path = scratch_file("acs_columnar_test_node.acsn");
+	write_netlist_file(l.net, path);
+	// Columns as the header comment lays them out: kinds, values, from, to
+	const std::size_t branches = 5;
+	const std::size_t values = align_column(sizeof(columnar_header) + branches);
+	const std::size_t from = align_column(values + branches * sizeof(double));
+	const std::size_t to = align_column(from + branches * sizeof(std::uint32_t));
+	const std::uint32_t missing = 4;
+	patch(path, to + 2 * sizeof(std::uint32_t), &missing, sizeof(missing));
+	CHECK(throws_runtime_error([&] { mapped_netlist mapped(path); }));
+	std::filesystem::remove(path);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_netlist_round_trip);
+	RUN_TEST(test_sweep_round_trip);
+	RUN_TEST(test_truncated_netlist_throws);
+	RUN_TEST(test_wrong_magic_throws);
+	RUN_TEST(test_out_of_range_node_throws);
+	return check_failures();
+}
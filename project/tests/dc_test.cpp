@@ -0,0 +1,78 @@
+﻿// DC operating point by Newton-Raphson against a scalar reference solution
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <cmath>
+#include <complex>
+
+namespace {
+
+// Junction voltage of a diode fed from 'source' through 'resistance' in series with
+// its own resistance, by bisection on source = v + (resistance + r) I(v)
+double divider_junction_voltage(double source, double resistance, const diode& d) {
+	double low = 0.0;
+	double high = source;
+	for (int step = 0; step < 200; ++step) {
+		const double v = 0.5 * (low + high);
+		const double current = diode::current_of(v, d.get_saturation_current(), d.get_emission_coefficient());
+		if (v + (resistance + d.get_resistance()) * current > source) {
+			high = v;
+		}
+		else {
+			low = v;
+		}
+	}
+	return 0.5 * (low + high);
+}
+
+std::complex<double> real(double x) {
+	return x;
+}
+
+// source - 1 kOhm - node a - 1 mH - node b - diode with 10 Ohm series resistance - ground
+void test_diode_divider(double source, double resistance) {
+	netlist net;
+	const std::size_t a = net.add_node();
+	const std::size_t b = net.add_node();
+	resistor r(resistance);
+	inductor l(1e-3);
+	diode d(1e-12, 10.0, 1e-14, 1.5);
+	const std::size_t feed = net.add_component(&r, a, netlist::ground);
+	const std::size_t choke = net.add_component(&l, a, b);
+	const std::size_t junction = net.add_component(&d, b, netlist::ground);
+	operating_point_analysis dc(net);
+	dc.add_voltage_source(feed, source);
+	// Tight enough that the checks measure the solution rather than the stopping rule
+	dc_options options;
+	options.relative_tolerance = 1e-12;
+	options.absolute_tolerance = 1e-15;
+	const dc_solution op = dc.solve(options);
+	const double v = divider_junction_voltage(source, resistance, d);
+	const double current = diode::current_of(v, d.get_saturation_current(), d.get_emission_coefficient());
+	CHECK_CLOSE(real(op.junction_voltages[junction]), real(v), 1e-9);
+	CHECK_CLOSE(real(op.branch_currents[junction]), real(current), 1e-7);
+	CHECK_CLOSE(real(op.branch_currents[choke]), real(current), 1e-7);
+	CHECK_CLOSE(real(op.branch_currents[feed]), real(-current), 1e-7);
+	CHECK_CLOSE(real(op.node_voltages[a]), real(v + 10.0 * current), 1e-9);
+	CHECK_CLOSE(real(op.node_voltages[b]), real(op.node_voltages[a]), 1e-15);
+	dc.bias(op);
+	CHECK(d.get_operating_point() == op.junction_voltages[junction]);
+}
+
+void test_gentle_divider() {
+	test_diode_divider(5.0, 1e3);
+}
+
+// A stiff drive that takes the junction far up its exponential
+void test_hard_divider() {
+	test_diode_divider(100.0, 1.0);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_gentle_divider);
+	RUN_TEST(test_hard_divider);
+	return check_failures();
+}
@@ -0,0 +1,179 @@
+﻿// Every SIMD kernel set the host supports against plain scalar loops
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Entries past n hold this and must come back untouched
+const double guard = 12345.0;
+const std::size_t padding = 17;
+// Lengths covering every remainder of 8 and 16 lanes, and then some
+const std::size_t max_length = 50;
+
+// Inputs of length n plus padding: a spread of sizes and signs, with zeros and
+// non-finite values scattered through the vector part and the remainder
+template <typename T>
+std::vector<T> inputs(std::size_t n, int seed, bool special) {
+	std::vector<T> x(n + padding, T(guard));
+	for (std::size_t i = 0; i < n; ++i) {
+		const double k = static_cast<double>(i * 7 + seed * 13);
+		x[i] = T(std::sin(k) * std::pow(10.0, std::fmod(k, 7.0) - 3.0));
+		if (special) {
+			switch ((i * 5 + seed) % 23) {
+			case 3:
+				x[i] = T(0);
+				break;
+			case 11:
+				x[i] = std::numeric_limits<T>::infinity();
+				break;
+			case 17:
+				x[i] = -std::numeric_limits<T>::infinity();
+				break;
+			case 20:
+				x[i] = std::numeric_limits<T>::quiet_NaN();
+				break;
+			}
+		}
+	}
+	return x;
+}
+
+// Within 'ulps' units of the last place relative to the expected value, with NaN
+// matching NaN and infinities matching exactly
+template <typename T>
+bool matches(T actual, T expected, double ulps) {
+	if (std::isnan(expected)) {
+		return std::isnan(actual);
+	}
+	if (std::isinf(expected)) {
+		return actual == expected;
+	}
+	const double scale = std::max(std::abs(static_cast<double>(expected)), static_cast<double>(std::numeric_limits<T>::min()));
+	return std::abs(static_cast<double>(actual) - static_cast<double>(expected)) <= ulps * std::numeric_limits<T>::epsilon() * scale;
+}
+
+template <typename T>
+void check_outputs(const basic_sweep_kernels<T>& k, const char* kernel, std::size_t n,
+	const std::vector<T>& actual, const std::vector<T>& expected, double ulps) {
+	for (std::size_t i = 0; i < actual.size(); ++i) {
+		const bool ok = i < n ? matches(actual[i], expected[i], ulps) : actual[i] == T(guard);
+		if (!ok) {
+			std::cerr << "  " << k.name << " " << kernel << " n=" << n << " i=" << i << ": " << actual[i] << " vs " << expected[i] << "\n";
+			report_failure(__FILE__, __LINE__, kernel);
+			return;
+		}
+	}
+}
+
+template <typename T>
+void test_kernel_set(const basic_sweep_kernels<T>& k, bool special) {
+	// A fused multiply-add rounds once where the scalar loop rounds twice
+	const double ulps = 4;
+	const T a = T(0.75);
+	const T b = T(-2.5);
+	for (std::size_t n = 0; n <= max_length; ++n) {
+		const std::vector<T> x = inputs<T>(n, 1, special);
+		const std::vector<T> y = inputs<T>(n, 2, special);
+		const std::vector<T> start = inputs<T>(n, 3, false);
+		// Reactance terms are kept apart from the sum they are added to, so the
+		// check is not spoiled by cancellation
+		std::vector<T> expected(n + padding, T(guard));
+		for (std::size_t i = 0; i < n; ++i) {
+			expected[i] = a * std::abs(x[i]) + std::abs(b) / std::abs(x[i]);
+		}
+		std::vector<T> magnitudes(n + padding, T(guard));
+		for (std::size_t i = 0; i < n; ++i) {
+			magnitudes[i] = std::abs(x[i]);
+		}
+		std::vector<T> zero(n + padding, T(guard));
+		std::fill(zero.begin(), zero.begin() + n, T(0));
+		std::vector<T> actual = zero;
+		k.add_reactance(magnitudes.data(), n, a, std::abs(b), actual.data());
+		check_outputs(k, "add_reactance", n, actual, expected, ulps);
+
+		for (std::size_t i = 0; i < n; ++i) {
+			expected[i] = start[i] + a * x[i];
+		}
+		actual = start;
+		k.add_scaled(x.data(), n, a, actual.data());
+		check_outputs(k, "add_scaled", n, actual, expected, ulps);
+
+		for (std::size_t i = 0; i < n; ++i) {
+			expected[i] = a * magnitudes[i] + std::abs(b) * std::abs(y[i]);
+		}
+		std::vector<T> y_magnitudes(n + padding, T(guard));
+		for (std::size_t i = 0; i < n; ++i) {
+			y_magnitudes[i] = std::abs(y[i]);
+		}
+		actual = zero;
+		k.add_linear(magnitudes.data(), y_magnitudes.data(), n, a, std::abs(b), actual.data());
+		check_outputs(k, "add_linear", n, actual, expected, ulps);
+
+		std::vector<T> expected_im(n + padding, T(guard));
+		for (std::size_t i = 0; i < n; ++i) {
+			const T inv = T(1) / (x[i] * x[i] + y[i] * y[i]);
+			expected[i] = x[i] * inv;
+			expected_im[i] = -y[i] * inv;
+		}
+		std::vector<T> re = zero;
+		std::vector<T> im = zero;
+		k.add_reciprocal(x.data(), y.data(), n, re.data(), im.data());
+		check_outputs(k, "add_reciprocal re", n, re, expected, ulps);
+		check_outputs(k, "add_reciprocal im", n, im, expected_im, ulps);
+
+		re = x;
+		im = y;
+		k.invert(re.data(), im.data(), n);
+		check_outputs(k, "invert re", n, re, expected, ulps);
+		check_outputs(k, "invert im", n, im, expected_im, ulps);
+
+		for (std::size_t i = 0; i < n; ++i) {
+			expected[i] = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+		}
+		actual.assign(n + padding, T(guard));
+		k.magnitude(x.data(), y.data(), n, actual.data());
+		check_outputs(k, "magnitude", n, actual, expected, ulps);
+
+		for (std::size_t i = 0; i < n; ++i) {
+			expected[i] = std::atan2(y[i], x[i]);
+		}
+		actual.assign(n + padding, T(guard));
+		k.phase(x.data(), y.data(), n, actual.data());
+		check_outputs(k, "phase", n, actual, expected, ulps);
+	}
+}
+
+template <typename T>
+void test_available_kernels() {
+	const std::vector<basic_sweep_kernels<T>>& available = get_available_sweep_kernels<T>();
+	CHECK(!available.empty());
+	CHECK(std::string(available.back().name) == get_sweep_kernels<T>().name);
+	for (const basic_sweep_kernels<T>& k : available) {
+		test_kernel_set(k, false);
+		test_kernel_set(k, true);
+	}
+}
+
+void test_double_kernels() {
+	test_available_kernels<double>();
+}
+
+void test_float_kernels() {
+	test_available_kernels<float>();
+}
+
+}
+
+int main() {
+	RUN_TEST(test_double_kernels);
+	RUN_TEST(test_float_kernels);
+	return check_failures();
+}
@@ -0,0 +1,57 @@
+﻿// Statistics kept over Monte Carlo samples
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <cmath>
+#include <complex>
+#include <limits>
+
+namespace {
+
+// Infinite and NaN samples are counted apart and leave the quantiles alone
+void test_sketch_non_finite_samples() {
+	quantile_sketch sketch(0.01);
+	for (int i = 1; i <= 100; ++i) {
+		sketch.add(static_cast<double>(i));
+	}
+	sketch.add(std::numeric_limits<double>::infinity());
+	sketch.add(-std::numeric_limits<double>::infinity());
+	sketch.add(std::numeric_limits<double>::quiet_NaN());
+	CHECK(sketch.get_count() == 100);
+	CHECK(sketch.get_non_finite_count() == 3);
+	CHECK_CLOSE(std::complex<double>(sketch.quantile(0.5)), std::complex<double>(50.0), 0.03);
+	CHECK_CLOSE(std::complex<double>(sketch.quantile(1.0)), std::complex<double>(100.0), 0.01);
+	quantile_sketch other(0.01);
+	other.add(std::numeric_limits<double>::infinity());
+	sketch.merge(other);
+	CHECK(sketch.get_non_finite_count() == 4);
+	CHECK(sketch.get_count() == 100);
+}
+
+
+// An infinite |Z| is counted apart rather than turning the mean into inf
+void test_running_statistics_non_finite_samples() {
+	running_statistics stats;
+	stats.add(1.0);
+	stats.add(std::numeric_limits<double>::infinity());
+	stats.add(3.0);
+	stats.add(std::numeric_limits<double>::quiet_NaN());
+	running_statistics other;
+	other.add(-std::numeric_limits<double>::infinity());
+	other.add(5.0);
+	stats.merge(other);
+	CHECK(stats.get_count() == 3);
+	CHECK(stats.get_non_finite_count() == 3);
+	CHECK_CLOSE(std::complex<double>(stats.get_mean()), std::complex<double>(3.0), 1e-15);
+	CHECK_CLOSE(std::complex<double>(stats.get_variance()), std::complex<double>(4.0), 1e-15);
+	CHECK(stats.get_maximum() == 5.0);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_sketch_non_finite_samples);
+	RUN_TEST(test_running_statistics_non_finite_samples);
+	return check_failures();
+}
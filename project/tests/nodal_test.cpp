@@ -0,0 +1,205 @@
+﻿// Sparse nodal solver against a dense reference with partial pivoting
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using dense_complex = std::complex<long double>;
+
+// Node voltages (ground excluded) for the netlist's branches driven by the given
+// currents, by Gaussian elimination with partial pivoting in long double
+std::vector<std::complex<double>> dense_solve(const netlist& net, double f, std::vector<std::complex<double>> currents) {
+	const std::size_t n = net.get_node_count() - 1;
+	std::vector<dense_complex> a(n * n);
+	std::vector<dense_complex> b(currents.begin(), currents.end());
+	for (const netlist::branch& br : net.get_branches()) {
+		const dense_complex y = dense_complex(1.0L) / dense_complex(br.part->impedance_at(f));
+		if (br.from != netlist::ground) {
+			a[(br.from - 1) * n + br.from - 1] += y;
+		}
+		if (br.to != netlist::ground) {
+			a[(br.to - 1) * n + br.to - 1] += y;
+		}
+		if (br.from != netlist::ground && br.to != netlist::ground) {
+			a[(br.from - 1) * n + br.to - 1] -= y;
+			a[(br.to - 1) * n + br.from - 1] -= y;
+		}
+	}
+	for (std::size_t k = 0; k < n; ++k) {
+		std::size_t pivot = k;
+		for (std::size_t i = k + 1; i < n; ++i) {
+			if (std::abs(a[i * n + k]) > std::abs(a[pivot * n + k])) {
+				pivot = i;
+			}
+		}
+		for (std::size_t j = 0; j < n; ++j) {
+			std::swap(a[k * n + j], a[pivot * n + j]);
+		}
+		std::swap(b[k], b[pivot]);
+		for (std::size_t i = k + 1; i < n; ++i) {
+			const dense_complex m = a[i * n + k] / a[k * n + k];
+			for (std::size_t j = k; j < n; ++j) {
+				a[i * n + j] -= m * a[k * n + j];
+			}
+			b[i] -= m * b[k];
+		}
+	}
+	for (std::size_t k = n; k-- > 0;) {
+		for (std::size_t j = k + 1; j < n; ++j) {
+			b[k] -= a[k * n + j] * b[j];
+		}
+		b[k] /= a[k * n + k];
+	}
+	return std::vector<std::complex<double>>(b.begin(), b.end());
+}
+
+std::complex<double> dense_port_impedance(const netlist& net, std::size_t node, double f) {
+	std::vector<std::complex<double>> currents(net.get_node_count() - 1, 0.0);
+	currents[node - 1] = 1.0;
+	return dense_solve(net, f, currents)[node - 1];
+}
+
+// A grid of resistors, capacitors and inductors with a current source at one corner
+void test_grid_against_dense() {
+	const std::size_t m = 5;
+	netlist net;
+	std::vector<std::unique_ptr<components>> parts;
+	std::vector<std::size_t> id(m * m);
+	for (std::size_t& node : id) {
+		node = net.add_node();
+	}
+	for (std::size_t i = 0; i < m; ++i) {
+		for (std::size_t j = 0; j < m; ++j) {
+			const double k = 1.0 + 0.1 * static_cast<double>(i * m + j);
+			if (j + 1 < m) {
+				parts.push_back(std::make_unique<resistor>(50.0 * k));
+				net.add_component(parts.back().get(), id[i * m + j], id[i * m + j + 1]);
+			}
+			if (i + 1 < m) {
+				parts.push_back(std::make_unique<inductor>(1e-3 * k));
+				net.add_component(parts.back().get(), id[i * m + j], id[(i + 1) * m + j]);
+			}
+			parts.push_back(std::make_unique<capacitor>(1e-7 * k));
+			net.add_component(parts.back().get(), id[i * m + j], netlist::ground);
+		}
+	}
+	net.add_current_source(netlist::ground, id[0], 1e-3);
+	prepared_netlist prepared(net);
+	for (double f : { 10.0, 1e3, 2.2e4, 1e6 }) {
+		CHECK_CLOSE(prepared.port_impedance(id[0], netlist::ground, f), dense_port_impedance(net, id[0], f), 1e-10);
+		std::vector<std::complex<double>> currents(m * m, 0.0);
+		currents[id[0] - 1] = 1e-3;
+		const std::vector<std::complex<double>> expected = dense_solve(net, f, currents);
+		const ac_solution solution = prepared.solve(f);
+		for (std::size_t node = 1; node <= m * m; ++node) {
+			CHECK_CLOSE(solution.node_voltages[node], expected[node - 1], 1e-9);
+		}
+	}
+}
+
+// Node 1 has an inductor to ground and a capacitor to node 2, so its diagonal
+// admittance j omega C + 1 / (j omega L) cancels at resonance while the matrix
+// stays nonsingular
+void test_zero_diagonal_at_resonance() {
+	netlist net;
+	const std::size_t n1 = net.add_node();
+	const std::size_t n2 = net.add_node();
+	capacitor c(1e-6);
+	inductor l(1e-3);
+	resistor r(50.0);
+	net.add_component(&c, n1, n2);
+	net.add_component(&l, n1, netlist::ground);
+	net.add_component(&r, n2, netlist::ground);
+	prepared_netlist prepared(net);
+	double f = 5032.9212104487042;
+	for (int step = 0; step < 4; ++step) {
+		f = std::nextafter(f, 0.0);
+	}
+	for (int step = 0; step < 9; ++step) {
+		CHECK_CLOSE(prepared.port_impedance(n1, netlist::ground, f), dense_port_impedance(net, n1, f), 1e-9);
+		CHECK_CLOSE(port_impedance(net, n1, netlist::ground, f), dense_port_impedance(net, n1, f), 1e-9);
+		f = std::nextafter(f, 1e9);
+	}
+}
+
+// A node with no path to ground is still reported as singular
+void test_floating_node_is_singular() {
+	netlist net;
+	const std::size_t n1 = net.add_node();
+	const std::size_t n2 = net.add_node();
+	const std::size_t n3 = net.add_node();
+	resistor r1(100.0);
+	resistor r2(100.0);
+	resistor r3(100.0);
+	net.add_component(&r1, n1, netlist::ground);
+	net.add_component(&r2, n2, n3);
+	net.add_component(&r3, n1, n2);
+	resistor r4(1.0);
+	netlist floating;
+	const std::size_t a = floating.add_node();
+	const std::size_t b = floating.add_node();
+	floating.add_component(&r4, a, b);
+	bool threw = false;
+	try {
+		port_impedance(floating, a, netlist::ground, 1e3);
+	}
+	catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+	CHECK_CLOSE(port_impedance(net, n3, netlist::ground, 1e3), std::complex<double>(300.0), 1e-12);
+}
+
+// 1 V behind 1 mH driving 1 kOhm: the Norton current follows the internal impedance
+void test_reactive_voltage_source() {
+	netlist net;
+	const std::size_t out = net.add_node();
+	inductor l(1e-3);
+	resistor load(1e3);
+	net.add_voltage_source(out, netlist::ground, 1.0, &l);
+	net.add_component(&load, out, netlist::ground);
+	prepared_netlist prepared(net);
+	for (double f : { 1.0, 1e3, 1e6 }) {
+		const std::complex<double> expected = 1e3 / (1e3 + std::complex<double>(0.0, 2 * pi * f * 1e-3));
+		CHECK_CLOSE(prepared.solve(f).node_voltages[out], expected, 1e-12);
+		CHECK_CLOSE(solve_ac(net, f).node_voltages[out], expected, 1e-12);
+	}
+}
+
+// A change of component value between two solves at the same frequency is seen
+void test_value_change_between_solves() {
+	netlist net;
+	const std::size_t n1 = net.add_node();
+	diode d(1e-12, 0.0, 1e-14);
+	resistor r(1e3);
+	net.add_component(&d, n1, netlist::ground);
+	net.add_component(&r, n1, netlist::ground);
+	prepared_netlist prepared(net);
+	const std::complex<double> before = prepared.port_impedance(n1, netlist::ground, 1e3);
+	CHECK_CLOSE(before, dense_port_impedance(net, n1, 1e3), 1e-12);
+	d.set_operating_point(0.6);
+	const std::complex<double> after = prepared.port_impedance(n1, netlist::ground, 1e3);
+	CHECK_CLOSE(after, dense_port_impedance(net, n1, 1e3), 1e-12);
+	CHECK(relative_error(after, before) > 0.1);
+	std::vector<std::complex<double>> derivatives;
+	CHECK_CLOSE(prepared.port_sensitivities(n1, netlist::ground, 1e3, derivatives), after, 1e-12);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_grid_against_dense);
+	RUN_TEST(test_zero_diagonal_at_resonance);
+	RUN_TEST(test_floating_node_is_singular);
+	RUN_TEST(test_reactive_voltage_source);
+	RUN_TEST(test_value_change_between_solves);
+	return check_failures();
+}
@@ -0,0 +1,126 @@
+﻿// Mixed-precision nodal solves and single-precision sweeps against full precision
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Grid of lightly damped LC sections, which makes for a badly conditioned matrix
+// near its resonances
+struct lc_grid
+{
+	std::vector<std::unique_ptr<components>> parts;
+	netlist net;
+	std::vector<std::size_t> id;
+
+	lc_grid(std::size_t m, double leak) : id(m * m) {
+		for (std::size_t& node : id) {
+			node = net.add_node();
+		}
+		for (std::size_t i = 0; i < m; ++i) {
+			for (std::size_t j = 0; j < m; ++j) {
+				const double k = 1.0 + 0.07 * static_cast<double>(i * m + j);
+				if (j + 1 < m) {
+					add(std::make_unique<inductor>(1e-3 * k), id[i * m + j], id[i * m + j + 1]);
+				}
+				if (i + 1 < m) {
+					add(std::make_unique<resistor>(0.5 * k), id[i * m + j], id[(i + 1) * m + j]);
+				}
+				add(std::make_unique<capacitor>(1e-7 * k), id[i * m + j], netlist::ground);
+				add(std::make_unique<resistor>(leak * k), id[i * m + j], netlist::ground);
+			}
+		}
+		net.add_current_source(netlist::ground, id[0], 1e-3);
+	}
+	void add(std::unique_ptr<components> part, std::size_t from, std::size_t to) {
+		parts.push_back(std::move(part));
+		net.add_component(parts.back().get(), from, to);
+	}
+};
+
+// Refined single-precision factors give the answers of double ones
+void test_mixed_matches_full() {
+	const std::size_t m = 8;
+	lc_grid grid(m, 1e6);
+	prepared_netlist full(grid.net);
+	prepared_netlist mixed(grid.net, nodal_precision::mixed);
+	CHECK(mixed.get_precision() == nodal_precision::mixed);
+	for (double f : { 50.0, 1.3e3, 1.6e4, 1.7e4, 2.1e5 }) {
+		CHECK_CLOSE(mixed.port_impedance(grid.id[0], netlist::ground, f), full.port_impedance(grid.id[0], netlist::ground, f), 1e-11);
+		const ac_solution expected = full.solve(f);
+		const ac_solution actual = mixed.solve(f);
+		for (std::size_t node = 1; node <= m * m; ++node) {
+			CHECK_CLOSE(actual.node_voltages[node], expected.node_voltages[node], 1e-10);
+		}
+		// The adjoint goes through the transposed refinement
+		std::vector<std::complex<double>> full_derivatives;
+		std::vector<std::complex<double>> mixed_derivatives;
+		full.port_sensitivities(grid.id[m * m - 1], grid.id[0], f, full_derivatives);
+		mixed.port_sensitivities(grid.id[m * m - 1], grid.id[0], f, mixed_derivatives);
+		for (std::size_t k = 0; k < full_derivatives.size(); ++k) {
+			CHECK_CLOSE(mixed_derivatives[k], full_derivatives[k], 1e-9);
+		}
+	}
+}
+
+// Admittances beyond the range of a float fall back to double factors
+void test_out_of_range_falls_back() {
+	netlist net;
+	const std::size_t n1 = net.add_node();
+	const std::size_t n2 = net.add_node();
+	resistor tiny(1e-40);
+	resistor link(50.0);
+	capacitor c(1e-9);
+	net.add_component(&tiny, n1, netlist::ground);
+	net.add_component(&link, n1, n2);
+	net.add_component(&c, n2, netlist::ground);
+	prepared_netlist full(net);
+	prepared_netlist mixed(net, nodal_precision::mixed);
+	CHECK_CLOSE(mixed.port_impedance(n1, netlist::ground, 1e6), full.port_impedance(n1, netlist::ground, 1e6), 1e-12);
+	CHECK_CLOSE(mixed.port_impedance(n2, netlist::ground, 1e6), full.port_impedance(n2, netlist::ground, 1e6), 1e-12);
+}
+
+// A float sweep keeps about six digits away from resonances
+void test_float_sweep() {
+	circuit top(connection::series);
+	circuit tank(connection::parallel);
+	resistor r(50.0);
+	capacitor c(1e-6);
+	inductor l(1e-3);
+	resistor damping(1e3);
+	top.add_component_in_series(&r);
+	tank.add_component_in_parallel(&c);
+	tank.add_component_in_parallel(&l);
+	tank.add_component_in_parallel(&damping);
+	top.add_circuit_in_series(&tank);
+	std::vector<double> freqs;
+	for (double f = 10.0; f < 1e6; f *= 1.37) {
+		freqs.push_back(f);
+	}
+	const std::size_t n = freqs.size();
+	std::vector<double> magnitude(n);
+	std::vector<double> phase(n);
+	top.sweep(freqs.data(), n, magnitude.data(), phase.data());
+	const std::vector<float> single_freqs(freqs.begin(), freqs.end());
+	std::vector<float> single_magnitude(n);
+	std::vector<float> single_phase(n);
+	top.sweep(single_freqs.data(), n, single_magnitude.data(), single_phase.data());
+	for (std::size_t i = 0; i < n; ++i) {
+		CHECK_CLOSE(std::complex<double>(single_magnitude[i]), std::complex<double>(magnitude[i]), 1e-5);
+		CHECK(std::abs(single_phase[i] - phase[i]) < 1e-5);
+	}
+}
+
+}
+
+int main() {
+	RUN_TEST(test_mixed_matches_full);
+	RUN_TEST(test_out_of_range_falls_back);
+	RUN_TEST(test_float_sweep);
+	return check_failures();
+}
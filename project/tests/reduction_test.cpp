@@ -0,0 +1,85 @@
+﻿// PRIMA reduced models against the full nodal solve
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+namespace {
+
+// Grid of resistors and inductors with a capacitor and a leak from every node to
+// ground, driven from two corners
+struct rlc_grid
+{
+	std::vector<std::unique_ptr<components>> parts;
+	netlist net;
+	std::vector<std::size_t> id;
+
+	explicit rlc_grid(std::size_t m) : id(m * m) {
+		for (std::size_t& node : id) {
+			node = net.add_node();
+		}
+		for (std::size_t i = 0; i < m; ++i) {
+			for (std::size_t j = 0; j < m; ++j) {
+				const double k = 1.0 + 0.05 * static_cast<double>(i * m + j);
+				if (j + 1 < m) {
+					add(std::make_unique<resistor>(5.0 * k), id[i * m + j], id[i * m + j + 1]);
+				}
+				if (i + 1 < m) {
+					add(std::make_unique<inductor>(1e-6 * k), id[i * m + j], id[(i + 1) * m + j]);
+				}
+				add(std::make_unique<capacitor>(1e-9 * k), id[i * m + j], netlist::ground);
+				add(std::make_unique<resistor>(1e4 * k), id[i * m + j], netlist::ground);
+			}
+		}
+	}
+	void add(std::unique_ptr<components> part, std::size_t from, std::size_t to) {
+		parts.push_back(std::move(part));
+		net.add_component(parts.back().get(), from, to);
+	}
+};
+
+void test_grid_against_port_impedance() {
+	const std::size_t m = 12;
+	rlc_grid grid(m);
+	const std::vector<netlist_port> ports = { { grid.id[0], netlist::ground }, { grid.id[m * m - 1], netlist::ground } };
+	reduction_options options;
+	// Three decades below the grid's first resonances
+	options.f_min = 1e2;
+	options.f_max = 1e5;
+	const reduced_model model = reduce_netlist(grid.net, ports, options);
+	CHECK(model.get_port_count() == 2);
+	CHECK(model.get_order() < m * m);
+	CHECK(model.get_estimated_error() < options.tolerance);
+	prepared_netlist prepared(grid.net);
+	for (double f = 1e2; f <= 1e5; f *= 1.9) {
+		CHECK_CLOSE(model.impedance(f, 0, 0), prepared.port_impedance(ports[0].plus, ports[0].minus, f), 1e-7);
+		CHECK_CLOSE(model.impedance(f, 1, 1), prepared.port_impedance(ports[1].plus, ports[1].minus, f), 1e-7);
+		// A reciprocal network gives a symmetric impedance matrix
+		CHECK_CLOSE(model.impedance(f, 0, 1), model.impedance(f, 1, 0), 1e-7);
+	}
+}
+
+// Keeping as many states as the network has reproduces it exactly
+void test_full_order_is_exact() {
+	rlc_grid grid(3);
+	const std::vector<netlist_port> ports = { { grid.id[4], netlist::ground } };
+	reduction_options options;
+	options.f_min = 1e4;
+	options.f_max = 1e7;
+	options.order = 9 + 6;
+	const reduced_model model = reduce_netlist(grid.net, ports, options);
+	for (double f : { 1e2, 1e5, 1e9 }) {
+		CHECK_CLOSE(model.impedance(f), port_impedance(grid.net, grid.id[4], netlist::ground, f), 1e-9);
+	}
+}
+
+}
+
+int main() {
+	RUN_TEST(test_grid_against_port_impedance);
+	RUN_TEST(test_full_order_is_exact);
+	return check_failures();
+}
@@ -0,0 +1,153 @@
+﻿// Analytic impedance sensitivities against central differences
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const double relative_step = 1e-6;
+
+// p dZ/dp agrees with the central difference relative to the larger of itself and
+// |Z|, which keeps derivatives that are nearly zero from failing on difference noise
+bool close_to_difference(std::complex<double> derivative, std::complex<double> up, std::complex<double> down,
+	double value, std::complex<double> z) {
+	const std::complex<double> difference = (up - down) / (2 * relative_step * value);
+	const double scale = std::max(std::abs(derivative * value), std::abs(z));
+	return std::abs(derivative - difference) * std::abs(value) <= 1e-6 * scale;
+}
+
+std::unique_ptr<components> make_part(component_kind kind, double value) {
+	switch (kind) {
+	case component_kind::resistor:
+		return std::make_unique<resistor>(value);
+	case component_kind::capacitor:
+		return std::make_unique<capacitor>(value);
+	default:
+		return std::make_unique<inductor>(value);
+	}
+}
+
+// series<R, parallel<C, L, R>> by dual numbers
+void test_fixed_gradient() {
+	using filter = series<resistor, parallel<capacitor, inductor, resistor>>;
+	filter circuit_under_test(50.0, 1e-6, 1e-3, 2e3);
+	for (double f : { 1e3, 5e3, 2e4 }) {
+		const auto gradient = circuit_under_test.impedance_gradient_at(f);
+		CHECK_CLOSE(gradient.value, circuit_under_test.impedance_at(f), 1e-15);
+		for (std::size_t i = 0; i < filter::parameter_count; ++i) {
+			const double value = circuit_under_test.get_parameter(i);
+			filter perturbed = circuit_under_test;
+			perturbed.set_parameter(i, value * (1 + relative_step));
+			const std::complex<double> up = perturbed.impedance_at(f);
+			perturbed.set_parameter(i, value * (1 - relative_step));
+			const std::complex<double> down = perturbed.impedance_at(f);
+			CHECK(close_to_difference(gradient.derivative[i], up, down, value, gradient.value));
+		}
+	}
+}
+
+// A series circuit holding a parallel sub-circuit, by the reverse pass down the tree
+void test_circuit_tree() {
+	struct part_entry
+	{
+		circuit* owner;
+		component_id id;
+		component_kind kind;
+		double value;
+	};
+	circuit top(connection::series);
+	circuit tank(connection::parallel);
+	resistor r1(50.0);
+	inductor l1(2e-4);
+	capacitor c1(1e-6);
+	inductor l2(1e-3);
+	resistor r2(2e3);
+	std::vector<part_entry> entries = {
+		{ &top, top.add_component_in_series(&r1), component_kind::resistor, 50.0 },
+		{ &top, top.add_component_in_series(&l1), component_kind::inductor, 2e-4 },
+		{ &tank, tank.add_component_in_parallel(&c1), component_kind::capacitor, 1e-6 },
+		{ &tank, tank.add_component_in_parallel(&l2), component_kind::inductor, 1e-3 },
+		{ &tank, tank.add_component_in_parallel(&r2), component_kind::resistor, 2e3 },
+	};
+	top.add_circuit_in_series(&tank);
+	top.set_frequency(4e3);
+	const std::complex<double> z = top.get_circuit_impedance();
+	const std::vector<component_sensitivity> sensitivities = top.get_sensitivities();
+	CHECK(sensitivities.size() == entries.size());
+	for (const component_sensitivity& s : sensitivities) {
+		for (const part_entry& e : entries) {
+			if (e.owner != s.owner || e.id != s.id) {
+				continue;
+			}
+			CHECK(e.kind == s.kind);
+			const std::unique_ptr<components> original = make_part(e.kind, e.value);
+			const std::unique_ptr<components> raised = make_part(e.kind, e.value * (1 + relative_step));
+			const std::unique_ptr<components> lowered = make_part(e.kind, e.value * (1 - relative_step));
+			e.owner->replace_component(e.id, raised.get());
+			const std::complex<double> up = top.get_circuit_impedance();
+			e.owner->replace_component(e.id, lowered.get());
+			const std::complex<double> down = top.get_circuit_impedance();
+			e.owner->replace_component(e.id, original.get());
+			CHECK(close_to_difference(s.impedance, up, down, e.value, z));
+			CHECK_CLOSE(std::complex<double>(s.magnitude), std::complex<double>((std::abs(up) - std::abs(down)) / (2 * relative_step * e.value)), 1e-6);
+		}
+	}
+}
+
+// Three-section RLC ladder, by the adjoint solve of a prepared netlist
+struct ladder
+{
+	std::vector<std::unique_ptr<components>> parts;
+	netlist net;
+	std::size_t input;
+
+	explicit ladder(const std::vector<double>& values) {
+		std::size_t node = input = net.add_node();
+		for (std::size_t section = 0; section < 3; ++section) {
+			const std::size_t next = net.add_node();
+			parts.push_back(std::make_unique<resistor>(values[3 * section]));
+			net.add_component(parts.back().get(), node, next);
+			parts.push_back(std::make_unique<inductor>(values[3 * section + 1]));
+			net.add_component(parts.back().get(), next, netlist::ground);
+			parts.push_back(std::make_unique<capacitor>(values[3 * section + 2]));
+			net.add_component(parts.back().get(), next, netlist::ground);
+			node = next;
+		}
+	}
+};
+
+void test_netlist_adjoint() {
+	const std::vector<double> values = { 10.0, 1e-3, 1e-6, 22.0, 4.7e-4, 2.2e-6, 47.0, 2.2e-4, 4.7e-7 };
+	ladder nominal(values);
+	prepared_netlist prepared(nominal.net);
+	for (double f : { 2e3, 7e3 }) {
+		std::vector<std::complex<double>> derivatives;
+		const std::complex<double> z = prepared.port_sensitivities(nominal.input, netlist::ground, f, derivatives);
+		CHECK(derivatives.size() == values.size());
+		for (std::size_t k = 0; k < values.size(); ++k) {
+			std::vector<double> raised = values;
+			std::vector<double> lowered = values;
+			raised[k] *= 1 + relative_step;
+			lowered[k] *= 1 - relative_step;
+			ladder up(raised);
+			ladder down(lowered);
+			CHECK(close_to_difference(derivatives[k], port_impedance(up.net, up.input, netlist::ground, f),
+				port_impedance(down.net, down.input, netlist::ground, f), values[k], z));
+		}
+	}
+}
+
+}
+
+int main() {
+	RUN_TEST(test_fixed_gradient);
+	RUN_TEST(test_circuit_tree);
+	RUN_TEST(test_netlist_adjoint);
+	return check_failures();
+}
@@ -0,0 +1,143 @@
+﻿// Server mode driven through run() with requests of every kind, good and bad
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> lines_of(const std::string& text) {
+	std::vector<std::string> lines;
+	std::istringstream in(text);
+	std::string line;
+	while (std::getline(in, line)) {
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+bool starts_with(const std::string& s, const char* prefix) {
+	return s.compare(0, std::strlen(prefix), prefix) == 0;
+}
+
+bool has(const std::string& s, const char* text) {
+	return s.find(text) != std::string::npos;
+}
+
+// Number following "name": in a response line
+double field(const std::string& line, const char* name) {
+	const std::string key = std::string("\"") + name + "\":";
+	const std::size_t at = line.find(key);
+	return at == std::string::npos ? 0.0 : std::strtod(line.c_str() + at + key.size(), nullptr);
+}
+
+// Numbers of the array following "name": in a response line
+std::vector<double> array_field(const std::string& line, const char* name) {
+	const std::string key = std::string("\"") + name + "\":[";
+	std::vector<double> x;
+	std::size_t at = line.find(key);
+	if (at == std::string::npos) {
+		return x;
+	}
+	const char* p = line.c_str() + at + key.size();
+	while (*p != ']') {
+		char* end = nullptr;
+		x.push_back(std::strtod(p, &end));
+		p = *end == ',' ? end + 1 : end;
+	}
+	return x;
+}
+
+std::complex<double> menu_impedance(int type, const double* values, double f) {
+	arena pool(1 << 16);
+	circuit* c = build_menu_circuit(type, values, pool);
+	c->set_frequency(f);
+	return c->get_circuit_impedance();
+}
+
+void test_responses_in_request_order() {
+	std::istringstream in(
+		"{\"id\":1,\"op\":\"evaluate\",\"type\":2,\"frequency\":1000,\"values\":[10,1e-6,0.01]}\n"
+		"{\"id\":2,\"op\":\"sweep\",\"type\":5,\"values\":[100,1e-6],\"start\":10,\"stop\":1e5,\"points\":20}\n"
+		"{\"id\":3,\"op\":\"evaluate\",\"type\":2\n"
+		"\n"
+		"{\"id\":4,\"op\":\"evaluate\",\"type\":2,\"frequency\":1000,\"values\":[10,1e-6]}\n"
+		"{\"id\":\"five\",\"op\":\"evaluate\",\"type\":6,\"frequency\":50,\"values\":[100,1e-6]}\n"
+		"{\"id\":6,\"op\":\"stats\"}\n"
+		"{\"id\":nan,\"op\":\"stats\"}\n");
+	std::ostringstream out;
+	server_options options;
+	options.threads = 2;
+	simulation_server server(options);
+	server.run(in, out);
+	const std::vector<std::string> lines = lines_of(out.str());
+	CHECK(lines.size() == 7);
+	if (lines.size() != 7) {
+		return;
+	}
+
+	const double rlc[3] = { 10, 1e-6, 0.01 };
+	CHECK(starts_with(lines[0], "{\"id\":1,\"magnitude\":"));
+	CHECK_CLOSE(std::polar(field(lines[0], "magnitude"), field(lines[0], "phase")), menu_impedance(2, rlc, 1000), 1e-9);
+
+	const double rc[2] = { 100, 1e-6 };
+	CHECK(starts_with(lines[1], "{\"id\":2,\"frequency\":["));
+	const std::vector<double> freqs = array_field(lines[1], "frequency");
+	const std::vector<double> magnitude = array_field(lines[1], "magnitude");
+	const std::vector<double> phase = array_field(lines[1], "phase");
+	CHECK(freqs.size() == 20 && magnitude.size() == 20 && phase.size() == 20);
+	for (std::size_t i = 0; i < freqs.size() && i < magnitude.size() && i < phase.size(); ++i) {
+		CHECK_CLOSE(std::polar(magnitude[i], phase[i]), menu_impedance(5, rc, freqs[i]), 1e-9);
+	}
+
+	CHECK(lines[2] == "{\"id\":3,\"error\":\"Error: Malformed request.\"}");
+	CHECK(lines[3] == "{\"id\":4,\"error\":\"Error: Wrong number of values for this circuit type.\"}");
+
+	CHECK(starts_with(lines[4], "{\"id\":\"five\",\"magnitude\":"));
+	CHECK_CLOSE(std::polar(field(lines[4], "magnitude"), field(lines[4], "phase")), menu_impedance(6, rc, 50), 1e-9);
+
+	CHECK(starts_with(lines[5], "{\"id\":6,\"evaluate\":{"));
+	CHECK(has(lines[5], "\"cache\":{"));
+	CHECK(!has(lines[5], "error"));
+
+	CHECK(lines[6] == "{\"error\":\"Error: Malformed request.\"}");
+}
+
+// Only a finite JSON number or a string is taken as an id
+void test_request_ids() {
+	const char* const rejected[] = { "nan", "inf", "-inf", "infinity", "1e999", "+1", ".5", "true" };
+	for (const char* id : rejected) {
+		const std::string line = std::string("{\"id\":") + id + ",\"op\":\"stats\"}";
+		server_request request;
+		bool thrown = false;
+		try {
+			parse_request(line.data(), line.data() + line.size(), request);
+		}
+		catch (const std::invalid_argument&) {
+			thrown = true;
+		}
+		CHECK(thrown);
+	}
+	const char* const accepted[] = { "7", "-12", "2.5e3", "\"a b\"" };
+	for (const char* id : accepted) {
+		const std::string line = std::string("{\"id\":") + id + ",\"op\":\"stats\"}";
+		server_request request;
+		CHECK(parse_request(line.data(), line.data() + line.size(), request));
+		CHECK(request.id == id);
+	}
+}
+
+}
+
+int main() {
+	RUN_TEST(test_responses_in_request_order);
+	RUN_TEST(test_request_ids);
+	return check_failures();
+}
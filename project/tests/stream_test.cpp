@@ -0,0 +1,110 @@
+﻿// Pipelined sweep chunks against a whole-grid circuit sweep
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct rc_circuit
+{
+	resistor r;
+	capacitor c;
+	circuit whole;
+
+	rc_circuit() : r(100.0), c(1e-6) {
+		whole.add_component_in_series(&r);
+		whole.add_component_in_series(&c);
+	}
+};
+
+// Chunks cover the grid in order with a short last one, and the values match
+// a sweep of the whole grid at once
+void test_chunks_cover_grid() {
+	rc_circuit rc;
+	const frequency_grid grid(10.0, 1e6, 1000);
+	const std::size_t chunk_size = 96;
+	std::vector<double> freqs(grid.size());
+	grid.fill(0, grid.size(), freqs.data());
+	const sweep_result expected = rc.whole.sweep(freqs);
+	pipelined_sweep sweep(sweep_stream(rc.whole, grid), chunk_size);
+	sweep_chunk chunk;
+	std::size_t chunks = 0;
+	std::size_t position = 0;
+	while (sweep.next(chunk)) {
+		CHECK(chunk.first == position);
+		CHECK(chunk.size == std::min(chunk_size, grid.size() - position));
+		for (std::size_t i = 0; i < chunk.size; ++i) {
+			CHECK(chunk.frequency[i] == freqs[position + i]);
+			CHECK_CLOSE(chunk.magnitude[i], expected.magnitude[position + i], 1e-12);
+			CHECK_CLOSE(chunk.phase[i], expected.phase[position + i], 1e-12);
+		}
+		position += chunk.size;
+		++chunks;
+	}
+	CHECK(position == grid.size());
+	CHECK(chunks == 11);
+	CHECK(!sweep.next(chunk));
+}
+
+// A grid that fits in one chunk is evaluated on the caller's thread
+void test_single_chunk_runs_inline() {
+	rc_circuit rc;
+	const frequency_grid grid(10.0, 1e6, 50);
+	std::vector<std::thread::id> threads;
+	sweep_stream stream([&](const double* f, std::size_t n, double* magnitude, double* phase) {
+		threads.push_back(std::this_thread::get_id());
+		rc.whole.sweep(f, n, magnitude, phase);
+	}, grid);
+	pipelined_sweep sweep(std::move(stream), 64);
+	sweep_chunk chunk;
+	CHECK(sweep.next(chunk));
+	CHECK(chunk.first == 0);
+	CHECK(chunk.size == 50);
+	CHECK(!sweep.next(chunk));
+	CHECK(threads.size() == 1 && threads[0] == std::this_thread::get_id());
+}
+
+// An exception thrown by the evaluator on the worker comes out of next()
+void test_evaluator_error_reaches_caller() {
+	const frequency_grid grid(10.0, 1e6, 1000);
+	std::size_t calls = 0;
+	sweep_stream stream([&](const double*, std::size_t n, double* magnitude, double* phase) {
+		if (++calls == 3) {
+			throw std::runtime_error("evaluator failed");
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			magnitude[i] = 1.0;
+			phase[i] = 0.0;
+		}
+	}, grid);
+	pipelined_sweep sweep(std::move(stream), 100);
+	sweep_chunk chunk;
+	std::size_t chunks = 0;
+	bool thrown = false;
+	try {
+		while (sweep.next(chunk)) {
+			++chunks;
+		}
+	}
+	catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	CHECK(thrown);
+	CHECK(chunks < 3);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_chunks_cover_grid);
+	RUN_TEST(test_single_chunk_runs_inline);
+	RUN_TEST(test_evaluator_error_reaches_caller);
+	return check_failures();
+}
@@ -0,0 +1,78 @@
+﻿// Transient analysis of an RC step against the analytic charging curve
+
+#include "acs/acs.h"
+#include "check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace {
+
+const double resistance = 1e3;
+const double capacitance = 1e-6;
+const double tau = resistance * capacitance;
+
+// Largest difference from 1 - exp(-t / RC) over the run, and the number of steps taken
+struct rc_result
+{
+	double error;
+	std::size_t steps;
+};
+
+// 1 V step through R into C, node 'out' between them
+rc_result run_rc_step(const transient_options& options) {
+	netlist net;
+	const std::size_t out = net.add_node();
+	resistor r(resistance);
+	capacitor c(capacitance);
+	const std::size_t feed = net.add_component(&r, out, netlist::ground);
+	net.add_component(&c, out, netlist::ground);
+	transient_analysis analysis(net);
+	analysis.add_voltage_source(feed, step_waveform(1.0));
+	rc_result result = { 0.0, 0 };
+	const transient_statistics stats = analysis.run(5 * tau, options, [&](double t, const std::vector<double>& v) {
+		result.error = std::max(result.error, std::abs(v[out] - (1.0 - std::exp(-t / tau))));
+	});
+	result.steps = stats.accepted_steps;
+	return result;
+}
+
+rc_result run_fixed(integration_method method, double step) {
+	transient_options options;
+	options.method = method;
+	options.adaptive = false;
+	options.step = step;
+	return run_rc_step(options);
+}
+
+// Halving the step divides the error by 2 for backward Euler and by 4 for the trapezoidal rule
+void test_fixed_step_order() {
+	const rc_result euler = run_fixed(integration_method::backward_euler, tau / 100);
+	const rc_result euler_half = run_fixed(integration_method::backward_euler, tau / 200);
+	CHECK(euler.error < 2.5e-3);
+	CHECK(std::abs(euler.error / euler_half.error - 2.0) < 0.1);
+	const rc_result trapezoidal = run_fixed(integration_method::trapezoidal, tau / 100);
+	const rc_result trapezoidal_half = run_fixed(integration_method::trapezoidal, tau / 200);
+	CHECK(trapezoidal.error < 6e-5);
+	CHECK(std::abs(trapezoidal.error / trapezoidal_half.error - 4.0) < 0.4);
+}
+
+// Adaptive steps stay near the requested tolerance with far fewer steps
+void test_adaptive_step() {
+	transient_options options;
+	options.relative_tolerance = 1e-4;
+	options.absolute_tolerance = 1e-7;
+	const rc_result adaptive = run_rc_step(options);
+	CHECK(adaptive.error < 5e-4);
+	CHECK(adaptive.steps < 200);
+}
+
+}
+
+int main() {
+	RUN_TEST(test_fixed_step_order);
+	RUN_TEST(test_adaptive_step);
+	return check_failures();
+}